@@ -0,0 +1,176 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <iostream>
+#include <deque>
+#include <sstream>
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+#include <qi/application.hpp>
+#include <qi/anyobject.hpp>
+#include <qi/buffer.hpp>
+#include <qi/future.hpp>
+#include <qi/session.hpp>
+#include <qi/messaging/gateway.hpp>
+#include <qi/perf/dataperfsuite.hpp>
+#include <qi/type/dynamicobjectbuilder.hpp>
+
+/* Throughput of calls through a gateway, compared to the same calls made
+ * directly to the service directory hosting the service.
+ *
+ * The calls and replies of echoValue and echoBuffer can not carry objects, so
+ * the gateway forwards them without decoding their payload. getObject returns
+ * an object, which the gateway has to find in the reply and track.
+ */
+
+static int echoValue(int value)
+{
+  return value;
+}
+
+static qi::Buffer echoBuffer(const qi::Buffer& buffer)
+{
+  return buffer;
+}
+
+static qi::AnyObject makeService();
+
+static qi::AnyObject getObject()
+{
+  return makeService();
+}
+
+static qi::AnyObject makeService()
+{
+  qi::DynamicObjectBuilder ob;
+  ob.setThreadingModel(qi::ObjectThreadingModel_MultiThread);
+  ob.advertiseMethod("echoValue", &echoValue);
+  ob.advertiseMethod("echoBuffer", &echoBuffer);
+  ob.advertiseMethod("getObject", &getObject);
+  return ob.object();
+}
+
+// Keep up to pipeline calls in flight
+template <typename F>
+static void run(qi::DataPerfSuite& out, const std::string& name, unsigned int count, unsigned int pipeline,
+                unsigned long msgSize, F call)
+{
+  qi::DataPerf dp;
+  std::deque<qi::Future<void> > pending;
+  dp.start(name, count, msgSize);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    if (pending.size() >= pipeline)
+    {
+      pending.front().value();
+      pending.pop_front();
+    }
+    pending.push_back(call());
+  }
+  while (!pending.empty())
+  {
+    pending.front().value();
+    pending.pop_front();
+  }
+  dp.stop();
+  out << dp;
+  std::cout << name << ": " << dp.getMsgPerSecond() << " calls/s" << std::endl;
+}
+
+static qi::Future<void> callEchoValue(qi::AnyObject& service)
+{
+  return service.async<int>("echoValue", 42).andThen([](int) {});
+}
+
+static qi::Future<void> callEchoBuffer(qi::AnyObject& service, const qi::Buffer& buffer)
+{
+  return service.async<qi::Buffer>("echoBuffer", buffer).andThen([](const qi::Buffer&) {});
+}
+
+static qi::Future<void> callGetObject(qi::AnyObject& service)
+{
+  return service.async<qi::AnyObject>("getObject").andThen([](const qi::AnyObject&) {});
+}
+
+static void runAll(qi::DataPerfSuite& out, const std::string& prefix, qi::AnyObject service, unsigned int count,
+                   unsigned int pipeline, unsigned int bufferSize)
+{
+  qi::Buffer buffer;
+  buffer.reserve(bufferSize);
+
+  run(out, prefix + "_echo_sync", count, 1, 0, boost::bind(&callEchoValue, boost::ref(service)));
+  {
+    std::ostringstream name;
+    name << prefix << "_echo_pipeline" << pipeline;
+    run(out, name.str(), count, pipeline, 0, boost::bind(&callEchoValue, boost::ref(service)));
+  }
+  {
+    std::ostringstream name;
+    name << prefix << "_buffer_" << bufferSize << "b_pipeline" << pipeline;
+    run(out, name.str(), count, pipeline, bufferSize,
+        boost::bind(&callEchoBuffer, boost::ref(service), boost::cref(buffer)));
+  }
+  // objects are tracked by the gateway until their client leaves, keep it short
+  run(out, prefix + "_object_sync", count / 10, 1, 0, boost::bind(&callGetObject, boost::ref(service)));
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+
+  po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
+  desc.add_options()
+    ("help,h", "Print this help.")
+    ("count", po::value<unsigned int>()->default_value(20000), "Number of calls of each run")
+    ("pipeline", po::value<unsigned int>()->default_value(64), "Number of calls in flight in pipelined runs")
+    ("buffer", po::value<unsigned int>()->default_value(65536), "Size of the buffers sent back and forth, in bytes")
+    ("no-direct", "Only run the calls through the gateway");
+
+  desc.add(qi::detail::getPerfOptions());
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+            .options(desc).allow_unregistered().run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  qi::DataPerfSuite out("qimessaging", "perf_gateway", qi::DataPerfSuite::OutputData_MsgPerSecond, vm["output"].as<std::string>());
+
+  const unsigned int count = vm["count"].as<unsigned int>();
+  const unsigned int pipeline = std::max(1u, vm["pipeline"].as<unsigned int>());
+  const unsigned int bufferSize = vm["buffer"].as<unsigned int>();
+
+  qi::Session sd;
+  sd.listenStandalone("tcp://127.0.0.1:0");
+  sd.registerService("perfService", makeService());
+
+  qi::Gateway gateway;
+  gateway.attachToServiceDirectory(sd.url()).value();
+  gateway.listen("tcp://127.0.0.1:0");
+
+  if (!vm.count("no-direct"))
+  {
+    qi::Session client;
+    client.connect(sd.url());
+    runAll(out, "direct", client.service("perfService"), count, pipeline, bufferSize);
+    client.close();
+  }
+  {
+    qi::Session client;
+    client.connect(gateway.endpoints().at(0));
+    runAll(out, "gateway", client.service("perfService"), count, pipeline, bufferSize);
+    client.close();
+  }
+
+  out.close();
+  return EXIT_SUCCESS;
+}
@@ -1,133 +1,165 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
 
-#include <gtest/gtest.h>
-#include <string>
-#include <qi/messaging.hpp>
-#include <qi/messaging/perf/dataperftimer.hpp>
+#include <sstream>
+#include <vector>
 
-#include <qi/messaging/serialization.hpp>
-#include <qi/messaging/serialization/serializable.hpp>
-#include <qi/messaging/serialization/serializer.hpp>
-#include <qi/messaging/serialization/boost/boost_serializers.hpp>
-#include <math.h>
+#include <boost/program_options.hpp>
 
-using namespace qi;
-using namespace qi::serialization;
-const unsigned int kNumPowers = 12;
-const unsigned int kNumLoops = 1000000;
+namespace po = boost::program_options;
 
-TEST(Serialization, qiVectorFloat)
-{
-  qi::perf::DataPerfTimer dt;
-  for (unsigned int k = 0; k < kNumPowers; k++) {
-    unsigned int kNumFloats = (int)powf((float)2, k);
-    std::vector<float> f;
-    f.assign( kNumFloats, 1.1111098340f);
-    dt.start(kNumLoops, kNumFloats * sizeof(float));
-    for (unsigned int i=0; i<kNumLoops; i++) {
-      qi::DataStream m;
-      qi::serialization::serialize<std::vector<float> >::write(m, f);
-      //std::cout << m.str().size() << "---" << m.str() << std::endl;
-    }
-    dt.stop();
-  }
-}
+#include <qi/application.hpp>
+#include <qi/binarycodec.hpp>
+#include <qi/buffer.hpp>
+#include <qi/perf/dataperfsuite.hpp>
 
+/* Encode and decode structs of scalars, alone and in lists, and lists of
+ * scalars, which the binary codec copies as whole byte ranges instead of
+ * field by field and element by element. Also decode large raw buffers,
+ * which are sliced out of the received buffer instead of copied.
+ */
 
+struct Position
+{
+  float x;
+  float y;
+  float z;
+};
+QI_TYPE_STRUCT(Position, x, y, z);
 
-struct QiFloatStruct : qi::serialization::Serializable {
-  std::vector<float> f;
+struct Sample
+{
+  double   time;
+  Position position;
+  int      id;
+  short    flags;
+};
+QI_TYPE_STRUCT(Sample, time, position, id, flags);
 
-  void accept(qi::serialization::Serializer& s) {
-    s.visit(f);
+static Sample sample(int i)
+{
+  Sample s;
+  s.time = i * 0.01;
+  s.position.x = 1.f * i;
+  s.position.y = 2.f * i;
+  s.position.z = 3.f * i;
+  s.id = i;
+  s.flags = static_cast<short>(i & 0xff);
+  return s;
+}
+
+template <typename T>
+static void encode(qi::DataPerfSuite& out, const std::string& name, const T& value, unsigned int count)
+{
+  qi::DataPerf dp;
+  qi::Buffer buffer;
+  qi::encodeBinary(&buffer, value);
+  dp.start(name, count, buffer.size());
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    qi::Buffer buf;
+    qi::encodeBinary(&buf, value);
   }
-};
+  dp.stop();
+  out << dp;
+}
 
-TEST(Serialization, qiFloatStruct)
+template <typename T>
+static void decode(qi::DataPerfSuite& out, const std::string& name, const T& value, unsigned int count)
 {
-  qi::perf::DataPerfTimer dt;
-  for (unsigned int k = 0; k < kNumPowers; k++) {
-    unsigned int kNumFloats = (int)powf((float)2, k);
-    std::vector<float> f;
-    f.assign( kNumFloats, 1.1111098340f);
-
-    QiFloatStruct qfs;
-    qfs.f = f;
-    dt.start(kNumLoops, kNumFloats * sizeof(float));
-    for (unsigned int i=0; i<kNumLoops; i++) {
-      Message m;
-      Serializer s(ACTION_SERIALIZE, m);
-      qfs.accept(s);
-      //std::cout << m.str().size() << "---" << m.str() << std::endl;
-    }
-    dt.stop();
+  qi::DataPerf dp;
+  qi::Buffer buffer;
+  qi::encodeBinary(&buffer, value);
+  dp.start(name, count, buffer.size());
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    qi::BufferReader reader(buffer);
+    T result;
+    qi::decodeBinary(&reader, &result);
   }
+  dp.stop();
+  out << dp;
 }
 
-TEST(Serialization, boostVectorFloat)
+// Decode a raw buffer inline in the message, as received from a socket
+static void decodeRaw(qi::DataPerfSuite& out, const std::string& name, std::size_t size, unsigned int count)
 {
-  qi::perf::DataPerfTimer dt;
-  for (unsigned int k = 0; k < kNumPowers; k++) {
-    unsigned int kNumFloats = (int)powf((float)2, k);
-    std::vector<float> f;
-    f.assign( kNumFloats, 1.1111098340f);
-
-    dt.start(kNumLoops, kNumFloats * sizeof(float));
-    for (unsigned int i=0; i<kNumLoops; i++) {
-      std::string s = qi::serialization::BoostMessage::serialize(f);
-      //std::cout << s.size() << "---" << s << std::endl;
-    }
-    dt.stop();
+  qi::DataPerf dp;
+  qi::Buffer buffer;
+  qi::uint32_t rawSize = size;
+  buffer.write(&rawSize, sizeof(rawSize));
+  buffer.write(std::string(size, 'r').data(), size);
+  dp.start(name, count, buffer.size());
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    qi::BufferReader reader(buffer);
+    qi::Buffer result;
+    qi::decodeBinary(&reader, &result);
   }
+  dp.stop();
+  out << dp;
 }
 
-struct BoostFloatStruct {
-  std::vector<float> f;
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+
+  po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
+  desc.add_options()
+    ("help,h", "Print this help.")
+    ("count", po::value<unsigned int>()->default_value(100000), "Number of values (de)serialized per test.");
+
+  desc.add(qi::detail::getPerfOptions());
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+            .options(desc).allow_unregistered().run(), vm);
+  po::notify(vm);
 
-  template <typename Archive>
-  void serialize(Archive& a, const unsigned int version) {
-    a & f;
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
   }
-};
 
-TEST(Serialization, boostFloatStruct)
-{
-  qi::perf::DataPerfTimer dt;
-  for (unsigned int k = 0; k < kNumPowers; k++) {
-    unsigned int kNumFloats = (int)powf((float)2, k);
-    std::vector<float> f;
-    f.assign( kNumFloats, 1.1111098340f);
-
-    BoostFloatStruct bfs;
-    bfs.f = f;
-
-    dt.start(kNumLoops, kNumFloats * sizeof(float));
-    for (unsigned int i=0; i<kNumLoops; i++) {
-      std::string s = qi::serialization::BoostMessage::serialize(bfs);
-      //std::cout << s.size() << "---" << s << std::endl;
-    }
-    dt.stop();
+  qi::DataPerfSuite out("qimessaging", "perf_messaging_serialization", qi::DataPerfSuite::OutputData_Period, vm["output"].as<std::string>());
+
+  const unsigned int count = vm["count"].as<unsigned int>();
+
+  Sample one = sample(42);
+  encode(out, "Encode_Struct", one, count);
+  decode(out, "Decode_Struct", one, count);
+
+  for (unsigned int size = 16; size <= 1024; size *= 8)
+  {
+    std::vector<Sample> samples;
+    for (unsigned int i = 0; i < size; ++i)
+      samples.push_back(sample(i));
+    std::stringstream ss;
+    ss << "_" << size;
+    encode(out, "Encode_Struct_List" + ss.str(), samples, count / size);
+    decode(out, "Decode_Struct_List" + ss.str(), samples, count / size);
   }
-}
 
-#include "vfloat.pb.h"
+  for (unsigned int size = 16; size <= 16384; size *= 8)
+  {
+    std::vector<float> floats(size, 1.1111098340f);
+    std::vector<int> ints(size, 42);
+    std::stringstream ss;
+    ss << "_" << size;
+    encode(out, "Encode_Float_List" + ss.str(), floats, count / size + 1);
+    decode(out, "Decode_Float_List" + ss.str(), floats, count / size + 1);
+    encode(out, "Encode_Int_List" + ss.str(), ints, count / size + 1);
+    decode(out, "Decode_Int_List" + ss.str(), ints, count / size + 1);
+  }
 
-TEST(Serialization, pbFloatStruct)
-{
-  qi::perf::DataPerfTimer dt;
-  for (unsigned int k = 0; k < kNumPowers; k++) {
-    unsigned int kNumFloats = (int)powf((float)2, k);
-    VFloat vf;
-    for (unsigned int i=0; i < kNumFloats; i++) {
-      vf.add_f(1.1111098340f);
-    }
-
-
-    dt.start(kNumLoops, kNumFloats * sizeof(float));
-    for (unsigned int i=0; i<kNumLoops; i++) {
-      //vf.set_f(20, 1.78789f * i);
-      std::string s = vf.SerializeAsString();
-      //std::cout << s.size() << "---" << std::endl << s << std::endl;
-    }
-    dt.stop();
+  for (std::size_t size = 1 << 16; size <= 1 << 24; size <<= 4)
+  {
+    std::stringstream ss;
+    ss << "_" << size;
+    decodeRaw(out, "Decode_Raw" + ss.str(), size, count / 1000 + 1);
   }
+
+  return EXIT_SUCCESS;
 }
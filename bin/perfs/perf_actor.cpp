@@ -0,0 +1,141 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <iostream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+namespace po = boost::program_options;
+
+#include <qi/application.hpp>
+#include <qi/actor.hpp>
+#include <qi/atomic.hpp>
+#include <qi/eventloop.hpp>
+#include <qi/future.hpp>
+#include <qi/perf/dataperfsuite.hpp>
+
+/* Send messages to actors whose state fills a good part of a CPU cache, each
+ * message going through all of the state of its actor, on an event loop with
+ * the WorkStealing backend.
+ *
+ * Without affinity the jobs of an actor run on any thread, with affinity they
+ * stay on the thread which ran the previous ones, so their state stays in its
+ * caches. Migrations count the jobs which did not run on the same thread as
+ * the previous job of their actor.
+ *
+ * Set QI_EVENTLOOP_PIN_THREADS=1 to also pin the threads to CPUs.
+ */
+
+class CacheHeavyActor : public qi::Actor
+{
+public:
+  CacheHeavyActor(qi::EventLoop& loop, qi::Strand::Affinity affinity, unsigned int stateSize)
+    : qi::Actor(loop, affinity)
+    , _loop(loop)
+    , _state(stateSize / sizeof(unsigned int), 1)
+    , _lastThread(-1)
+    , _migrations(0)
+  {
+  }
+
+  void receive(qi::Atomic<int>* remaining, qi::Promise<void> done)
+  {
+    const int thread = _loop.currentThreadIndex();
+    if (_lastThread != -1 && thread != _lastThread)
+      ++_migrations;
+    _lastThread = thread;
+
+    unsigned int sum = 0;
+    for (std::size_t i = 0; i < _state.size(); ++i)
+    {
+      sum += _state[i];
+      _state[i] = sum;
+    }
+    if (--*remaining == 0)
+      done.setValue(0);
+  }
+
+  unsigned int migrations() const
+  {
+    return _migrations;
+  }
+
+private:
+  qi::EventLoop& _loop;
+  std::vector<unsigned int> _state;
+  int _lastThread;
+  unsigned int _migrations;
+};
+
+static void run(qi::DataPerfSuite& out, const std::string& name, qi::Strand::Affinity affinity,
+                int threads, unsigned int actorCount, unsigned int stateSize, unsigned int messages)
+{
+  qi::EventLoop loop(name, qi::EventLoop::Backend::WorkStealing);
+  loop.start(threads);
+  {
+    std::vector<boost::shared_ptr<CacheHeavyActor> > actors;
+    for (unsigned int i = 0; i < actorCount; ++i)
+      actors.push_back(boost::make_shared<CacheHeavyActor>(loop, affinity, stateSize));
+
+    qi::Atomic<int> remaining(messages * actorCount);
+    qi::Promise<void> done;
+    qi::DataPerf dp;
+    dp.start(name, messages * actorCount);
+    // in bursts, as an actor would receive events
+    for (unsigned int i = 0; i < messages; ++i)
+      for (unsigned int a = 0; a < actorCount; ++a)
+        actors[a]->strand()->post(boost::bind(&CacheHeavyActor::receive, actors[a].get(), &remaining, done));
+    done.future().wait();
+    dp.stop();
+    out << dp;
+
+    unsigned int migrations = 0;
+    for (unsigned int a = 0; a < actorCount; ++a)
+      migrations += actors[a]->migrations();
+    std::cout << name << " migrations: " << migrations << " of " << messages * actorCount << " jobs" << std::endl;
+  }
+  loop.stop();
+  loop.join();
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+
+  po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
+  desc.add_options()
+    ("help,h", "Print this help.")
+    ("actors", po::value<unsigned int>()->default_value(8), "Number of actors")
+    ("state", po::value<unsigned int>()->default_value(256), "Size of the state of each actor, in KiB")
+    ("messages", po::value<unsigned int>()->default_value(2000), "Number of messages sent to each actor")
+    ("threads", po::value<int>()->default_value(0), "Number of threads of the event loop, 0 for default");
+
+  desc.add(qi::detail::getPerfOptions());
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+            .options(desc).allow_unregistered().run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  qi::DataPerfSuite out("qimessaging", "perf_actor", qi::DataPerfSuite::OutputData_MsgPerSecond, vm["output"].as<std::string>());
+
+  const unsigned int actors = vm["actors"].as<unsigned int>();
+  const unsigned int stateSize = vm["state"].as<unsigned int>() * 1024;
+  const unsigned int messages = vm["messages"].as<unsigned int>();
+  const int threads = vm["threads"].as<int>();
+  run(out, "no_affinity", qi::Strand::Affinity::None, threads, actors, stateSize, messages);
+  run(out, "thread_affinity", qi::Strand::Affinity::Thread, threads, actors, stateSize, messages);
+
+  out.close();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/bind.hpp>
+
+namespace po = boost::program_options;
+
+#include <qi/application.hpp>
+#include <qi/atomic.hpp>
+#include <qi/clock.hpp>
+#include <qi/eventloop.hpp>
+#include <qi/future.hpp>
+#include <qi/perf/dataperfsuite.hpp>
+
+/* Post many tiny tasks to an event loop, with each backend:
+ * - from a thread outside of the loop,
+ * - from tasks of the loop, each task posting the next one of its chain,
+ * and measure the delay between the post of a task and its execution.
+ *
+ * Then schedule many delayed tasks, and cancel them, or let them expire.
+ */
+
+struct Counter
+{
+  Counter(unsigned int target)
+    : target(target)
+    , done(0)
+  {
+  }
+
+  void hit()
+  {
+    if (++done == static_cast<int>(target))
+      finished.setValue(0);
+  }
+
+  unsigned int target;
+  qi::Atomic<int> done;
+  qi::Promise<void> finished;
+};
+
+static void tinyTask(Counter* counter)
+{
+  counter->hit();
+}
+
+static void noop()
+{
+}
+
+static void chainTask(qi::EventLoop* loop, Counter* counter, unsigned int remaining)
+{
+  counter->hit();
+  if (remaining)
+    loop->post(boost::bind(&chainTask, loop, counter, remaining - 1));
+}
+
+struct Latency
+{
+  Latency()
+    : totalNs(0)
+    , maxNs(0)
+  {
+  }
+  std::atomic<long long> totalNs;
+  std::atomic<long long> maxNs;
+};
+
+static void latencyTask(Counter* counter, Latency* latency, qi::SteadyClock::time_point posted)
+{
+  long long ns = boost::chrono::duration_cast<qi::NanoSeconds>(qi::SteadyClock::now() - posted).count();
+  latency->totalNs += ns;
+  long long max = latency->maxNs.load();
+  while (ns > max && !latency->maxNs.compare_exchange_weak(max, ns))
+    ;
+  counter->hit();
+}
+
+static void runTimers(qi::DataPerfSuite& out, const std::string& backendName, qi::EventLoop& loop,
+                      unsigned int timerCount)
+{
+  qi::DataPerf dp;
+  std::vector<qi::Future<void> > futures;
+  futures.reserve(timerCount);
+
+  // Delays spread over several turns of the timer wheel
+  dp.start(backendName + "_timers_schedule", timerCount);
+  for (unsigned int i = 0; i < timerCount; ++i)
+    futures.push_back(loop.asyncDelay(&noop, qi::Seconds(10) + qi::MilliSeconds(i % 100000)));
+  dp.stop();
+  out << dp;
+
+  dp.start(backendName + "_timers_cancel", timerCount);
+  for (unsigned int i = 0; i < timerCount; ++i)
+    futures[i].cancel();
+  for (unsigned int i = 0; i < timerCount; ++i)
+    futures[i].wait();
+  dp.stop();
+  out << dp;
+  futures.clear();
+
+  Counter counter(timerCount);
+  dp.start(backendName + "_timers_expire", timerCount);
+  const qi::SteadyClockTimePoint start = qi::SteadyClock::now();
+  for (unsigned int i = 0; i < timerCount; ++i)
+    loop.post(boost::bind(&tinyTask, &counter), start + qi::MilliSeconds(i % 1000));
+  counter.finished.future().wait();
+  dp.stop();
+  out << dp;
+}
+
+static void run(qi::DataPerfSuite& out, const std::string& backendName, qi::EventLoop::Backend backend,
+                unsigned int taskCount, unsigned int timerCount, int threads)
+{
+  qi::DataPerf dp;
+  qi::EventLoop loop(backendName, backend);
+  loop.start(threads);
+
+  {
+    Counter counter(taskCount);
+    dp.start(backendName + "_post_external", taskCount);
+    for (unsigned int i = 0; i < taskCount; ++i)
+      loop.post(boost::bind(&tinyTask, &counter));
+    counter.finished.future().wait();
+    dp.stop();
+    out << dp;
+  }
+
+  {
+    const unsigned int chains = 64;
+    Counter counter(taskCount / chains * chains);
+    dp.start(backendName + "_post_internal", counter.target);
+    for (unsigned int i = 0; i < chains; ++i)
+      loop.post(boost::bind(&chainTask, &loop, &counter, taskCount / chains - 1));
+    counter.finished.future().wait();
+    dp.stop();
+    out << dp;
+  }
+
+  {
+    Counter counter(taskCount);
+    Latency latency;
+    for (unsigned int i = 0; i < taskCount; ++i)
+      loop.post(boost::bind(&latencyTask, &counter, &latency, qi::SteadyClock::now()));
+    counter.finished.future().wait();
+    std::cout << backendName << " latency: mean " << (latency.totalNs.load() / taskCount) / 1000.0
+              << "us, max " << latency.maxNs.load() / 1000.0 << "us" << std::endl;
+  }
+
+  if (timerCount)
+    runTimers(out, backendName, loop, timerCount);
+
+  loop.stop();
+  loop.join();
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+
+  po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
+  desc.add_options()
+    ("help,h", "Print this help.")
+    ("backend", po::value<std::string>()->default_value("all"), "asio, workstealing or all")
+    ("tasks", po::value<unsigned int>()->default_value(2000000), "Number of tasks of each run")
+    ("timers", po::value<unsigned int>()->default_value(1000000), "Number of delayed tasks of each run")
+    ("threads", po::value<int>()->default_value(0), "Number of threads of the event loop, 0 for default");
+
+  desc.add(qi::detail::getPerfOptions());
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+            .options(desc).allow_unregistered().run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  qi::DataPerfSuite out("qimessaging", "perf_eventloop", qi::DataPerfSuite::OutputData_Period, vm["output"].as<std::string>());
+
+  const std::string backend = vm["backend"].as<std::string>();
+  const unsigned int tasks = vm["tasks"].as<unsigned int>();
+  const unsigned int timers = vm["timers"].as<unsigned int>();
+  const int threads = vm["threads"].as<int>();
+  if (backend == "all" || backend == "asio")
+    run(out, "asio", qi::EventLoop::Backend::Asio, tasks, timers, threads);
+  if (backend == "all" || backend == "workstealing")
+    run(out, "workstealing", qi::EventLoop::Backend::WorkStealing, tasks, timers, threads);
+
+  out.close();
+  return EXIT_SUCCESS;
+}
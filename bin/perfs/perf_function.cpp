@@ -12,6 +12,7 @@
 namespace po = boost::program_options;
 
 #include <qi/application.hpp>
+#include <qi/anyfunction.hpp>
 #include <qi/atomic.hpp>
 #include <qi/signal.hpp>
 #include <qi/perf/dataperfsuite.hpp>
@@ -102,5 +103,40 @@ int main(int argc, char *argv[])
   dp.stop();
   out << dp;
 
+  // Test type-erased calls, with arguments of the expected types or not
+  qi::AnyFunction fInt = qi::AnyFunction::from(&fooInt);
+  dp.start("AnyFunction_int", 1000000);
+  for (unsigned int i = 0; i < 1000000; ++i) {
+    fInt.call<void>(1);
+  }
+  dp.stop();
+  out << dp;
+
+  dp.start("AnyFunction_int_from_double", 1000000);
+  for (unsigned int i = 0; i < 1000000; ++i) {
+    fInt.call<void>(1.0);
+  }
+  dp.stop();
+  out << dp;
+
+  int one = 1;
+  dp.start("AnyFunction_int_from_pointer", 1000000);
+  for (unsigned int i = 0; i < 1000000; ++i) {
+    fInt.call<void>(&one);
+  }
+  dp.stop();
+  out << dp;
+
+  qi::AnyFunction fSevenArgs = qi::AnyFunction::from(&fooSevenArgs);
+  dp.start("AnyFunction_7_int_from_long", 1000000);
+  for (unsigned int i = 0; i < 1000000; ++i) {
+    fSevenArgs.call<void>(1L, 1L, 1L, 1L, 1L, 1L);
+  }
+  dp.stop();
+  out << dp;
+
+  qi::AnyFunction::ConversionCacheStats stats = qi::AnyFunction::conversionCacheStats();
+  std::cout << "conversion cache: " << stats.hits << " hits, " << stats.misses << " misses" << std::endl;
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,168 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+
+namespace po = boost::program_options;
+
+#include <qi/application.hpp>
+#include <qi/atomic.hpp>
+#include <qi/future.hpp>
+#include <qi/perf/dataperfsuite.hpp>
+
+/* Measure the life cycle of futures when nobody blocks on them:
+ * - create a promise and set it,
+ * - connect a callback before setting the promise, or after,
+ * - chain continuations with then(),
+ * then when a thread sets promises another one is waiting for.
+ *
+ * Heap allocations are counted to report how many each step costs.
+ */
+
+static std::atomic<unsigned long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+static void reportAllocations(const std::string& name, unsigned long before, unsigned int count)
+{
+  std::cout << name << ": " << static_cast<double>(allocations.load() - before) / count
+            << " allocations" << std::endl;
+}
+
+static void onResult(const qi::Future<int>& future, qi::Atomic<int>* count)
+{
+  ++*count;
+}
+
+static int increment(const qi::Future<int>& future)
+{
+  return future.value() + 1;
+}
+
+static void setAll(std::vector<qi::Promise<int> >* promises)
+{
+  for (unsigned int i = 0; i < promises->size(); ++i)
+    (*promises)[i].setValue(i);
+}
+
+static void waitAll(std::vector<qi::Promise<int> >* promises)
+{
+  for (unsigned int i = 0; i < promises->size(); ++i)
+    (*promises)[i].future().wait();
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+
+  po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
+  desc.add_options()
+    ("help,h", "Print this help.")
+    ("count", po::value<unsigned int>()->default_value(1000000), "Number of futures of each run");
+
+  desc.add(qi::detail::getPerfOptions());
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+            .options(desc).allow_unregistered().run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  qi::DataPerfSuite out("qimessaging", "perf_future", qi::DataPerfSuite::OutputData_Period, vm["output"].as<std::string>());
+  const unsigned int count = vm["count"].as<unsigned int>();
+  qi::DataPerf dp;
+  qi::Atomic<int> called;
+
+  unsigned long before = allocations.load();
+  dp.start("future_set", count);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    qi::Promise<int> promise;
+    promise.setValue(i);
+    if (!promise.future().isFinished())
+      return EXIT_FAILURE;
+  }
+  dp.stop();
+  reportAllocations("future_set", before, count);
+  out << dp;
+
+  before = allocations.load();
+  dp.start("future_connect_then_set", count);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    qi::Promise<int> promise;
+    promise.future().connect(boost::bind(&onResult, _1, &called), qi::FutureCallbackType_Sync);
+    promise.setValue(i);
+  }
+  dp.stop();
+  reportAllocations("future_connect_then_set", before, count);
+  out << dp;
+
+  before = allocations.load();
+  dp.start("future_set_then_connect", count);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    qi::Promise<int> promise;
+    promise.setValue(i);
+    promise.future().connect(boost::bind(&onResult, _1, &called), qi::FutureCallbackType_Sync);
+  }
+  dp.stop();
+  reportAllocations("future_set_then_connect", before, count);
+  out << dp;
+
+  // each iteration attaches two continuations
+  before = allocations.load();
+  dp.start("future_then_chain", count);
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    qi::Promise<int> promise;
+    qi::Future<int> result = promise.future()
+      .then(qi::FutureCallbackType_Sync, &increment)
+      .then(qi::FutureCallbackType_Sync, &increment);
+    promise.setValue(i);
+    if (result.value() != static_cast<int>(i) + 2)
+      return EXIT_FAILURE;
+  }
+  dp.stop();
+  reportAllocations("future_then", before, 2 * count);
+  out << dp;
+
+  {
+    std::vector<qi::Promise<int> > promises(count);
+    dp.start("future_set_while_waiting", count);
+    boost::thread waiter(boost::bind(&waitAll, &promises));
+    setAll(&promises);
+    waiter.join();
+    dp.stop();
+    out << dp;
+  }
+
+  if (*called != static_cast<int>(2 * count))
+    return EXIT_FAILURE;
+  out.close();
+  return EXIT_SUCCESS;
+}
@@ -16,6 +16,10 @@ namespace po = boost::program_options;
 #include <qi/signal.hpp>
 #include <qi/perf/dataperfsuite.hpp>
 
+/* Trigger signals whose subscribers are called synchronously, from the
+ * thread of the emitter, so that only the cost of the emit is measured.
+ */
+
 qi::Atomic<int> glob(0);
 
 // It's not atomic!!
@@ -57,7 +61,8 @@ int main(int argc, char *argv[])
 
   po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
   desc.add_options()
-    ("help,h", "Print this help.");
+    ("help,h", "Print this help.")
+    ("count", po::value<unsigned int>()->default_value(100000), "Number of emits of each run");
   desc.add(qi::detail::getPerfOptions());
 
 
@@ -72,16 +77,18 @@ int main(int argc, char *argv[])
   }
 
   qi::DataPerfSuite out("qimessaging", "signal_direct", qi::DataPerfSuite::OutputData_Period, vm["output"].as<std::string>());
+  const unsigned int count = vm["count"].as<unsigned int>();
 
   qi::Signal<> signal_1;
+  signal_1.setCallType(qi::MetaCallType_Direct);
 
   signal_1.connect(boost::bind(&foo));
 
   qi::DataPerf dp;
 
   // Test signals without any arguments
-  dp.start("Signal_void", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_void", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_1();
     while (*glob != 1);
     resetAtomic(glob);
@@ -90,12 +97,13 @@ int main(int argc, char *argv[])
   out << dp;
 
   qi::Signal<int> signal_2;
+  signal_2.setCallType(qi::MetaCallType_Direct);
 
   signal_2.connect(boost::bind(&fooInt, _1));
 
   // Test signals with an int
-  dp.start("Signal_int", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_int", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_2(1);
     while (*glob != 1);
     resetAtomic(glob);
@@ -105,14 +113,15 @@ int main(int argc, char *argv[])
 
   // Test signals with a string of 32768 bytes
   qi::Signal<std::string> signal_3;
+  signal_3.setCallType(qi::MetaCallType_Direct);
 
   signal_3.connect(boost::bind(&fooStr, _1));
 
   std::string s;
   for (unsigned int i = 0; i < 65535; ++i)
     s += "a";
-  dp.start("Signal_Big_String", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_Big_String", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_3(s);
     while (*glob != 1);
     resetAtomic(glob);
@@ -124,8 +133,8 @@ int main(int argc, char *argv[])
   for (unsigned int i = 1; i < 10; ++i) {
     signal_2.connect(boost::bind(&fooInt, _1));
   }
-  dp.start("Signal_Int_10clients", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_Int_10clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_2(1);
 
     while (*glob != 10);
@@ -138,8 +147,8 @@ int main(int argc, char *argv[])
   for (unsigned int i = 1; i < 10; ++i) {
     signal_3.connect(boost::bind(&fooStr, _1));
   }
-  dp.start("Signal_Big_String_10clients", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_Big_String_10clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_3(s);
 
     while (*glob != 10);
@@ -150,11 +159,12 @@ int main(int argc, char *argv[])
 
   // Test signal with 10 args
   qi::Signal<int, int, int, int, int, int> signal_4;
+  signal_4.setCallType(qi::MetaCallType_Direct);
 
   signal_4.connect(boost::bind(&fooSevenArgs, _1, _2, _3, _4, _5, _6));
 
-  dp.start("Signal_7_int", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_7_int", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_4(1, 1, 1, 1, 1, 1);
 
     while (*glob != 1);
@@ -168,8 +178,8 @@ int main(int argc, char *argv[])
     signal_4.connect(boost::bind(&fooSevenArgs, _1, _2, _3, _4, _5, _6));
   }
 
-  dp.start("Signal_7_int_10_clients", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_7_int_10_clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_4(1, 1, 1, 1, 1, 1);
 
     while (*glob != 10);
@@ -178,5 +188,20 @@ int main(int argc, char *argv[])
   dp.stop();
   out << dp;
 
+  // Test signal with one int and 20 clients
+  for (unsigned int i = 10; i < 20; ++i) {
+    signal_2.connect(boost::bind(&fooInt, _1));
+  }
+  dp.start("Signal_Int_20clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
+    signal_2(1);
+
+    while (*glob != 20);
+    resetAtomic(glob);
+  }
+  dp.stop();
+  out << dp;
+
+  out.close();
   return EXIT_SUCCESS;
 }
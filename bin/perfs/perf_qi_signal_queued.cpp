@@ -6,8 +6,14 @@
 */
 
 
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
 #include <boost/bind.hpp>
 #include <boost/program_options.hpp>
+#include <boost/thread.hpp>
 
 namespace po = boost::program_options;
 
@@ -16,6 +22,34 @@ namespace po = boost::program_options;
 #include <qi/signal.hpp>
 #include <qi/perf/dataperfsuite.hpp>
 
+/* Trigger signals whose subscribers are queued on the event loop, so that
+ * the cost of scheduling the calls, and of copying their arguments, is
+ * measured along with the emit.
+ *
+ * Heap allocations are counted to report how many each emit costs.
+ */
+
+static std::atomic<unsigned long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+static void reportAllocations(const std::string& name, unsigned long before, unsigned int count)
+{
+  std::cout << name << ": " << static_cast<double>(allocations.load() - before) / count
+            << " allocations" << std::endl;
+}
+
 qi::Atomic<int> glob(0);
 
 // It's not atomic!!
@@ -26,6 +60,14 @@ static inline void resetAtomic(qi::Atomic<int>& val)
     --val;
 }
 
+// Let the event loop run the queued calls until expected calls are done
+static inline void waitCalls(int expected)
+{
+  while (*glob != expected)
+    boost::this_thread::yield();
+  resetAtomic(glob);
+}
+
 void foo()
 {
   ++glob;
@@ -57,9 +99,9 @@ int main(int argc, char *argv[])
 
   po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
   desc.add_options()
-    ("help,h", "Print this help.");
-
-  desc.add(qi::DataPerfSuite::getPerfOptions());
+    ("help,h", "Print this help.")
+    ("count", po::value<unsigned int>()->default_value(10000), "Number of emits of each run");
+  desc.add(qi::detail::getPerfOptions());
 
   po::variables_map vm;
   po::store(po::command_line_parser(argc, argv)
@@ -72,53 +114,51 @@ int main(int argc, char *argv[])
   }
 
   qi::DataPerfSuite out("qimessaging", "signal_queued", qi::DataPerfSuite::OutputData_Period, vm["output"].as<std::string>());
+  const unsigned int count = vm["count"].as<unsigned int>();
 
   qi::Signal<> signal_1;
+  signal_1.setCallType(qi::MetaCallType_Queued);
 
   signal_1.connect(boost::bind(&foo));
 
   qi::DataPerf dp;
 
   // Test signals without any arguments
-  dp.start("Signal_void", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_void", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_1();
-    while (*glob != 1)
-      ;
-    resetAtomic(glob);
+    waitCalls(1);
   }
   dp.stop();
   out << dp;
 
   qi::Signal<int> signal_2;
+  signal_2.setCallType(qi::MetaCallType_Queued);
 
   signal_2.connect(boost::bind(&fooInt, _1));
 
   // Test signals with an int
-  dp.start("Signal_int", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_int", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_2(1);
-    while (*glob != 1)
-      ;
-    resetAtomic(glob);
+    waitCalls(1);
   }
   dp.stop();
   out << dp;
 
   // Test signals with a string of 32768 bytes
   qi::Signal<std::string> signal_3;
+  signal_3.setCallType(qi::MetaCallType_Queued);
 
   signal_3.connect(boost::bind(&fooStr, _1));
 
   std::string s;
   for (unsigned int i = 0; i < 65535; ++i)
     s += "a";
-  dp.start("Signal_Big_String", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_Big_String", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_3(s);
-    while (*glob != 1)
-      ;
-    resetAtomic(glob);
+    waitCalls(1);
   }
   dp.stop();
   out << dp;
@@ -127,13 +167,10 @@ int main(int argc, char *argv[])
   for (unsigned int i = 1; i < 10; ++i) {
     signal_2.connect(boost::bind(&fooInt, _1));
   }
-  dp.start("Signal_Int_10clients", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_Int_10clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_2(1);
-
-    while (*glob != 10)
-      ;
-    resetAtomic(glob);
+    waitCalls(10);
   }
   dp.stop();
   out << dp;
@@ -142,29 +179,26 @@ int main(int argc, char *argv[])
   for (unsigned int i = 1; i < 10; ++i) {
     signal_3.connect(boost::bind(&fooStr, _1));
   }
-  dp.start("Signal_Big_String_10clients", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  unsigned long before = allocations.load();
+  dp.start("Signal_Big_String_10clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_3(s);
-
-    while (*glob != 10)
-      ;
-    resetAtomic(glob);
+    waitCalls(10);
   }
   dp.stop();
+  reportAllocations("Signal_Big_String_10clients", before, count);
   out << dp;
 
   // Test signal with 10 args
   qi::Signal<int, int, int, int, int, int> signal_4;
+  signal_4.setCallType(qi::MetaCallType_Queued);
 
   signal_4.connect(boost::bind(&fooSevenArgs, _1, _2, _3, _4, _5, _6));
 
-  dp.start("Signal_7_int", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_7_int", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_4(1, 1, 1, 1, 1, 1);
-
-    while (*glob != 1)
-      ;
-    resetAtomic(glob);
+    waitCalls(1);
   }
   dp.stop();
   out << dp;
@@ -174,16 +208,36 @@ int main(int argc, char *argv[])
     signal_4.connect(boost::bind(&fooSevenArgs, _1, _2, _3, _4, _5, _6));
   }
 
-  dp.start("Signal_7_int_10_clients", 10000);
-  for (unsigned int i = 0; i < 10000; ++i) {
+  dp.start("Signal_7_int_10_clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
     signal_4(1, 1, 1, 1, 1, 1);
+    waitCalls(10);
+  }
+  dp.stop();
+  out << dp;
 
-    while (*glob != 10)
-      ;
-    resetAtomic(glob);
+  // Test signal with one int and 20 clients
+  for (unsigned int i = 10; i < 20; ++i) {
+    signal_2.connect(boost::bind(&fooInt, _1));
+  }
+  dp.start("Signal_Int_20clients", count);
+  for (unsigned int i = 0; i < count; ++i) {
+    signal_2(1);
+    waitCalls(20);
   }
   dp.stop();
   out << dp;
 
+  // Test signal with 10 args and 10 clients, without waiting between emits
+  before = allocations.load();
+  dp.start("Signal_7_int_10_clients_burst", count);
+  for (unsigned int i = 0; i < count; ++i)
+    signal_4(1, 1, 1, 1, 1, 1);
+  waitCalls(10 * count);
+  dp.stop();
+  reportAllocations("Signal_7_int_10_clients_burst", before, count);
+  out << dp;
+
+  out.close();
   return EXIT_SUCCESS;
 }
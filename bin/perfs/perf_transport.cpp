@@ -20,6 +20,7 @@
 namespace po = boost::program_options;
 
 #include <qi/os.hpp>
+#include <qi/atomic.hpp>
 #include <qi/application.hpp>
 #include <qi/url.hpp>
 #include <qi/session.hpp>
@@ -47,8 +48,10 @@ static int rend = 20;
 static int pipeline = 1;
 static bool threadsafe = false;
 static int msDelay = 0;
+static int burstCount = 0;
+static qi::Atomic<int> burstReceivedCount(0);
 
-static int run_client(qi::AnyObject obj);
+static int run_client(qi::AnyObject obj, const std::string& name = "transport");
 
 std::string reply(const std::string &msg)
 {
@@ -67,6 +70,16 @@ qi::Buffer replyBuf(const qi::Buffer& buf)
   return res;
 }
 
+void burstSink(int)
+{
+  ++burstReceivedCount;
+}
+
+int burstReceived()
+{
+  return *burstReceivedCount;
+}
+
 qi::AnyObject make_service()
 {
   qi::DynamicObjectBuilder ob;
@@ -74,6 +87,8 @@ qi::AnyObject make_service()
     ob.setThreadingModel(qi::ObjectThreadingModel_MultiThread);
   ob.advertiseMethod("reply", &reply);
   ob.advertiseMethod("replyBuf", &replyBuf);
+  ob.advertiseMethod("burstSink", &burstSink);
+  ob.advertiseMethod("burstReceived", &burstReceived);
   qi::AnyObject obj(ob.object());
   return obj;
 }
@@ -112,7 +127,7 @@ int main_client(std::string QI_UNUSED(src))
 }
 
 
-int run_client(qi::AnyObject obj)
+int run_client(qi::AnyObject obj, const std::string& name)
 {
   qi::DataPerf dp;
 
@@ -120,7 +135,7 @@ int run_client(qi::AnyObject obj)
   for (int i = rstart; i < rend; i+=2)
   {
     std::ostringstream oss(std::ostringstream::out);
-    oss << "transport_" << numBytes << "b";
+    oss << name << "_" << numBytes << "b";
 
     qi::Buffer buf;
     buf.reserve(numBytes);
@@ -146,6 +161,73 @@ int run_client(qi::AnyObject obj)
   return 0;
 }
 
+/* Post burstCount small messages as fast as possible, so that the client
+ * socket send queue fills up, and measure messages/s until the service
+ * received all of them.
+ * Run once with one write per message and once with batched writes.
+ */
+int main_burst()
+{
+  const unsigned int batchSizes[] = { 1, 64 };
+  for (unsigned int i = 0; i < sizeof(batchSizes) / sizeof(batchSizes[0]); ++i)
+  {
+    // Sockets read their send batch limits on creation
+    qi::os::setenv("QI_TCP_SEND_BATCH_MAX_MESSAGES",
+                   boost::lexical_cast<std::string>(batchSizes[i]).c_str());
+    qi::Session sd;
+    sd.listenStandalone("tcp://127.0.0.1:0");
+    sd.registerService("serviceTest", make_service());
+    qi::Session client;
+    client.connect(sd.endpoints()[0]);
+    qi::AnyObject obj = client.service("serviceTest");
+    burstReceivedCount = 0;
+
+    std::ostringstream oss;
+    oss << "transport_burst_batch" << batchSizes[i];
+    qi::DataPerf dp;
+    dp.start(oss.str(), burstCount);
+    for (int j = 0; j < burstCount; ++j)
+      obj.post("burstSink", j);
+    while (obj.call<int>("burstReceived") < burstCount)
+      qi::os::msleep(1);
+    dp.stop();
+    *out << dp;
+    std::cerr << oss.str() << ": "
+              << dp.getMsgPerSecond() << " messages/s" << std::endl;
+  }
+  return 0;
+}
+
+/* Run the client benchmark against a service of the same machine, first
+ * reached through TCP loopback, then through a local socket.
+ */
+int main_compare_local()
+{
+  const std::string serviceUrls[] = {
+    "tcp://127.0.0.1:0",
+    "unix://" + qi::os::tmp() + "/perf_transport.sock"
+  };
+  const std::string names[] = { "transport_tcp", "transport_unix" };
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    qi::Session sd;
+    sd.listenStandalone("tcp://127.0.0.1:0");
+    qi::Session server;
+    server.connect(sd.endpoints()[0]);
+    if (server.listen(serviceUrls[i]).hasError())
+    {
+      std::cerr << "Can't listen on " << serviceUrls[i] << std::endl;
+      return 1;
+    }
+    server.registerService("serviceTest", make_service());
+    // The socket cache prefers local sockets for services of the same machine
+    qi::Session client;
+    client.connect(sd.endpoints()[0]);
+    run_client(client.service("serviceTest").value(), names[i]);
+  }
+  return 0;
+}
+
 void start_client(int count)
 {
   boost::thread thd[100];
@@ -233,6 +315,8 @@ int main(int argc, char **argv)
     ("pipeline", po::value<int>()->default_value(1, "1"), "Max number of parallel calls to run")
     ("threadsafe", po::bool_switch()->default_value(false), "Declare threadsafe service")
     ("msdelay", po::value<int>()->default_value(0, "0"), "Delay in milliseconds to simulate long call")
+    ("burst", po::value<int>(), "Post that many messages in a burst, with and without batched socket writes.")
+    ("compare-local", "Compare TCP loopback and local socket on the same machine.")
     ;
 
   desc.add(qi::detail::getPerfOptions());
@@ -256,8 +340,8 @@ int main(int argc, char **argv)
   }
 
 
-  if (vm.count("client") + vm.count("server") + !vm["all"].defaulted() + vm.count("gateway") + vm.count("local") > 1) {
-    std::cerr << desc << std::endl << "You must put at most one option between [all|client|server|gateway|local]" << std::endl;
+  if (vm.count("client") + vm.count("server") + !vm["all"].defaulted() + vm.count("gateway") + vm.count("local") + vm.count("burst") + vm.count("compare-local") > 1) {
+    std::cerr << desc << std::endl << "You must put at most one option between [all|client|server|gateway|local|burst|compare-local]" << std::endl;
     return EXIT_FAILURE;
   }
 
@@ -286,6 +370,11 @@ int main(int argc, char **argv)
     return main_gateway(serverUrl);
   } else if (vm.count("local")) {
     return main_local();
+  } else if (vm.count("compare-local")) {
+    main_compare_local();
+  } else if (vm.count("burst")) {
+    burstCount = vm["burst"].as<int>();
+    main_burst();
   } else {
     //start the server
     int threadc = vm["thread"].as<int>();
@@ -0,0 +1,100 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace po = boost::program_options;
+
+#include <qi/application.hpp>
+#include <qi/anyvalue.hpp>
+#include <qi/type/typeinterface.hpp>
+#include <qi/perf/dataperfsuite.hpp>
+
+/* Look types up from several threads at once, as AnyReference::from and the
+ * conversions do: registered types, types that were never registered, and
+ * types built by the list and map factories.
+ * The rate should grow with the number of threads.
+ */
+
+static void lookup(unsigned int count, qi::TypeInterface** sink)
+{
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    *sink = qi::typeOf<int>();
+    *sink = qi::typeOf<std::string>();
+    *sink = qi::typeOf<std::vector<double> >();
+    *sink = qi::typeOf<std::map<std::string, float> >();
+  }
+}
+
+static void makeTypes(unsigned int count, qi::TypeInterface** sink)
+{
+  qi::TypeInterface* element = qi::typeOf<int>();
+  qi::TypeInterface* key = qi::typeOf<std::string>();
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    *sink = qi::makeListType(element);
+    *sink = qi::makeMapType(key, element);
+  }
+}
+
+static void run(qi::DataPerfSuite& out, const std::string& name,
+                void (*work)(unsigned int, qi::TypeInterface**),
+                unsigned int threads, unsigned int count)
+{
+  std::vector<qi::TypeInterface*> sinks(threads * 16);
+  std::stringstream ss;
+  ss << name << "_" << threads;
+  qi::DataPerf dp;
+  dp.start(ss.str(), count * threads);
+  boost::thread_group group;
+  for (unsigned int t = 0; t < threads; ++t)
+    group.create_thread(boost::bind(work, count, &sinks[t * 16]));
+  group.join_all();
+  dp.stop();
+  out << dp;
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+
+  po::options_description desc(std::string("Usage:\n ")+argv[0]+"\n");
+  desc.add_options()
+    ("help,h", "Print this help.")
+    ("count", po::value<unsigned int>()->default_value(1000000), "Number of lookups per thread.")
+    ("threads", po::value<unsigned int>()->default_value(8), "Maximum number of threads.");
+
+  desc.add(qi::detail::getPerfOptions());
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv)
+            .options(desc).allow_unregistered().run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  qi::DataPerfSuite out("qitype", "perf_typeof", qi::DataPerfSuite::OutputData_Period, vm["output"].as<std::string>());
+
+  const unsigned int count = vm["count"].as<unsigned int>();
+  const unsigned int maxThreads = vm["threads"].as<unsigned int>();
+  for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    run(out, "TypeOf", &lookup, threads, count);
+    run(out, "MakeType", &makeTypes, threads, count);
+  }
+
+  return EXIT_SUCCESS;
+}
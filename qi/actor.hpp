@@ -34,6 +34,9 @@ public:
   explicit Actor(qi::ExecutionContext& ec)
     : _strand(ec)
   {}
+  Actor(qi::ExecutionContext& ec, qi::Strand::Affinity affinity)
+    : _strand(ec, affinity)
+  {}
 
   qi::Strand* strand() const
   {
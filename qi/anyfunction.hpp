@@ -246,6 +246,16 @@ QI_GEN(genCall)
      */
     static AnyFunction fromDynamicFunction(DynamicFunction f);
 
+    /// Counters of the argument conversion plans reused by call()
+    struct ConversionCacheStats
+    {
+      std::size_t hits;   // call() knew how to convert its arguments
+      std::size_t misses; // call() looked for a conversion of each argument
+    };
+
+    /// @return the counters of all the functions called so far
+    static ConversionCacheStats conversionCacheStats();
+
   private:
     FunctionTypeInterface* type;
     void* value; //type-dependant storage
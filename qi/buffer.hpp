@@ -185,6 +185,19 @@ namespace qi
      */
     const void* data() const;
 
+    /**
+     * \brief Return a buffer sharing \a size bytes of this buffer at \a offset.
+     * \param offset offset of the first byte of the slice.
+     * \param size number of bytes of the slice.
+     * \return an empty buffer if the range goes past the end of the buffer.
+     *
+     * The bytes are not copied: the slice keeps the storage of this buffer
+     * alive, and writing past its end moves it to its own storage. This buffer
+     * can still be written to and cleared, without changing the slice.
+     * Sub-buffers are not part of the slice.
+     */
+    Buffer slice(size_t offset, size_t size) const;
+
     /**
      * \brief Read some data from the buffer.
      * \param offset offset at which reading begin in the buffer.
@@ -210,6 +223,8 @@ namespace qi
 
   private:
     friend class BufferReader;
+    friend class MessagePool;
+    friend class SharedMemoryBuffer;
     // CS4251
     boost::shared_ptr<BufferPrivate> _p;
   };
@@ -262,6 +277,13 @@ namespace qi
      */
     void  *peek(size_t offset) const;
 
+    /**
+     * \brief Read \a size bytes as a buffer sharing them, see Buffer::slice().
+     * \param size Number of bytes to read.
+     * \return an empty buffer, without moving the cursor, if less than \a size
+     * bytes are left.
+     */
+    Buffer readSlice(size_t size);
 
     /**
      * \brief Check if there is sub-buffer at the actual position.
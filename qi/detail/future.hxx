@@ -10,6 +10,7 @@
 #include <vector>
 #include <utility> // pair
 #include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include <qi/eventloop.hpp>
 #include <qi/actor.hpp>
 #include <qi/type/detail/futureadapter.hpp>
@@ -22,8 +23,8 @@ namespace detail {
   template <typename T, typename R>
   struct Caller
   {
-    inline static R _callfunc(const T& arg,
-        const boost::function<R(const T&)>& func)
+    template <typename F>
+    inline static R _callfunc(const T& arg, F& func)
     {
       return func(arg);
     }
@@ -32,18 +33,37 @@ namespace detail {
   template <typename T>
   struct Caller<T, void>
   {
-    inline static void* _callfunc(const T& future,
-        const boost::function<void(const T&)>& func)
+    template <typename F>
+    inline static void* _callfunc(const T& future, F& func)
     {
       func(future);
       return 0;
     }
   };
 
-  template <typename T, typename R>
-  void continueThen(const Future<T>& future,
-      const boost::function<R(const Future<T>&)>& func,
-      qi::Promise<R>& promise)
+  /* Callback of the future a continuation is attached to.
+   *
+   * It replaces a boost::bind of the continuation, which would evaluate func
+   * if it is a bind expression itself, and keeps the callback small enough to
+   * be stored in place.
+   */
+  template <typename T, typename R, typename F,
+            void (*Continue)(const Future<T>&, F&, qi::Promise<R>&)>
+  struct Continuation
+  {
+    using result_type = void;
+
+    F func;
+    qi::Promise<R> promise;
+
+    void operator()(const Future<T>& future)
+    {
+      Continue(future, func, promise);
+    }
+  };
+
+  template <typename T, typename R, typename F>
+  void continueThen(const Future<T>& future, F& func, qi::Promise<R>& promise)
   {
     try
     {
@@ -59,10 +79,8 @@ namespace detail {
     }
   }
 
-  template <typename T, typename R>
-  void continueThenAsync(const Future<T>& future,
-      const boost::function<qi::Future<R>(const Future<T>&)>& func,
-      qi::Promise<R>& promise)
+  template <typename T, typename R, typename F>
+  void continueThenAsync(const Future<T>& future, F& func, qi::Promise<R>& promise)
   {
     try
     {
@@ -85,14 +103,10 @@ namespace detail {
   template <typename T, typename R>
   struct ContinueThenMaybeAsync<true, T, R>
   {
-    template <typename AF>
-    static boost::function<void(const Future<T>&)> makeFunc(AF&& func, const qi::Promise<R>& promise)
+    template <typename AF, typename F = typename std::decay<AF>::type>
+    static Continuation<T, R, F, &continueThenAsync<T, R, F> > makeFunc(AF&& func, const qi::Promise<R>& promise)
     {
-      return boost::bind(&detail::continueThenAsync<T, R>,
-                         _1,
-                         // this cast seems necessary :(
-                         boost::function<qi::Future<R>(const Future<T>&)>(std::forward<AF>(func)),
-                         promise);
+      return { std::forward<AF>(func), promise };
     }
   };
 
@@ -107,10 +121,8 @@ namespace detail {
     }
   };
 
-  template <typename T, typename R>
-  void continueAndThen(const Future<T>& future,
-      const boost::function<R(const typename Future<T>::ValueType&)>& func,
-      qi::Promise<R>& promise)
+  template <typename T, typename R, typename F>
+  void continueAndThen(const Future<T>& future, F& func, qi::Promise<R>& promise)
   {
     if (future.isCanceled())
       promise.setCanceled();
@@ -135,10 +147,8 @@ namespace detail {
     }
   }
 
-  template <typename T, typename R>
-  void continueAndThenAsync(const Future<T>& future,
-      const boost::function<qi::Future<R>(const typename Future<T>::ValueType&)>& func,
-      qi::Promise<R>& promise)
+  template <typename T, typename R, typename F>
+  void continueAndThenAsync(const Future<T>& future, F& func, qi::Promise<R>& promise)
   {
     if (future.isCanceled())
       promise.setCanceled();
@@ -170,14 +180,10 @@ namespace detail {
   template <typename T, typename R>
   struct ContinueAndThenMaybeAsync<true, T, R>
   {
-    template <typename AF>
-    static boost::function<void(const Future<T>&)> makeFunc(AF&& func, const qi::Promise<R>& promise)
+    template <typename AF, typename F = typename std::decay<AF>::type>
+    static Continuation<T, R, F, &continueAndThenAsync<T, R, F> > makeFunc(AF&& func, const qi::Promise<R>& promise)
     {
-      return boost::bind(&detail::continueAndThenAsync<T, R>,
-                         _1,
-                         // this cast seems necessary :(
-                         boost::function<qi::Future<R>(const typename Future<T>::ValueType&)>(std::forward<AF>(func)),
-                         promise);
+      return { std::forward<AF>(func), promise };
     }
   };
 
@@ -214,13 +220,9 @@ namespace detail {
     }
     else
     {
+      using F = typename std::decay<AF>::type;
       _p->connect(*this,
-          boost::bind(
-            &detail::continueThen<T, R>,
-            _1,
-            // this cast seems necessary :(
-            boost::function<R(const Future<T>&)>(std::forward<AF>(func)),
-            promise),
+          detail::Continuation<T, R, F, &detail::continueThen<T, R, F> >{ std::forward<AF>(func), promise },
           type);
     }
     return promise.future();
@@ -246,13 +248,10 @@ namespace detail {
     }
     else
     {
+      using F = typename std::decay<AF>::type;
       _p->connect(*this,
-                  boost::bind(&detail::continueAndThen<T, R>,
-                              _1,
-                              // this cast seems necessary :(
-                              boost::function<R(const typename Future<T>::ValueType&)>(std::forward<AF>(func)),
-                              promise),
-                  type);
+          detail::Continuation<T, R, F, &detail::continueAndThen<T, R, F> >{ std::forward<AF>(func), promise },
+          type);
     }
     return promise.future();
   }
@@ -304,6 +303,43 @@ namespace detail {
     {
       if (_onDestroyed && hasValue(0))
         _onDestroyed(_value);
+      Callback* callback = *_onResult;
+      while (callback && callback != closed())
+      {
+        Callback* next = callback->next;
+        deleteCallback(callback);
+        callback = next;
+      }
+    }
+
+    template <typename T>
+    typename FutureBaseTyped<T>::Callback* FutureBaseTyped<T>::newCallback()
+    {
+      if (_firstCallbackUsed.setIfEquals(0, 1))
+        return &_firstCallback;
+      return new Callback();
+    }
+
+    template <typename T>
+    void FutureBaseTyped<T>::deleteCallback(Callback* callback)
+    {
+      if (callback == &_firstCallback)
+        _firstCallback.callback.clear();
+      else
+        delete callback;
+    }
+
+    template <typename T>
+    void FutureBaseTyped<T>::lockOnCancel()
+    {
+      while (!_onCancelLock.setIfEquals(0, 1))
+        boost::this_thread::yield();
+    }
+
+    template <typename T>
+    void FutureBaseTyped<T>::unlockOnCancel()
+    {
+      _onCancelLock = 0;
     }
 
     template <typename T>
@@ -311,11 +347,18 @@ namespace detail {
     {
       CancelCallback onCancel;
       {
-        boost::recursive_mutex::scoped_lock lock(mutex());
-        if (isFinished())
+        lockOnCancel();
+        // not isFinished(): it stays false while sync callbacks run, once the
+        // result is already set
+        const bool finished = isResultReserved();
+        if (!finished)
+        {
+          requestCancel();
+          onCancel = _onCancel;
+        }
+        unlockOnCancel();
+        if (finished)
           return;
-        requestCancel();
-        onCancel = _onCancel;
       }
       if (onCancel)
       {
@@ -329,45 +372,66 @@ namespace detail {
     {
       bool doCancel = false;
       {
-        boost::recursive_mutex::scoped_lock lock(mutex());
-        _onCancel = onCancel;
+        lockOnCancel();
+        _onCancel.swap(onCancel);
         doCancel = isCancelRequested();
+        unlockOnCancel();
       }
       qi::Future<T> fut = promise.future();
       if (doCancel)
         cancel(fut);
     }
 
+    template <typename T>
+    void FutureBaseTyped<T>::callCallback(qi::Future<T>& future, Callback& callback)
+    {
+      const bool async = [&]{
+        if (callback.callType != FutureCallbackType_Auto)
+          return callback.callType != FutureCallbackType_Sync;
+        else
+          return _async != FutureCallbackType_Sync;
+      }();
+
+      if (async)
+        getEventLoop()->post(boost::bind(std::move(callback.callback), future));
+      else
+        try
+        {
+          callback.callback(future);
+        }
+        catch (const qi::PointerLockException&)
+        { // do nothing
+        }
+        catch (const std::exception& e)
+        {
+          qiLogError("qi.future") << "Exception caught in future callback " << e.what();
+        }
+        catch (...)
+        {
+          qiLogError("qi.future") << "Unknown exception caught in future callback";
+        }
+    }
+
     template <typename T>
     void FutureBaseTyped<T>::callCbNotify(qi::Future<T>& future)
     {
-      for (unsigned i = 0; i < _onResult.size(); ++i)
+      // The result is published: from now on connect() calls the callbacks
+      // itself, take the ones connected before, in connection order
+      Callback* callback = _onResult.swap(closed());
+      Callback* ordered = nullptr;
+      while (callback)
       {
-        const bool async = [&]{
-          if (_onResult[i].callType != FutureCallbackType_Auto)
-            return _onResult[i].callType != FutureCallbackType_Sync;
-          else
-            return _async != FutureCallbackType_Sync;
-        }();
-
-        if (async)
-          getEventLoop()->post(boost::bind(_onResult[i].callback, future));
-        else
-          try
-          {
-            _onResult[i].callback(future);
-          }
-          catch (const qi::PointerLockException&)
-          { // do nothing
-          }
-          catch (const std::exception& e)
-          {
-            qiLogError("qi.future") << "Exception caught in future callback " << e.what();
-          }
-          catch (...)
-          {
-            qiLogError("qi.future") << "Unknown exception caught in future callback";
-          }
+        Callback* next = callback->next;
+        callback->next = ordered;
+        ordered = callback;
+        callback = next;
+      }
+      while (ordered)
+      {
+        Callback* next = ordered->next;
+        callCallback(future, *ordered);
+        deleteCallback(ordered);
+        ordered = next;
       }
       notifyFinish();
       clearCallbacks();
@@ -376,11 +440,9 @@ namespace detail {
     template <typename T>
     void FutureBaseTyped<T>::setValue(qi::Future<T>& future, const ValueType& value)
     {
-      // report-ready + onResult() must be Atomic to avoid
-      // missing callbacks/double calls in case connect() is invoked at
-      // the same time
-      boost::recursive_mutex::scoped_lock lock(mutex());
-      if (!isRunning())
+      // Only one setter may write the value, and it must be written before
+      // the state is published
+      if (!reserveResult())
         throw FutureException(FutureException::ExceptionState_PromiseAlreadySet);
 
       _value = value;
@@ -391,11 +453,7 @@ namespace detail {
     template <typename T>
     void FutureBaseTyped<T>::set(qi::Future<T>& future)
     {
-      // report-ready + onResult() must be Atomic to avoid
-      // missing callbacks/double calls in case connect() is invoked at
-      // the same time
-      boost::recursive_mutex::scoped_lock lock(mutex());
-      if (!isRunning())
+      if (!reserveResult())
         throw FutureException(FutureException::ExceptionState_PromiseAlreadySet);
 
       reportValue();
@@ -405,8 +463,7 @@ namespace detail {
     template <typename T>
     void FutureBaseTyped<T>::setError(qi::Future<T>& future, const std::string& message)
     {
-      boost::recursive_mutex::scoped_lock lock(mutex());
-      if (!isRunning())
+      if (!reserveResult())
         throw FutureException(FutureException::ExceptionState_PromiseAlreadySet);
 
       reportError(message);
@@ -416,8 +473,11 @@ namespace detail {
     template <typename T>
     void FutureBaseTyped<T>::setBroken(qi::Future<T>& future)
     {
-      boost::recursive_mutex::scoped_lock lock(mutex());
-      assert(isRunning());
+      if (!reserveResult())
+      {
+        assert(false && "broken promise already set");
+        return;
+      }
 
       reportError("Promise broken (all promises are destroyed)");
       callCbNotify(future);
@@ -426,8 +486,7 @@ namespace detail {
     template <typename T>
     void FutureBaseTyped<T>::setCanceled(qi::Future<T>& future)
     {
-      boost::recursive_mutex::scoped_lock lock(mutex());
-      if (!isRunning())
+      if (!reserveResult())
         throw FutureException(FutureException::ExceptionState_PromiseAlreadySet);
 
       reportCanceled();
@@ -441,42 +500,47 @@ namespace detail {
     }
 
     template <typename T>
-    void FutureBaseTyped<T>::connect(qi::Future<T> future,
-                                  const boost::function<void(qi::Future<T>)>& s,
-                                  FutureCallbackType type)
+    template <typename F>
+    void FutureBaseTyped<T>::connect(qi::Future<T> future, F&& s, FutureCallbackType type)
     {
       if (state() == FutureState_None)
         throw FutureException(FutureException::ExceptionState_FutureInvalid);
 
-      bool ready;
+      CallbackType callback(std::forward<F>(s));
+      Callback* head = *_onResult;
+      if (head != closed())
       {
-        boost::recursive_mutex::scoped_lock lock(mutex());
-        ready = isFinished();
-        if (!ready)
-          _onResult.push_back(Callback(s, type));
+        Callback* node = newCallback();
+        node->callback = std::move(callback);
+        node->callType = type;
+        do
+        {
+          node->next = head;
+          if (_onResult._value.compare_exchange_weak(head, node))
+            return;
+        } while (head != closed());
+        callback = std::move(node->callback);
+        deleteCallback(node);
       }
 
       // result already ready, notify the callback
-      if (ready)
-      {
-        const bool async = [&]{
-          if (type != FutureCallbackType_Auto)
-            return type != FutureCallbackType_Sync;
-          else
-            return _async != FutureCallbackType_Sync;
-        }();
-
-        if (async)
-          getEventLoop()->post(boost::bind(s, future));
+      const bool async = [&]{
+        if (type != FutureCallbackType_Auto)
+          return type != FutureCallbackType_Sync;
         else
+          return _async != FutureCallbackType_Sync;
+      }();
+
+      if (async)
+        getEventLoop()->post(boost::bind(std::move(callback), future));
+      else
+      {
+        try
         {
-          try
-          {
-            s(future);
-          }
-          catch (const ::qi::PointerLockException&)
-          { /*do nothing*/
-          }
+          callback(future);
+        }
+        catch (const ::qi::PointerLockException&)
+        { /*do nothing*/
         }
       }
     }
@@ -499,11 +563,15 @@ namespace detail {
     template <typename T>
     void FutureBaseTyped<T>::clearCallbacks()
     {
-      _onResult.clear();
+      // Release what the cancel callback holds, outside of the lock
+      CancelCallback onCancel;
+      lockOnCancel();
       if (_onCancel)
       {
-        _onCancel = CancelCallback(PromiseNoop<T>);
+        onCancel = CancelCallback(PromiseNoop<T>);
+        _onCancel.swap(onCancel);
       }
+      unlockOnCancel();
     }
 
     template <typename T>
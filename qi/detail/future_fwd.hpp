@@ -15,6 +15,7 @@
 # include <qi/trackable.hpp>
 # include <qi/clock.hpp>
 # include <qi/detail/mpl.hpp>
+# include <qi/detail/smallfunction.hpp>
 
 # include <boost/shared_ptr.hpp>
 # include <boost/make_shared.hpp>
@@ -803,10 +804,11 @@ namespace qi {
     }
 
   protected:
-    void setup(boost::function<void (qi::Promise<T>&)> cancelCallback, FutureCallbackType async = FutureCallbackType_Auto)
+    void setup(typename detail::FutureBaseTyped<T>::CancelCallback cancelCallback,
+               FutureCallbackType async = FutureCallbackType_Auto)
     {
       this->_f._p->reportStart();
-      this->_f._p->setOnCancel(*this, cancelCallback);
+      this->_f._p->setOnCancel(*this, std::move(cancelCallback));
       this->_f._p->_async = async;
     }
     explicit Promise(Future<T>& f) : _f(f) {
@@ -859,11 +861,17 @@ namespace qi {
       void reportStart();
 
     protected:
+      /// Reserve the right to set the result, false if it is already set or being set.
+      bool reserveResult();
+      /// True once a setter has reserved the result, even if not yet published.
+      bool isResultReserved() const;
+      /// Deprecated: futures no longer lock, kept for binary compatibility.
+      QI_API_DEPRECATED boost::recursive_mutex& mutex();
       void reportValue();
       void reportError(const std::string &message);
       void requestCancel();
       void reportCanceled();
-      boost::recursive_mutex& mutex();
+      /// Wake up the threads blocked in wait().
       void notifyFinish();
 
     public:
@@ -871,11 +879,16 @@ namespace qi {
     };
 
 
-    //common state shared between a Promise and multiple Futures
+    /** Common state shared between a Promise and multiple Futures.
+     *
+     * Setting the result, connecting a callback and checking the state do not
+     * lock: the result is reserved by an atomic flag, and callbacks are pushed
+     * on an atomic list which the setter closes once the result is published.
+     */
     template <typename T>
     class FutureBaseTyped : public FutureBase {
     public:
-      using CancelCallback = boost::function<void(Promise<T>&)>;
+      using CancelCallback = SmallFunction<void(Promise<T>&)>;
       using ValueType = typename FutureType<T>::type;
       FutureBaseTyped();
       ~FutureBaseTyped();
@@ -896,33 +909,38 @@ namespace qi {
       void setOnCancel(qi::Promise<T>& promise, CancelCallback onCancel);
       void setOnDestroyed(boost::function<void (ValueType)> f);
 
-      void connect(qi::Future<T> future,
-          const boost::function<void (qi::Future<T>)> &s,
-          FutureCallbackType type);
+      template <typename F>
+      void connect(qi::Future<T> future, F&& s, FutureCallbackType type);
 
       const ValueType& value(int msecs) const;
 
     private:
       friend class Promise<T>;
-      using CallbackType = boost::function<void(qi::Future<T>)>;
+      using CallbackType = SmallFunction<void(qi::Future<T>)>;
       struct Callback
       {
         CallbackType callback;
         FutureCallbackType callType;
-
-        Callback(CallbackType callback, FutureCallbackType callType)
-          : callback(callback)
-          , callType(callType)
-        {}
+        Callback* next;
       };
-      using Callbacks = std::vector<Callback>;
-      Callbacks                _onResult;
+      // Last connected callback, or closed() once the callbacks were called
+      qi::Atomic<Callback*>    _onResult;
+      // Most futures have a single callback: the first one is stored in place
+      Callback                 _firstCallback;
+      qi::Atomic<int>          _firstCallbackUsed;
       ValueType                _value;
       CancelCallback           _onCancel;
+      qi::Atomic<int>          _onCancelLock; // spin lock, only held to copy _onCancel
       boost::function<void (ValueType)> _onDestroyed;
       FutureCallbackType       _async;
       qi::Atomic<unsigned int> _promiseCount;
 
+      static Callback* closed() { return reinterpret_cast<Callback*>(1); }
+      void lockOnCancel();
+      void unlockOnCancel();
+      Callback* newCallback();
+      void deleteCallback(Callback* callback);
+      void callCallback(qi::Future<T>& future, Callback& callback);
       void clearCallbacks();
     };
   }
@@ -0,0 +1,213 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _QI_DETAIL_SMALLFUNCTION_HPP_
+#define _QI_DETAIL_SMALLFUNCTION_HPP_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <boost/function.hpp>
+
+namespace qi
+{
+namespace detail
+{
+
+template <typename Signature, std::size_t Size = 48>
+class SmallFunction;
+
+/** Copyable callable wrapper, like boost::function, which stores functors of
+ * up to Size bytes in place instead of allocating them.
+ *
+ * Used for the callbacks of futures, which are mostly a function and a
+ * promise bound together, and are too big or not trivial enough for the
+ * buffer of boost::function.
+ */
+template <typename R, typename... Args, std::size_t Size>
+class SmallFunction<R(Args...), Size>
+{
+  using Storage = typename std::aligned_storage<Size>::type;
+
+  struct Ops
+  {
+    R (*invoke)(const Storage& storage, Args&&... args);
+    void (*copy)(const Storage& from, Storage& to);
+    void (*move)(Storage& from, Storage& to);
+    void (*destroy)(Storage& storage);
+  };
+
+  template <typename F>
+  struct InPlace
+  {
+    static F& get(const Storage& storage)
+    {
+      return *reinterpret_cast<F*>(const_cast<Storage*>(&storage));
+    }
+    static R invoke(const Storage& storage, Args&&... args)
+    {
+      return get(storage)(std::forward<Args>(args)...);
+    }
+    static void copy(const Storage& from, Storage& to)
+    {
+      new (&to) F(get(from));
+    }
+    static void move(Storage& from, Storage& to)
+    {
+      new (&to) F(std::move(get(from)));
+      get(from).~F();
+    }
+    static void destroy(Storage& storage)
+    {
+      get(storage).~F();
+    }
+  };
+
+  template <typename F>
+  struct OnHeap
+  {
+    static F*& get(const Storage& storage)
+    {
+      return *reinterpret_cast<F**>(const_cast<Storage*>(&storage));
+    }
+    static R invoke(const Storage& storage, Args&&... args)
+    {
+      return (*get(storage))(std::forward<Args>(args)...);
+    }
+    static void copy(const Storage& from, Storage& to)
+    {
+      get(to) = new F(*get(from));
+    }
+    static void move(Storage& from, Storage& to)
+    {
+      get(to) = get(from);
+    }
+    static void destroy(Storage& storage)
+    {
+      delete get(storage);
+    }
+  };
+
+  template <typename F>
+  struct Fits
+    : std::integral_constant<bool, sizeof(F) <= sizeof(Storage)
+                                   && std::alignment_of<F>::value <= std::alignment_of<Storage>::value>
+  {};
+
+  template <typename Impl>
+  static const Ops* ops()
+  {
+    static const Ops o = { &Impl::invoke, &Impl::copy, &Impl::move, &Impl::destroy };
+    return &o;
+  }
+
+  template <typename F>
+  void assign(F&& f, std::true_type /* fits */)
+  {
+    using Functor = typename std::decay<F>::type;
+    new (&_storage) Functor(std::forward<F>(f));
+    _ops = ops<InPlace<Functor> >();
+  }
+
+  template <typename F>
+  void assign(F&& f, std::false_type /* fits */)
+  {
+    using Functor = typename std::decay<F>::type;
+    OnHeap<Functor>::get(_storage) = new Functor(std::forward<F>(f));
+    _ops = ops<OnHeap<Functor> >();
+  }
+
+  template <typename F>
+  static bool isEmpty(const F&) { return false; }
+  template <typename S>
+  static bool isEmpty(const boost::function<S>& f) { return f.empty(); }
+  template <typename S>
+  static bool isEmpty(S* f) { return !f; }
+
+public:
+  using result_type = R;
+
+  SmallFunction()
+    : _ops(nullptr)
+  {}
+
+  template <typename F,
+            typename = typename std::enable_if<
+              !std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+  SmallFunction(F&& f)
+    : _ops(nullptr)
+  {
+    if (!isEmpty(f))
+      assign(std::forward<F>(f), Fits<typename std::decay<F>::type>());
+  }
+
+  SmallFunction(const SmallFunction& other)
+    : _ops(other._ops)
+  {
+    if (_ops)
+      _ops->copy(other._storage, _storage);
+  }
+
+  SmallFunction(SmallFunction&& other)
+    : _ops(other._ops)
+  {
+    if (_ops)
+      _ops->move(other._storage, _storage);
+    other._ops = nullptr;
+  }
+
+  ~SmallFunction()
+  {
+    clear();
+  }
+
+  SmallFunction& operator=(SmallFunction other)
+  {
+    swap(other);
+    return *this;
+  }
+
+  void swap(SmallFunction& other)
+  {
+    SmallFunction tmp(std::move(other));
+    other.clear();
+    if (_ops)
+      _ops->move(_storage, other._storage);
+    other._ops = _ops;
+    _ops = nullptr;
+    if (tmp._ops)
+      tmp._ops->move(tmp._storage, _storage);
+    _ops = tmp._ops;
+    tmp._ops = nullptr;
+  }
+
+  void clear()
+  {
+    if (_ops)
+      _ops->destroy(_storage);
+    _ops = nullptr;
+  }
+
+  bool empty() const { return !_ops; }
+  explicit operator bool() const { return _ops != nullptr; }
+
+  R operator()(Args... args) const
+  {
+    if (!_ops)
+      throw boost::bad_function_call();
+    return _ops->invoke(_storage, std::forward<Args>(args)...);
+  }
+
+private:
+  Storage _storage;
+  const Ops* _ops;
+};
+
+}
+}
+
+#endif  // _QI_DETAIL_SMALLFUNCTION_HPP_
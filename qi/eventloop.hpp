@@ -42,6 +42,38 @@ namespace qi
   class QI_API EventLoop : public ExecutionContext
   {
   public:
+    /// \brief How tasks are dispatched to the threads of the event loop.
+    enum class Backend
+    {
+      /// Asio, or the value of QI_EVENTLOOP_BACKEND ("asio" or "workstealing").
+      Default,
+      /// All threads run a single boost::asio::io_service.
+      Asio,
+      /// Each thread has its own task queue, and steals from the others when it is empty.
+      WorkStealing,
+    };
+
+    /// \brief State of the thread pool of an event loop, see poolStatus().
+    struct PoolStatus
+    {
+      /// Threads running the tasks.
+      unsigned int threads;
+      /// The pool does not shrink below this number of threads.
+      unsigned int minThreads;
+      /// The pool does not grow above this number of threads, 0 if unlimited.
+      unsigned int maxThreads;
+      /// Tasks being run.
+      unsigned int activeTasks;
+      /// Tasks waiting for a thread or for their deadline.
+      unsigned int pendingTasks;
+      /// Last measured delay between the post of a task and its execution.
+      qi::Duration queueDelay;
+      /// Threads added because tasks were waiting too long.
+      unsigned int threadsAdded;
+      /// Threads removed because they were idle.
+      unsigned int threadsRemoved;
+    };
+
     /**
      * \brief Create a new eventLoop.
      * \param name Name of the event loop created.
@@ -49,6 +81,12 @@ namespace qi
      * You must then call either start(), run() or startThreadPool() to start event processing.
      */
     EventLoop(const std::string& name = "eventloop");
+    /**
+     * \brief Create a new eventLoop using the given backend.
+     * \param name Name of the event loop created.
+     * \param backend Dispatching strategy of the event loop.
+     */
+    EventLoop(const std::string& name, Backend backend);
 
     /// \brief Default destructor.
     ~EventLoop();
@@ -79,9 +117,45 @@ namespace qi
      */
     void setMaxThreads(unsigned int max);
 
+    /**
+     * \brief Set the minimum number of threads in the pool.
+     *
+     * Idle threads are removed until this number is reached. It defaults to
+     * the number of threads given to start().
+     * \param min Minimum number of threads.
+     */
+    void setMinThreads(unsigned int min);
+
+    /**
+     * \brief Get the current size and load of the thread pool.
+     *
+     * The pool grows when tasks wait longer than QI_EVENTLOOP_MAX_QUEUE_DELAY
+     * milliseconds while all threads are busy, and shrinks when threads stay
+     * idle for QI_EVENTLOOP_SHRINK_DELAY milliseconds. Its decisions are logged
+     * in the "qi.eventloop.pool" category.
+     */
+    PoolStatus poolStatus();
+
     /// \brief Internal function.
     void *nativeHandle();
 
+    /**
+     * \brief Internal function: index of the thread of this event loop running
+     * the caller, or -1 if it is not known.
+     *
+     * Only the WorkStealing backend knows it.
+     */
+    int currentThreadIndex();
+
+    /**
+     * \brief Internal function: post a callback, preferably to the thread of
+     * the given index, as returned by currentThreadIndex().
+     *
+     * Only the WorkStealing backend honors the preference. The callback runs on
+     * another thread if that one left the pool or lags behind the others.
+     */
+    void postOnThread(int index, boost::function<void()> callback);
+
     // DEPRECATED
     /// @{
     /**
@@ -25,6 +25,15 @@ using ClientAuthenticatorFactoryPtr = boost::shared_ptr<ClientAuthenticatorFacto
 class GatewayPrivate;
 using GatewayPrivatePtr = boost::shared_ptr<GatewayPrivate>;
 
+/**
+ * Forwards the calls and events of the services registered on a service
+ * directory to the clients connected to the gateway.
+ *
+ * By default the events are queued for every subscriber however slow it is.
+ * Setting the environment variable QI_GATEWAY_EVENT_BACKLOG_MAX to N makes
+ * the gateway drop the events of subscribers which already have N messages
+ * waiting to be sent; the drops are logged as warnings.
+ */
 class QI_API Gateway
 {
   GatewayPrivatePtr _p;
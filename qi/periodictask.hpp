@@ -29,8 +29,19 @@ namespace qi
   public:
     /// \brief Callback is a boost::function.
     using Callback = boost::function<void()>;
-    // internal
-    using ScheduleCallback = boost::function<qi::Future<void>(const Callback&, qi::Duration delay)>;
+
+    /// \brief Timing statistics of the calls of a periodic task, see statistics().
+    struct Statistics
+    {
+      /// Number of calls since the task was started.
+      unsigned int calls;
+      /// Number of calls which ended more than a period after their deadline.
+      unsigned int overruns;
+      /// Mean delay between the deadline of a call and its start.
+      qi::Duration meanJitter;
+      /// Maximum delay between the deadline of a call and its start.
+      qi::Duration maxJitter;
+    };
 
     /// \brief Default constructor.
     PeriodicTask();
@@ -121,6 +132,14 @@ namespace qi
     /**
      * If argument is true, call interval will take into account call duration
      * to maintain the period.
+     *
+     * The calls are then aligned on a grid of the period shared by all the
+     * periodic tasks, so that they do not drift and so that tasks with equal or
+     * harmonic periods run on the same ticks. A call ending after the deadline
+     * of the next one makes the task skip to the next point of the grid.
+     * Unless start() is asked for an immediate call, the first call is made on
+     * the first point of the grid at least one period after start(), so up to
+     * two periods after it.
      */
     void compensateCallbackTime(bool compensate);
 
@@ -139,6 +158,11 @@ namespace qi
      */
     bool isStopping() const;
 
+    /**
+     * \return the timing statistics of the calls since the last start()
+     */
+    Statistics statistics() const;
+
   private:
     boost::shared_ptr<PeriodicTaskPrivate> _p;
 
@@ -8,6 +8,7 @@
 #define _QI_SIGNAL_HPP_
 
 #include <qi/atomic.hpp>
+#include <qi/clock.hpp>
 
 #include <qi/anyfunction.hpp>
 #include <qi/type/typeobject.hpp>
@@ -31,9 +32,53 @@ namespace qi {
   class SignalSubscriber;
 
   class SignalBasePrivate;
+  struct SignalQueuedArguments;
+  struct SignalCoalescedCalls;
 
   using SignalLink = qi::uint64_t;
 
+  /** Coalescing of the triggers of a signal delivered to a subscriber.
+   *
+   * A coalesced subscriber is called asynchronously, at most once per period,
+   * even if its call type is MetaCallType_Direct:
+   * - Mode_Latest: with the arguments of the last trigger only, intermediate
+   *   values are dropped.
+   * - Mode_Batch: with a single argument, a std::vector<AnyValue> holding the
+   *   tuple of arguments of each trigger since the previous call.
+   */
+  struct SignalCoalescing
+  {
+    enum Mode
+    {
+      Mode_None,
+      Mode_Latest,
+      Mode_Batch,
+    };
+
+    SignalCoalescing()
+      : mode(Mode_None)
+      , period(0)
+    {}
+
+    SignalCoalescing(Mode mode, qi::Duration period)
+      : mode(mode)
+      , period(period)
+    {}
+
+    static SignalCoalescing latest(qi::Duration period)
+    {
+      return SignalCoalescing(Mode_Latest, period);
+    }
+
+    static SignalCoalescing batch(qi::Duration period)
+    {
+      return SignalCoalescing(Mode_Batch, period);
+    }
+
+    Mode         mode;
+    qi::Duration period;
+  };
+
   //Signal are not copyable, they belong to a class.
   class QI_API SignalBase : boost::noncopyable
   {
@@ -87,6 +132,14 @@ namespace qi {
     virtual void trigger(const GenericFunctionParameters& params, MetaCallType callType = MetaCallType_Auto);
     /// Set the MetaCallType used by operator()().
     void setCallType(MetaCallType callType);
+    /** Set the coalescing of the subscribers connected afterwards which do
+     * not set their own, including the ones forwarding the signal to remote
+     * clients, so that dropped values are not sent.
+     *
+     * Batches change the arguments of the calls, so only subscribers can
+     * ask for them: \p policy cannot be Mode_Batch.
+     */
+    void setCoalescing(const SignalCoalescing& policy);
     /// Trigger the signal with given arguments, and call type set by setCallType()
     void operator()(
       qi::AutoAnyReference p1 = qi::AutoAnyReference(),
@@ -223,6 +276,19 @@ namespace qi {
 
     SignalSubscriber& setCallType(MetaCallType ct);
 
+    /** Coalesce the calls of this subscriber, see SignalCoalescing.
+     *
+     * Only applies to function subscribers. A subscriber in Mode_Batch must
+     * be given to connect() with its policy already set, since it does not
+     * take the arguments of the signal: switching a connected subscriber to
+     * or from Mode_Batch throws.
+     *
+     * Coalesced calls are always asynchronous, whatever the call type of the
+     * subscriber: they are made from its execution context if it has one, or
+     * from the event loop.
+     */
+    SignalSubscriber& setCoalescing(const SignalCoalescing& policy);
+
     /// Wait until all threads are inactive except the current thread.
     void waitForInactive();
 
@@ -236,6 +302,14 @@ namespace qi {
     * @return the signature, or an invalid signature if extraction is impossible
     */
     Signature signature() const;
+  private:
+    // Share the arguments copied for the queued calls of one trigger
+    void call(const GenericFunctionParameters& args, MetaCallType callType,
+              SignalQueuedArguments& queued);
+    // Queue the call if this subscriber is coalesced, return false otherwise
+    bool coalesce(const GenericFunctionParameters& args);
+    void flushCoalesced();
+    friend class SignalBase;
   public:
     // Source information
     SignalBase* source;
@@ -265,6 +339,13 @@ namespace qi {
 
     // ExecutionContext on which to schedule the call
     ExecutionContext* executionContext;
+
+    // Protected by lock, except its mode read through coalescingMode
+    SignalCoalescing                        coalescing;
+    // Copy of coalescing.mode, read without the lock on each call
+    qi::Atomic<int>                         coalescingMode;
+    // Calls waiting for the next flush, protected by lock
+    boost::shared_ptr<SignalCoalescedCalls> coalesced;
   };
   using SignalSubscriberPtr = boost::shared_ptr<SignalSubscriber>;
 }
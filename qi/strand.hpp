@@ -7,7 +7,7 @@
 #ifndef _QI_STRAND_HPP_
 #define _QI_STRAND_HPP_
 
-#include <deque>
+#include <memory>
 #include <qi/detail/executioncontext.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/shared_ptr.hpp>
@@ -23,6 +23,8 @@
 namespace qi
 {
 
+class EventLoop;
+
 namespace detail
 {
 
@@ -39,28 +41,40 @@ public:
   enum class State;
 
   struct Callback;
-
-  using Queue = std::deque<boost::shared_ptr<Callback>>;
+  struct Job;
+  class JobQueue;
 
   qi::ExecutionContext& _eventLoop;
   boost::atomic<unsigned int> _curId;
   boost::atomic<unsigned int> _aliveCount;
-  bool _processing; // protected by mutex, no need for atomic
+  // jobs pushed and not done yet, the one who brings it from 0 schedules process()
+  boost::atomic<unsigned int> _pending;
+  // postJob() calls in progress, which push without the lock
+  boost::atomic<unsigned int> _posting;
   boost::atomic<int> _processingThread;
   boost::mutex _mutex;
   boost::condition_variable _processFinished;
-  bool _dying;
-  Queue _queue;
+  boost::atomic<bool> _dying;
+  std::unique_ptr<JobQueue> _queue;
+  // set when process() prefers the thread of this event loop which ran it last
+  EventLoop* _affinityEventLoop;
+  boost::atomic<int> _lastThread;
 
   StrandPrivate(qi::ExecutionContext& eventLoop);
+  ~StrandPrivate();
 
   Future<void> asyncAtImpl(boost::function<void()> cb, qi::SteadyClockTimePoint tp) override;
   Future<void> asyncDelayImpl(boost::function<void()> cb, qi::Duration delay) override;
 
   boost::shared_ptr<Callback> createCallback(boost::function<void()> cb);
   void enqueue(boost::shared_ptr<Callback> cbStruct);
+  // fire-and-forget job, with no future
+  void postJob(boost::function<void()> cb);
+  void push(Job* job);
+  void scheduleProcess();
 
   void process();
+  void drop(Job* job);
   void cancel(boost::shared_ptr<Callback> cbStruct);
 
   // don't care
@@ -73,16 +87,6 @@ public:
   using ExecutionContext::async;
 };
 
-inline StrandPrivate::StrandPrivate(qi::ExecutionContext& eventLoop)
-  : _eventLoop(eventLoop)
-  , _curId(0)
-  , _aliveCount(0)
-  , _processing(false)
-  , _processingThread(0)
-  , _dying(false)
-{
-}
-
 /** Class that schedules tasks sequentially
  *
  * A strand allows one to schedule work on an eventloop with the guaranty
@@ -96,10 +100,24 @@ inline StrandPrivate::StrandPrivate(qi::ExecutionContext& eventLoop)
 class QI_API Strand : public ExecutionContext, private boost::noncopyable
 {
 public:
+  /// Threads on which the jobs of a strand run
+  enum class Affinity
+  {
+    /// Any thread of the execution context
+    None,
+    /** Preferably the thread which ran the previous jobs, as long as it does
+     * not lag behind the others, to keep the state used by the jobs in its
+     * caches. Only event loops with the WorkStealing backend honor it.
+     */
+    Thread,
+  };
+
   /// Construct a strand that will schedule work on the default event loop
   Strand();
   /// Construct a strand that will schedule work on executionContext
   Strand(qi::ExecutionContext& executionContext);
+  /// Construct a strand that will schedule work on executionContext with the given affinity
+  Strand(qi::ExecutionContext& executionContext, Affinity affinity);
   /// Call detroy()
   ~Strand();
 
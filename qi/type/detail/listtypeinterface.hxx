@@ -7,6 +7,8 @@
 #ifndef _QITYPE_DETAIL_TYPELIST_HXX_
 #define _QITYPE_DETAIL_TYPELIST_HXX_
 
+#include <type_traits>
+
 #include <qi/atomic.hpp>
 
 #include <qi/type/detail/anyreference.hpp>
@@ -17,7 +19,7 @@ namespace qi
 {
   // List container
 template<typename T, typename H = ListTypeInterface>
-class ListTypeInterfaceImpl: public H
+class ListTypeInterfaceImpl: public H, public ContiguousListTypeInterface
 {
 public:
   using MethodsImpl = DefaultTypeImplMethods<T, TypeByPointerPOD<T>>;
@@ -27,6 +29,8 @@ public:
   AnyIterator begin(void* storage) override;
   AnyIterator end(void* storage) override;
   void pushBack(void** storage, void* valueStorage) override;
+  void* data(void* storage, size_t* stride) override;
+  void* extend(void** storage, size_t count, size_t* stride) override;
   _QI_BOUNCE_TYPE_METHODS(MethodsImpl);
   TypeInterface* _elementType;
 };
@@ -101,6 +105,46 @@ namespace detail
   {
     container.insert(*element);
   }
+
+  // Only std::vector stores its elements contiguously
+  template<typename T>
+  void* listData(T& container, size_t* stride)
+  {
+    return 0;
+  }
+  template<typename E>
+  void* listData(std::vector<E>& container, size_t* stride)
+  {
+    if (container.empty())
+      return 0;
+    *stride = sizeof(E);
+    return &container[0];
+  }
+  template<typename T>
+  void* listExtend(T& container, size_t count, size_t* stride)
+  {
+    return 0;
+  }
+  template<typename E>
+  void* listExtend(std::vector<E>& container, size_t count, size_t* stride, std::true_type)
+  {
+    if (!count)
+      return 0;
+    size_t size = container.size();
+    container.resize(size + count);
+    *stride = sizeof(E);
+    return &container[size];
+  }
+  template<typename E>
+  void* listExtend(std::vector<E>& container, size_t count, size_t* stride, std::false_type)
+  {
+    return 0;
+  }
+  template<typename E>
+  void* listExtend(std::vector<E>& container, size_t count, size_t* stride)
+  {
+    return listExtend(container, count, stride, std::is_default_constructible<E>());
+  }
 }
 template<typename T, typename H>
 void ListTypeInterfaceImpl<T, H>::pushBack(void **storage, void* valueStorage)
@@ -116,6 +160,20 @@ size_t ListTypeInterfaceImpl<T, H>::size(void* storage)
   return ptr->size();
 }
 
+template<typename T, typename H>
+void* ListTypeInterfaceImpl<T, H>::data(void* storage, size_t* stride)
+{
+  T* ptr = (T*) ptrFromStorage(&storage);
+  return detail::listData(*ptr, stride);
+}
+
+template<typename T, typename H>
+void* ListTypeInterfaceImpl<T, H>::extend(void** storage, size_t count, size_t* stride)
+{
+  T* ptr = (T*) ptrFromStorage(storage);
+  return detail::listExtend(*ptr, count, stride);
+}
+
 // There is no way to register a template container type :(
 template<typename T> struct TypeImpl<std::vector<T> >: public ListTypeInterfaceImpl<std::vector<T> >
 {
@@ -157,6 +215,13 @@ public:
     void* vstor = adaptStorage(storage);
     BaseClass::pushBack(&vstor, valueStorage);
   }
+  void* data(void* storage, size_t* stride) override {
+    return BaseClass::data(adaptStorage(&storage), stride);
+  }
+  void* extend(void** storage, size_t count, size_t* stride) override {
+    void* vstor = adaptStorage(storage);
+    return BaseClass::extend(&vstor, count, stride);
+  }
 
   //ListTypeInterface* _list;
 };
@@ -150,5 +150,19 @@ namespace qi
     threadingModel = ct;
     return *this;
   }
+
+  inline
+  SignalSubscriber& SignalSubscriber::setCoalescing(const SignalCoalescing& policy)
+  {
+    boost::mutex::scoped_lock sl(mutex);
+    // the arity of a batched subscriber is only checked at connection
+    if (linkId != SignalBase::invalidSignalLink && policy.mode != coalescing.mode
+        && (policy.mode == SignalCoalescing::Mode_Batch
+            || coalescing.mode == SignalCoalescing::Mode_Batch))
+      throw std::runtime_error("Batched coalescing can only be set before connecting");
+    coalescing = policy;
+    coalescingMode = policy.mode;
+    return *this;
+  }
 } // qi
 #endif  // _QITYPE_DETAIL_SIGNAL_HXX_
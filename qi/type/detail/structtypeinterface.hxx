@@ -237,12 +237,13 @@ namespace qi
 #define __QI_TUPLE_GET(_, what, field) if (i == index) return ::qi::typeOf(ptr->field)->initializeStorage(&ptr->field); i++;
 #define __QI_TUPLE_SET(_, what, field) if (i == index) ::qi::detail::setFromStorage(ptr->field, valueStorage); i++;
 #define __QI_TUPLE_FIELD_NAME(_, what, field) res.push_back(BOOST_PP_STRINGIZE(QI_DELAY(field)));
-#define __QI_TYPE_STRUCT_IMPLEMENT(name, inl, onSet, ...)                                                     \
+#define __QI_TYPE_STRUCT_IMPLEMENT(name, inl, onRegister, onSet, ...)                                         \
   namespace qi                                                                                                \
   {                                                                                                           \
     inl TypeImpl<name>::TypeImpl()                                                                            \
     {                                                                                                         \
       ::qi::registerStruct(this);                                                                             \
+      onRegister                                                                                              \
     }                                                                                                         \
     inl std::vector<::qi::TypeInterface*> TypeImpl<name>::memberTypes()                                       \
     {                                                                                                         \
@@ -289,6 +290,9 @@ namespace qi
     }                                                                                                         \
   }
 
+// set() of the struct only assigns its fields
+#define __QI_TYPE_STRUCT_PLAIN ::qi::registerPlainStruct(this);
+
 /// Declare a struct field using an helper function
 #define QI_STRUCT_HELPER(name, func) (name, func, FUNC)
 /// Declare a struct feld that is a member (member value or member accessor function)
@@ -392,17 +396,17 @@ friend class qi::TypeImpl<name>;
  */
 #define QI_TYPE_STRUCT(name, ...) \
   QI_TYPE_STRUCT_DECLARE(name) \
-  __QI_TYPE_STRUCT_IMPLEMENT(name, inline, /**/, __VA_ARGS__)
+  __QI_TYPE_STRUCT_IMPLEMENT(name, inline, __QI_TYPE_STRUCT_PLAIN, /**/, __VA_ARGS__)
 
 /** Similar to QI_TYPE_STRUCT, but evaluates 'onSet' after writting to an instance.
  * The instance is accessible through the variable 'ptr'.
  */
 #define QI_TYPE_STRUCT_EX(name, onSet, ...) \
   QI_TYPE_STRUCT_DECLARE(name) \
-  __QI_TYPE_STRUCT_IMPLEMENT(name, inline, onSet, __VA_ARGS__)
+  __QI_TYPE_STRUCT_IMPLEMENT(name, inline, /**/, onSet, __VA_ARGS__)
 
 #define QI_TYPE_STRUCT_IMPLEMENT(name, ...) \
-  __QI_TYPE_STRUCT_IMPLEMENT(name, /**/, /**/, __VA_ARGS__)
+  __QI_TYPE_STRUCT_IMPLEMENT(name, /**/, __QI_TYPE_STRUCT_PLAIN, /**/, __VA_ARGS__)
 
 /** Register a struct with member field/function getters, and constructor setter
  *
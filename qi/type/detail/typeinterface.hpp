@@ -198,6 +198,11 @@ namespace qi {
   QI_API void registerStruct(TypeInterface* type);
   /// @return matching TypeInterface registered by registerStruct() or 0.
   QI_API TypeInterface* getRegisteredStruct(const qi::Signature& s);
+  /** Declare that StructTypeInterface::set() of \p type only assigns its
+   * fields, so that decoders may write the fields in place instead.
+   * Called by QI_TYPE_STRUCT, not by the variants with a hook or a constructor.
+   */
+  QI_API void registerPlainStruct(TypeInterface* type);
 }
 
 
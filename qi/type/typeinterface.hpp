@@ -203,6 +203,24 @@ namespace qi{
     TypeKind kind() override { return TypeKind_List;}
   };
 
+  /**
+   * Access to the storage of a list, for the list types which also implement
+   * it: get it with dynamic_cast from a ListTypeInterface.
+   */
+  class QI_API ContiguousListTypeInterface
+  {
+  public:
+    virtual ~ContiguousListTypeInterface() {}
+    /// If the elements are stored contiguously, return the address of the
+    /// first one and set \p stride to the distance in bytes between two
+    /// elements. Return 0 otherwise.
+    virtual void* data(void* storage, size_t* stride) = 0;
+    /// Append \p count default-constructed elements stored contiguously, and
+    /// return the address of the first one as data() does. Return 0, leaving
+    /// the list untouched, if this is not supported.
+    virtual void* extend(void** storage, size_t count, size_t* stride) = 0;
+  };
+
   /**
    * Interface for a map of elements (like std::map)
    *
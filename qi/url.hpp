@@ -47,7 +47,7 @@ namespace qi {
      *  @param url The url string, the port and the protocol will be extracted
      *  if they're present.
      *  @param defaultPort The port that will be used if no port had been found
-     *  in the url string.
+     *  in the url string, unless it is a unix:// local socket url.
      */
     Url(const std::string &url, unsigned short defaultPort);
 
@@ -65,7 +65,7 @@ namespace qi {
      *  @param defaultProtocol The protocol that will be used if no protocol had
      *  been found in the url string.
      *  @param defaultPort The port that will be used if no port had been found
-     *  in the url string.
+     *  in the url string, unless it is a unix:// local socket url.
      */
     Url(const std::string &url, const std::string &defaultProtocol, unsigned short defaultPort);
 
@@ -90,7 +90,8 @@ namespace qi {
      */
 
     /**
-     *  @return True if the port and the protocol had been set.
+     *  @return True if the port and the protocol had been set, or for a
+     *  unix:// local socket url, the protocol and the path.
      */
     bool isValid() const;
 
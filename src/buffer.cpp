@@ -24,21 +24,83 @@ namespace qi
 {
   BufferPrivate::BufferPrivate() // cppcheck-suppress uninitMemberVar
     : _bigdata(0)
+    , _releaseBigdata(0)
     , _cachedSubBufferTotalSize(0)
     , used(0)
     , available(sizeof(_data))
   {
   }
 
+  namespace
+  {
+    void freeStorage(unsigned char* data, size_t size,
+                     void (*release)(unsigned char* data, size_t size))
+    {
+      if (release)
+        release(data, size);
+      else
+        free(data);
+    }
+
+    // Slices do not own the storage they point into
+    void releaseSlice(unsigned char*, size_t)
+    {
+    }
+  }
+
+  BufferPrivate::Block::~Block()
+  {
+    if (data)
+      freeStorage(data, size, release);
+  }
+
   BufferPrivate::~BufferPrivate()
   {
-    if (_bigdata)
+    // shared storage is freed with the block
+    if (_bigdata && !_shared)
     {
-      free(_bigdata);
+      freeStorage(_bigdata, available, _releaseBigdata);
       _bigdata = NULL;
     }
   }
 
+  BufferPrivate::BlockPtr BufferPrivate::share()
+  {
+    // Buffer::slice() is const, it may be called from several threads at once
+    BlockPtr block = boost::atomic_load(&_shared);
+    if (block)
+      return block;
+    BlockPtr created = boost::make_shared<Block>(_bigdata, available, _releaseBigdata);
+    if (boost::atomic_compare_exchange(&_shared, &block, created))
+      return created;
+    // another thread shared it first
+    created->data = NULL;
+    return block;
+  }
+
+  bool BufferPrivate::reclaim()
+  {
+    if (_sliceOf)
+      return false;
+    if (!_shared)
+      return true;
+    // slices only copy _sliceOf, so nobody can share the block again meanwhile
+    if (!_shared.unique())
+      return false;
+    _shared->data = NULL;
+    _shared.reset();
+    return true;
+  }
+
+  void BufferPrivate::detach()
+  {
+    _shared.reset();
+    _sliceOf.reset();
+    _bigdata = NULL;
+    _releaseBigdata = 0;
+    available = sizeof(_data);
+  }
+
   struct MyPoolTag { };
   using buffer_pool = boost::singleton_pool<MyPoolTag, sizeof(BufferPrivate)>;
 
@@ -109,6 +171,23 @@ namespace qi
     qiLogDebug() << "Resizing buffer from " << available << " to " << neededSize;
     unsigned char *newBigdata;
 
+    const bool sliced = !reclaim();
+    if (_releaseBigdata || sliced)
+    {
+      // Adopted or sliced storage can not be reallocated, move the data to the heap
+      newBigdata = static_cast<unsigned char *>(malloc(neededSize));
+      if (newBigdata == NULL)
+        return false;
+      ::memcpy(newBigdata, _bigdata, used);
+      if (sliced)
+        detach();
+      else
+        _releaseBigdata(_bigdata, available);
+      _releaseBigdata = 0;
+      available = neededSize;
+      _bigdata = newBigdata;
+      return true;
+    }
     newBigdata = static_cast<unsigned char *>(realloc(_bigdata, neededSize));
     if (newBigdata == NULL)
       return false;
@@ -196,6 +275,9 @@ namespace qi
 
   void Buffer::clear()
   {
+    // do not overwrite what slices see
+    if (!_p->reclaim())
+      _p->detach();
     _p->used = 0;
     _p->_subBuffers.clear();
     _p->_cachedSubBufferTotalSize = 0;
@@ -211,6 +293,27 @@ namespace qi
     return _p ? _p->data() : 0;
   }
 
+  Buffer Buffer::slice(size_t offset, size_t size) const
+  {
+    Buffer result;
+    if (offset + size > _p->used)
+    {
+      qiLogDebug() << "Attempt to slice " << offset + size
+                   << " on buffer of size " << _p->used;
+      return result;
+    }
+    // Inline storage is reused once the buffer is cleared, and small enough to copy
+    if (!_p->_bigdata)
+    {
+      result.write(_p->_data + offset, size);
+      return result;
+    }
+    result._p->adopt(_p->_bigdata + offset, size, &releaseSlice);
+    // a slice of a slice keeps the original block alive
+    result._p->_sliceOf = _p->_sliceOf ? _p->_sliceOf : _p->share();
+    return result;
+  }
+
   const void *Buffer::read(size_t offset, size_t length) const
   {
     if (offset + length > _p->used)
@@ -10,7 +10,9 @@
 #define STATIC_BLOCK 768
 #define BLOCK   4096
 
+#include <cassert>
 #include <vector>
+#include <boost/shared_ptr.hpp>
 #include <qi/atomic.hpp>
 #include <qi/types.hpp>
 
@@ -26,11 +28,48 @@ namespace qi
     unsigned char * data();
     bool            resize(size_t size = 0x100000);
     int             indexOfSubBuffer(size_t offset) const;
+    /// Use size bytes of external storage, freed with release instead of free().
+    void            adopt(unsigned char* data, size_t size,
+                          void (*release)(unsigned char* data, size_t size))
+    {
+      assert(!_bigdata && !used);
+      _bigdata = data;
+      _releaseBigdata = release;
+      used = size;
+      available = size;
+    }
+
+    /// Heap storage shared with slices, freed by the last of its owners.
+    struct Block
+    {
+      Block(unsigned char* data, size_t size, void (*release)(unsigned char* data, size_t size))
+        : data(data), size(size), release(release)
+      {
+      }
+      ~Block();
+
+      unsigned char* data; // NULL once taken back by its buffer
+      size_t         size;
+      void         (*release)(unsigned char* data, size_t size);
+    };
+    typedef boost::shared_ptr<Block> BlockPtr;
+
+    /// Share the heap storage with slices, may be called concurrently.
+    BlockPtr        share();
+    /// Own the heap storage again if no slice uses it, return false otherwise.
+    bool            reclaim();
+    /// Leave the heap storage to the slices and go back to the static storage.
+    void            detach();
 
   public:
     unsigned char*  _bigdata;
+    void          (*_releaseBigdata)(unsigned char*, size_t); // set by adopt()
     unsigned char   _data[STATIC_BLOCK] = {};
     size_t          _cachedSubBufferTotalSize;
+    // set once _bigdata is shared with slices, which then own it together
+    BlockPtr        _shared;
+    // for a slice, the block _bigdata points into
+    BlockPtr        _sliceOf;
 
   public:
     size_t          used; // size used
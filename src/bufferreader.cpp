@@ -64,6 +64,15 @@ namespace qi {
     return size;
   }
 
+  Buffer BufferReader::readSlice(size_t size)
+  {
+    if (!peek(size))
+      return Buffer();
+    Buffer result = _buffer.slice(_cursor, size);
+    _cursor += size;
+    return result;
+  }
+
   bool BufferReader::hasSubBuffer() const
   {
     if (_buffer.subBuffers().size() <= _subCursor)
@@ -6,7 +6,6 @@
 
 #include <boost/program_options.hpp>
 #include <boost/make_shared.hpp>
-#include <boost/asio/steady_timer.hpp>
 
 #include <qi/preproc.hpp>
 #include <qi/log.hpp>
@@ -27,61 +26,92 @@
 qiLogCategory("qi.eventloop");
 
 namespace qi {
-  class EventLoopAsio::WorkerThreadPool
+  static qi::Atomic<uint32_t> gTaskId = 0;
+
+  EventLoopPoolController::EventLoopPoolController()
+  : _minThreads(0)
+  , _targetDelay(qi::MilliSeconds(qi::os::getEnvDefault("QI_EVENTLOOP_MAX_QUEUE_DELAY", 100u)))
+  , _shrinkDelay(qi::MilliSeconds(qi::os::getEnvDefault("QI_EVENTLOOP_SHRINK_DELAY", 10000u)))
+  , _idleTime(0)
+  , _queueDelay(0)
+  , _threadsAdded(0)
+  , _threadsRemoved(0)
   {
-  public:
-    ~WorkerThreadPool() { joinAll(); }
+  }
 
-    template<class Func>
-    void launch(Func func)
-    {
-      boost::mutex::scoped_lock locked(_mutex);
-      _workers.emplace_back(std::move(func));
-    }
+  void EventLoopPoolController::start(const std::string& name, unsigned int threads)
+  {
+    _name = name;
+    _minThreads = qi::os::getEnvDefault("QI_EVENTLOOP_MIN_THREADS", threads);
+    _lastSample = qi::SteadyClock::now();
+  }
 
-    template<class Func, class OwnerType>
-    void launch(Func func, OwnerType* owner)
+  int EventLoopPoolController::decide(const Sample& sample)
+  {
+    const qi::SteadyClockTimePoint now = qi::SteadyClock::now();
+    const qi::Duration elapsed = now - _lastSample;
+    _lastSample = now;
+    _queueDelay = sample.queueDelay.count();
+
+    if (sample.timedOut
+        || (sample.queueDelay > _targetDelay && sample.activeTasks >= sample.threads))
     {
-      boost::mutex::scoped_lock locked(_mutex);
-      _workers.emplace_back(std::move(func), owner);
+      _idleTime = qi::Duration(0);
+      qiLogVerbose("qi.eventloop.pool") << _name << ": tasks wait for "
+        << boost::chrono::duration_cast<qi::MilliSeconds>(sample.queueDelay).count()
+        << "ms with " << sample.activeTasks << " active tasks on " << sample.threads
+        << " threads, adding a thread";
+      return 1;
     }
 
-    void joinAll()
+    const unsigned int keep = std::max(_minThreads.load(), sample.activeTasks + 1);
+    if (_shrinkDelay == qi::Duration(0)
+        || sample.threads <= keep
+        || sample.queueDelay * 2 > _targetDelay)
     {
-      std::thread workerThread;
-      while ((workerThread = pop()).joinable())
-      {
-        workerThread.join();
-      }
+      _idleTime = qi::Duration(0);
+      return 0;
     }
+    _idleTime += elapsed;
+    if (_idleTime < _shrinkDelay)
+      return 0;
+    _idleTime = qi::Duration(0);
+    const int remove = (sample.threads - keep + 1) / 2;
+    qiLogVerbose("qi.eventloop.pool") << _name << ": " << sample.threads - sample.activeTasks
+      << " threads idle for " << boost::chrono::duration_cast<qi::MilliSeconds>(_shrinkDelay).count()
+      << "ms, removing " << remove << " threads";
+    return -remove;
+  }
 
-  private:
-    std::vector<std::thread> _workers;
-    boost::mutex _mutex;
+  void EventLoopPoolController::threadsAdded(unsigned int count)
+  {
+    _threadsAdded += count;
+  }
 
-    std::thread pop()
-    {
-      boost::mutex::scoped_lock locked(_mutex);
-      if (_workers.empty())
-      {
-        return {};
-      }
-      else
-      {
-        std::thread workerThread = std::move(_workers.back());
-        _workers.pop_back();
-        return workerThread;
-      }
-    }
-  };
+  void EventLoopPoolController::threadsRemoved(unsigned int count)
+  {
+    _threadsRemoved += count;
+  }
 
-  using SteadyTimer = boost::asio::basic_waitable_timer<SteadyClock>;
+  void EventLoopPoolController::setMinThreads(unsigned int min)
+  {
+    _minThreads = min;
+  }
 
-  static qi::Atomic<uint32_t> gTaskId = 0;
+  void EventLoopPoolController::fillStatus(EventLoop::PoolStatus& status) const
+  {
+    status.minThreads = _minThreads.load();
+    status.queueDelay = qi::Duration(_queueDelay.load());
+    status.threadsAdded = _threadsAdded.load();
+    status.threadsRemoved = _threadsRemoved.load();
+  }
 
   EventLoopAsio::EventLoopAsio()
   : _mode(Mode::Unset)
   , _work(nullptr)
+  , _timers(_io,
+            boost::bind(&EventLoopAsio::onTimerExpired, this, _1),
+            boost::bind(&EventLoopAsio::onTimerCanceled, this, _1))
   , _maxThreads(0)
   , _workerThreads(new WorkerThreadPool())
   {
@@ -103,6 +133,7 @@ namespace qi {
         nthread = strtol(envNthread, 0, 0);
     }
     _maxThreads = qi::os::getEnvDefault("QI_EVENTLOOP_MAX_THREADS", 150);
+    _controller.start(_name, nthread);
     _mode = Mode::Pooled;
     _work = new boost::asio::io_service::work(_io);
     for (int i=0; i<nthread; ++i)
@@ -128,8 +159,10 @@ namespace qi {
       delete this;
   }
 
-  static void ping_me(bool & ping, boost::condition_variable& cond)
+  static void ping_me(bool & ping, boost::condition_variable& cond,
+                      qi::Atomic<uint32_t>& activeTask, unsigned int& othersActive)
   {
+    othersActive = *activeTask - 1; // not counting ourselves
     ping = true;
     cond.notify_all();
   }
@@ -139,6 +172,11 @@ namespace qi {
     return b;
   }
 
+  static void terminate_thread()
+  {
+    throw detail::TerminateThread();
+  }
+
   void EventLoopAsio::_pingThread()
   {
     qi::os::setCurrentThreadName("EvLoop.mon");
@@ -149,40 +187,66 @@ namespace qi {
     boost::mutex mutex;
     boost::condition_variable cond;
     bool gotPong = false;
+    unsigned int othersActive = 0;
     unsigned int nbTimeout = 0;
     while (_work.load())
     {
+      _workerThreads->joinFinished();
       qiLogDebug() << "Ping";
       gotPong = false;
-      post(qi::Seconds(0), boost::bind(&ping_me, boost::ref(gotPong), boost::ref(cond)));
+      const qi::SteadyClockTimePoint pingTime = qi::SteadyClock::now();
+      post(qi::Seconds(0), boost::bind(&ping_me, boost::ref(gotPong), boost::ref(cond),
+                                           boost::ref(_activeTask), boost::ref(othersActive)));
       boost::mutex::scoped_lock l(mutex);
-      if (!cond.timed_wait(l,
+      EventLoopPoolController::Sample sample;
+      sample.timedOut = !cond.timed_wait(l,
         boost::get_system_time()+ boost::posix_time::milliseconds(msTimeout),
-        boost::bind(&bool_identity, boost::ref(gotPong))))
+        boost::bind(&bool_identity, boost::ref(gotPong)));
+      sample.queueDelay = qi::SteadyClock::now() - pingTime;
+      sample.threads = *_nThreads - 1; // we count in nThreads
+      sample.activeTasks = sample.timedOut ? *_activeTask : othersActive;
+      const int change = _controller.decide(sample);
+      if (change > 0)
       {
         if (_maxThreads && *_nThreads >= _maxThreads + 1) // we count in nThreads
         {
-          ++nbTimeout;
-          qiLogInfo() << "Threadpool " << _name << " limit reached (" << nbTimeout << " timeouts, number of tasks: " << *_totalTask << ", number of active tasks: " << *_activeTask <<  ", number of threads: " << _maxThreads << ")";
-
-          if (nbTimeout >= maxTimeouts)
+          if (sample.timedOut)
           {
-            qiLogError() << "Threadpool " << _name <<
-              ": System seems to be deadlocked, sending emergency signal";
-            if (_emergencyCallback)
+            ++nbTimeout;
+            qiLogInfo() << "Threadpool " << _name << " limit reached (" << nbTimeout << " timeouts, number of tasks: " << *_totalTask << ", number of active tasks: " << *_activeTask <<  ", number of threads: " << _maxThreads << ")";
+
+            if (nbTimeout >= maxTimeouts)
             {
-              try {
-                _emergencyCallback();
-              } catch (...) {
+              qiLogError() << "Threadpool " << _name <<
+                ": System seems to be deadlocked, sending emergency signal";
+              if (_emergencyCallback)
+              {
+                try {
+                  _emergencyCallback();
+                } catch (...) {
+                }
               }
             }
           }
         }
         else
         {
-          qiLogInfo() << _name << ": Spawning more threads (" << *_nThreads << ')';
+          qiLogInfo("qi.eventloop.pool") << _name << ": Spawning more threads (" << *_nThreads << ')';
           _workerThreads->launch(&EventLoopAsio::_runPool, this);
+          _controller.threadsAdded(1);
         }
+      }
+      else if (change < 0)
+      {
+        qiLogInfo("qi.eventloop.pool") << _name << ": Stopping " << -change << " idle threads ("
+                                       << sample.threads << ')';
+        // Whichever threads run these handlers leave the pool
+        for (int i = 0; i < -change; ++i)
+          _io.post(&terminate_thread);
+        _controller.threadsRemoved(-change);
+      }
+      if (sample.timedOut)
+      {
         qi::os::msleep(msGrace);
       }
       else
@@ -203,6 +267,7 @@ namespace qi {
     _running.setIfEquals(0, 1);
     ++_nThreads;
 
+    bool terminated = false;
     while (true) {
       try
       {
@@ -210,6 +275,7 @@ namespace qi {
         //the handler finished by himself. just quit.
         break;
       } catch(const detail::TerminateThread& /* e */) {
+        terminated = true;
         break;
       } catch(const std::exception& e) {
         qiLogWarning() << "Error caught in eventloop(" << _name << ").async: " << e.what();
@@ -217,6 +283,8 @@ namespace qi {
         qiLogWarning() << "Uncaught exception in eventloop(" << _name << ")";
       }
     }
+    if (terminated)
+      _workerThreads->markFinished();
     if (!--_nThreads)
       --_running;
   }
@@ -270,36 +338,6 @@ namespace qi {
     }
   }
 
-  class ScopedIncDec {
-  public:
-    ScopedIncDec(qi::Atomic<qi::uint32_t>& atom)
-      : _atom(atom)
-    {
-      ++_atom;
-    }
-
-    ~ScopedIncDec() {
-      --_atom;
-    }
-
-    qi::Atomic<qi::uint32_t>& _atom;
-  };
-
-  class ScopedExitDec {
-  public:
-    ScopedExitDec(qi::Atomic<qi::uint32_t>& atom)
-      : _atom(atom)
-    {
-    }
-
-    ~ScopedExitDec() {
-      --_atom;
-    }
-
-    qi::Atomic<qi::uint32_t>& _atom;
-  };
-
-
   void EventLoopAsio::invoke_maybe(boost::function<void()> f, qi::uint32_t id, qi::Promise<void> p, const boost::system::error_code& erc)
   {
     ScopedExitDec _(_totalTask);
@@ -338,12 +376,27 @@ namespace qi {
   }
 
 
+  void EventLoopAsio::onTimerExpired(TimerWheel::Timer& timer)
+  {
+    static boost::system::error_code erc;
+    _io.post(boost::bind<void>(&EventLoopAsio::invoke_maybe, this, timer.callback, timer.id,
+                               timer.promise ? *timer.promise : qi::Promise<void>(), erc));
+  }
+
+  void EventLoopAsio::onTimerCanceled(TimerWheel::Timer& timer)
+  {
+    --_totalTask;
+    tracepoint(qi_qi, eventloop_task_cancel, timer.id);
+    if (timer.promise)
+      timer.promise->setCanceled();
+  }
+
   void EventLoopAsio::post(qi::Duration delay,
       const boost::function<void ()>& cb)
   {
     static boost::system::error_code erc;
-    qi::Promise<void> p;
     if (delay == qi::Duration(0)) {
+      qi::Promise<void> p;
       uint32_t id = ++gTaskId;
       tracepoint(qi_qi, eventloop_post, id, cb.target_type().name());
 
@@ -352,7 +405,7 @@ namespace qi {
       _io.post(boost::bind<void>(&EventLoopAsio::invoke_maybe, this, cb, id, p, erc));
     }
     else
-      asyncCall(delay, cb);
+      post(qi::SteadyClock::now() + delay, cb);
   }
 
   qi::Future<void> EventLoopAsio::asyncCall(qi::Duration delay,
@@ -368,13 +421,7 @@ namespace qi {
     ++_totalTask;
     tracepoint(qi_qi, eventloop_delay, id, cb.target_type().name(), boost::chrono::duration_cast<qi::MicroSeconds>(delay).count());
     if (delay > Duration::zero())
-    {
-      boost::shared_ptr<boost::asio::steady_timer> timer = boost::make_shared<boost::asio::steady_timer>(boost::ref(_io));
-      timer->expires_from_now(boost::chrono::duration_cast<boost::asio::steady_timer::duration>(delay));
-      qi::Promise<void> prom(boost::bind(&boost::asio::steady_timer::cancel, timer));
-      timer->async_wait(boost::bind(&EventLoopAsio::invoke_maybe, this, cb, id, prom, _1));
-      return prom.future();
-    }
+      return _timers.async(qi::SteadyClock::now() + delay, cb, id);
     Promise<void> prom(PromiseNoop<void>);
     _io.post(boost::bind<void>(&EventLoopAsio::invoke_maybe, this, cb, id, prom,erc));
     return prom.future();
@@ -383,8 +430,13 @@ namespace qi {
   void EventLoopAsio::post(qi::SteadyClockTimePoint timepoint,
       const boost::function<void ()>& cb)
   {
-    static boost::system::error_code erc;
-    asyncCall(timepoint, cb);
+    if (!_work.load())
+      return;
+
+    uint32_t id = ++gTaskId;
+
+    ++_totalTask;
+    _timers.post(timepoint, cb, id);
   }
 
   qi::Future<void> EventLoopAsio::asyncCall(qi::SteadyClockTimePoint timepoint,
@@ -397,11 +449,7 @@ namespace qi {
 
     ++_totalTask;
     //tracepoint(qi_qi, eventloop_delay, id, cb.target_type().name(), qi::MicroSeconds(delay).count());
-    boost::shared_ptr<SteadyTimer> timer = boost::make_shared<SteadyTimer>(boost::ref(_io));
-    timer->expires_at(timepoint);
-    qi::Promise<void> prom(boost::bind(&SteadyTimer::cancel, timer));
-    timer->async_wait(boost::bind(&EventLoopAsio::invoke_maybe, this, cb, id, prom, _1));
-    return prom.future();
+    return _timers.async(timepoint, cb, id);
   }
 
   void EventLoopAsio::setMaxThreads(unsigned int max)
@@ -409,13 +457,52 @@ namespace qi {
     _maxThreads = max;
   }
 
+  void EventLoopAsio::setMinThreads(unsigned int min)
+  {
+    _controller.setMinThreads(min);
+  }
+
+  EventLoop::PoolStatus EventLoopAsio::poolStatus()
+  {
+    EventLoop::PoolStatus status;
+    _controller.fillStatus(status);
+    const unsigned int threads = *_nThreads;
+    status.threads = threads ? threads - 1 : 0; // without the ping thread
+    status.maxThreads = _maxThreads;
+    status.activeTasks = *_activeTask;
+    const unsigned int total = *_totalTask;
+    status.pendingTasks = total > status.activeTasks ? total - status.activeTasks : 0;
+    return status;
+  }
+
   void* EventLoopAsio::nativeHandle()
   {
     return static_cast<void*>(&_io);
   }
 
+  static EventLoopPrivate* makeEventLoopPrivate(EventLoop::Backend backend)
+  {
+    if (backend == EventLoop::Backend::Default)
+    {
+      const std::string envBackend = qi::os::getenv("QI_EVENTLOOP_BACKEND");
+      if (envBackend == "workstealing")
+        backend = EventLoop::Backend::WorkStealing;
+      else if (!envBackend.empty() && envBackend != "asio")
+        qiLogWarning() << "Unknown QI_EVENTLOOP_BACKEND '" << envBackend << "', using asio";
+    }
+    if (backend == EventLoop::Backend::WorkStealing)
+      return new EventLoopWorkStealing();
+    return new EventLoopAsio();
+  }
+
   EventLoop::EventLoop(const std::string& name)
-  : _p(0)
+  : _p(makeEventLoopPrivate(Backend::Default))
+  , _name(name)
+  {
+  }
+
+  EventLoop::EventLoop(const std::string& name, Backend backend)
+  : _p(makeEventLoopPrivate(backend))
   , _name(name)
   {
   }
@@ -429,7 +516,7 @@ namespace qi {
 
   #define CHECK_STARTED                                                            \
   do {                                                                             \
-    if (!_p)                                                                       \
+    if (!_p || !_p->_startCalled)                                                  \
       throw std::runtime_error("EventLoop " __HERE " : EventLoop not started");  \
   } while(0)
 
@@ -451,9 +538,9 @@ namespace qi {
   void EventLoop::start(int nthreads)
   {
     qiLogDebug() << this << " EventLoop start";
-    if (_p)
+    if (_p->_startCalled)
       return;
-    _p = new EventLoopAsio();
+    _p->_startCalled = true;
     _p->_name = _name;
     _p->start(nthreads);
     qiLogDebug() << this << " EventLoop start done";
@@ -472,6 +559,18 @@ namespace qi {
     return _p->nativeHandle();
   }
 
+  int EventLoop::currentThreadIndex()
+  {
+    CHECK_STARTED;
+    return _p->currentThreadIndex();
+  }
+
+  void EventLoop::postOnThread(int index, boost::function<void()> callback)
+  {
+    CHECK_STARTED;
+    _p->postOnThread(index, callback);
+  }
+
   void EventLoop::postDelayImpl(boost::function<void()> callback,
       qi::Duration delay)
   {
@@ -504,18 +603,32 @@ namespace qi {
 
   void EventLoop::setEmergencyCallback(boost::function<void()> cb)
   {
-    if (!_p)
+    if (!_p->_startCalled)
       throw std::runtime_error("call start before");
     _p->_emergencyCallback = cb;
   }
 
   void EventLoop::setMaxThreads(unsigned int max)
   {
-    if (!_p)
+    if (!_p->_startCalled)
       throw std::runtime_error("call start before");
     _p->setMaxThreads(max);
   }
 
+  void EventLoop::setMinThreads(unsigned int min)
+  {
+    if (!_p->_startCalled)
+      throw std::runtime_error("call start before");
+    _p->setMinThreads(min);
+  }
+
+  EventLoop::PoolStatus EventLoop::poolStatus()
+  {
+    if (!_p->_startCalled)
+      throw std::runtime_error("call start before");
+    return _p->poolStatus();
+  }
+
   struct MonitorContext
   {
     EventLoop* target;
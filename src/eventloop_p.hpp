@@ -8,11 +8,19 @@
 #define _SRC_EVENTLOOP_P_HPP_
 
 #include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <boost/optional.hpp>
+#include <boost/scoped_array.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
 #include <boost/asio.hpp>
 #include <qi/eventloop.hpp>
+#include <qi/future.hpp>
+
+#include "timerwheel.hpp"
 
 namespace qi {
   class AsyncCallHandlePrivate
@@ -50,13 +58,170 @@ namespace qi {
     virtual void destroy()=0;
     virtual void* nativeHandle()=0;
     virtual void setMaxThreads(unsigned int max)=0;
+    virtual void setMinThreads(unsigned int min)=0;
+    virtual EventLoop::PoolStatus poolStatus()=0;
+    /// Index of the thread of the loop running the caller, -1 if unknown
+    virtual int currentThreadIndex() { return -1; }
+    /// Post a callback, preferably to the thread of the given index
+    virtual void postOnThread(int index, const boost::function<void ()>& callback)
+    {
+      post(qi::Duration(0), callback);
+    }
     boost::function<void()> _emergencyCallback;
     std::string             _name;
+    /// Set by EventLoop::start(), the implementation is created with the EventLoop
+    bool                    _startCalled = false;
 
   protected:
     virtual ~EventLoopPrivate() = default;
   };
 
+  class ScopedIncDec {
+  public:
+    ScopedIncDec(qi::Atomic<qi::uint32_t>& atom)
+      : _atom(atom)
+    {
+      ++_atom;
+    }
+
+    ~ScopedIncDec() {
+      --_atom;
+    }
+
+    qi::Atomic<qi::uint32_t>& _atom;
+  };
+
+  class ScopedExitDec {
+  public:
+    ScopedExitDec(qi::Atomic<qi::uint32_t>& atom)
+      : _atom(atom)
+    {
+    }
+
+    ~ScopedExitDec() {
+      --_atom;
+    }
+
+    qi::Atomic<qi::uint32_t>& _atom;
+  };
+
+  /// Threads of an EventLoopPrivate implementation.
+  class WorkerThreadPool
+  {
+  public:
+    ~WorkerThreadPool() { joinAll(); }
+
+    template<class... Args>
+    void launch(Args&&... args)
+    {
+      boost::mutex::scoped_lock locked(_mutex);
+      _workers.emplace_back(std::forward<Args>(args)...);
+    }
+
+    /// Called by a thread leaving the pool before the event loop stops.
+    void markFinished()
+    {
+      boost::mutex::scoped_lock locked(_mutex);
+      _finished.push_back(std::this_thread::get_id());
+    }
+
+    /// Join the threads which called markFinished().
+    void joinFinished()
+    {
+      std::vector<std::thread> finished;
+      {
+        boost::mutex::scoped_lock locked(_mutex);
+        for (const std::thread::id& id : _finished)
+        {
+          for (std::size_t i = 0; i < _workers.size(); ++i)
+          {
+            if (_workers[i].get_id() == id)
+            {
+              finished.push_back(std::move(_workers[i]));
+              _workers.erase(_workers.begin() + i);
+              break;
+            }
+          }
+        }
+        _finished.clear();
+      }
+      for (std::thread& workerThread : finished)
+        workerThread.join();
+    }
+
+    void joinAll()
+    {
+      std::thread workerThread;
+      while ((workerThread = pop()).joinable())
+      {
+        workerThread.join();
+      }
+    }
+
+  private:
+    std::vector<std::thread> _workers;
+    std::vector<std::thread::id> _finished;
+    boost::mutex _mutex;
+
+    std::thread pop()
+    {
+      boost::mutex::scoped_lock locked(_mutex);
+      if (_workers.empty())
+      {
+        return {};
+      }
+      else
+      {
+        std::thread workerThread = std::move(_workers.back());
+        _workers.pop_back();
+        return workerThread;
+      }
+    }
+  };
+
+  /**
+   * Decides how many threads an event loop needs, from samples taken
+   * periodically by its monitoring thread.
+   *
+   * The pool grows by one thread while a probe task waits more than the
+   * target delay with all threads busy. Once some threads stayed idle for the
+   * shrink delay, half of them leave the pool, without going below the
+   * minimum. Decisions are logged in the "qi.eventloop.pool" category.
+   */
+  class EventLoopPoolController
+  {
+  public:
+    struct Sample
+    {
+      qi::Duration queueDelay; // between the post of the probe and its execution
+      bool timedOut;           // the probe did not run in time
+      unsigned int threads;
+      unsigned int activeTasks;
+    };
+
+    EventLoopPoolController();
+
+    void start(const std::string& name, unsigned int threads);
+    /// Number of threads to add, if positive, or to remove, if negative.
+    int decide(const Sample& sample);
+    void threadsAdded(unsigned int count);
+    void threadsRemoved(unsigned int count);
+    void setMinThreads(unsigned int min);
+    /// Fill the fields of status known by the controller.
+    void fillStatus(EventLoop::PoolStatus& status) const;
+
+  private:
+    std::string _name;
+    std::atomic<unsigned int> _minThreads;
+    qi::Duration _targetDelay;
+    qi::Duration _shrinkDelay;
+    qi::SteadyClockTimePoint _lastSample;
+    qi::Duration _idleTime;
+    std::atomic<qi::Duration::rep> _queueDelay;
+    std::atomic<unsigned int> _threadsAdded;
+    std::atomic<unsigned int> _threadsRemoved;
+  };
+
   class EventLoopAsio final: public EventLoopPrivate
   {
   public:
@@ -76,8 +241,12 @@ namespace qi {
     void destroy() override;
     void* nativeHandle() override;
     void setMaxThreads(unsigned int max) override;
+    void setMinThreads(unsigned int min) override;
+    EventLoop::PoolStatus poolStatus() override;
   private:
     void invoke_maybe(boost::function<void()> f, qi::uint32_t id, qi::Promise<void> p, const boost::system::error_code& erc);
+    void onTimerExpired(TimerWheel::Timer& timer);
+    void onTimerCanceled(TimerWheel::Timer& timer);
     void _runPool();
     void _pingThread();
     ~EventLoopAsio() override;
@@ -92,14 +261,133 @@ namespace qi {
     qi::Atomic<unsigned int> _nThreads;
     boost::asio::io_service _io;
     std::atomic<boost::asio::io_service::work*> _work; // keep io.run() alive
+    TimerWheel _timers;
     boost::thread      _thd;
     qi::Atomic<int>    _running;
     boost::recursive_mutex _mutex;
     boost::thread::id  _id;
     unsigned int _maxThreads;
 
-    class WorkerThreadPool;
     boost::scoped_ptr<WorkerThreadPool> _workerThreads;
+    EventLoopPoolController _controller;
+
+    qi::Atomic<uint32_t> _totalTask;
+    qi::Atomic<uint32_t> _activeTask;
+  };
+
+  /**
+   * Each thread runs the tasks of its own queue, and steals from the queues
+   * of the other threads when it is empty.
+   *
+   * Tasks posted from a thread of the loop stay in that thread's queue, other
+   * tasks are spread across the queues, so that posting does not contend on a
+   * single lock. Sockets and timers still use an io_service, which one idle
+   * thread runs while the other idle threads sleep, and which busy threads
+   * poll regularly.
+   *
+   * A task posted to a given thread with postOnThread() is not stolen during
+   * QI_EVENTLOOP_AFFINITY_GRACE_US microseconds, unless that thread left the
+   * pool, so that it moves to another thread only when its own lags behind.
+   * If QI_EVENTLOOP_PIN_THREADS is set, each thread is pinned to a CPU.
+   */
+  class EventLoopWorkStealing final: public EventLoopPrivate
+  {
+  public:
+    EventLoopWorkStealing();
+    bool isInThisContext() override;
+    void start(int nthreads) override;
+    void join() override;
+    void stop() override;
+    qi::Future<void> asyncCall(qi::Duration delay,
+      boost::function<void ()> callback) override;
+    void post(qi::Duration delay,
+      const boost::function<void ()>& callback) override;
+    qi::Future<void> asyncCall(qi::SteadyClockTimePoint timepoint,
+        boost::function<void ()> callback) override;
+    void post(qi::SteadyClockTimePoint timepoint,
+        const boost::function<void ()>& callback) override;
+    void destroy() override;
+    void* nativeHandle() override;
+    void setMaxThreads(unsigned int max) override;
+    void setMinThreads(unsigned int min) override;
+    EventLoop::PoolStatus poolStatus() override;
+    int currentThreadIndex() override;
+    void postOnThread(int index, const boost::function<void ()>& callback) override;
+  private:
+    struct Task
+    {
+      boost::function<void()> callback;
+      qi::uint32_t id;
+      boost::optional<qi::Promise<void> > promise; // unset for post()
+      qi::SteadyClockTimePoint stealAfter; // the epoch if it can be stolen anytime
+    };
+    struct Worker
+    {
+      EventLoopWorkStealing* owner;
+      unsigned int index;
+      std::atomic<bool> running{false}; // a thread uses this queue
+      std::atomic<bool> busy{false};    // the thread runs tasks, it is not idle
+      bool sleeping = false;            // guarded by _sleepersMutex
+      bool woken = false;               // guarded by mutex
+      boost::condition_variable wakeUp; // signaled under mutex
+      boost::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    /// The worker running on the current thread, whatever its event loop
+    static boost::thread_specific_ptr<Worker>& currentWorkerPtr();
+    /// The worker running on the current thread if it belongs to this loop
+    Worker* currentWorker();
+    bool spawnWorker();
+    /// Push a task to the queue of the worker of index preferred, if any and not overloaded
+    void schedule(Task task, int preferred = -1);
+    /// Set retry to the earliest time a task which was not stolen may be
+    bool popTask(Worker& self, Task& task, qi::SteadyClockTimePoint& retry);
+    /// Whether an idle worker should leave the pool
+    bool leavePool();
+    /// Wait on the io_service or sleep, false once the loop is stopped and has no more work
+    bool waitForWork(Worker& self, qi::SteadyClockTimePoint retry);
+    /// Sleep until woken up or until retry, if it is not the epoch
+    void sleep(Worker& self, qi::SteadyClockTimePoint retry);
+    /// Wake worker up if it sleeps
+    bool wakeSleeper(Worker& worker);
+    bool wakeAnySleeper();
+    void notify(Worker& worker);
+    /// Wake the worker waiting on the io_service up, if any
+    void wakeIoWaiter();
+    void invoke(Task& task);
+    void onTimerExpired(TimerWheel::Timer& timer);
+    void onTimerCanceled(TimerWheel::Timer& timer);
+    void _runWorker(Worker* self);
+    void _pingThread();
+    ~EventLoopWorkStealing() override;
+
+    boost::asio::io_service _io;
+    std::atomic<boost::asio::io_service::work*> _work; // keep io.run() alive
+    TimerWheel _timers;
+    boost::recursive_mutex _mutex;
+    bool _started;
+    unsigned int _maxThreads;
+
+    boost::scoped_array<Worker> _workers;
+    unsigned int _capacity;
+    std::atomic<unsigned int> _nWorkers;
+    std::atomic<unsigned int> _nextWorker; // round robin for external posts
+    std::atomic<unsigned int> _queued;     // tasks waiting in all queues
+    std::atomic<unsigned int> _idle;       // workers waiting on the io_service
+    std::atomic<unsigned int> _wakeups;    // wake-up handlers not run yet
+    std::atomic<unsigned int> _retiring;   // idle workers asked to leave the pool
+    std::atomic<bool> _ioWaiter;           // an idle worker waits on the io_service
+    std::atomic<unsigned int> _waking;     // workers woken up, not running yet
+    boost::mutex _sleepersMutex;
+    std::vector<Worker*> _sleepers;        // idle workers which can wait on the io_service
+    qi::Duration _affinityGrace;
+    bool _pinThreads;
+
+    qi::Atomic<unsigned int> _nThreads;
+    qi::Atomic<int>    _running;
+    boost::scoped_ptr<WorkerThreadPool> _workerThreads;
+    EventLoopPoolController _controller;
 
     qi::Atomic<uint32_t> _totalTask;
     qi::Atomic<uint32_t> _activeTask;
@@ -0,0 +1,739 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <algorithm>
+
+#include <qi/log.hpp>
+#include <qi/os.hpp>
+#include <qi/getenv.hpp>
+
+#include "eventloop_p.hpp"
+#ifdef WITH_PROBES
+# include "tp_qi.h"
+#else
+# define tracepoint(...)
+#endif
+
+qiLogCategory("qi.eventloop");
+
+namespace qi {
+  static qi::Atomic<uint32_t> gTaskId = 0;
+
+  // A busy worker polls the io_service once every IoPollInterval tasks.
+  static const unsigned int IoPollInterval = 32;
+
+  // Upper bound of the number of workers when the pool size is not limited.
+  static const unsigned int DefaultWorkerCapacity = 256;
+
+  // A task is posted to the thread it prefers as long as that thread's queue
+  // is at most AffinitySlack tasks longer than the average queue.
+  static const unsigned int AffinitySlack = 4;
+
+  namespace
+  {
+    class ScopedCount
+    {
+    public:
+      explicit ScopedCount(std::atomic<unsigned int>& count)
+        : _count(count)
+      {
+        ++_count;
+      }
+      ~ScopedCount()
+      {
+        --_count;
+      }
+    private:
+      std::atomic<unsigned int>& _count;
+    };
+  }
+
+  EventLoopWorkStealing::EventLoopWorkStealing()
+  : _work(nullptr)
+  , _timers(_io,
+            boost::bind(&EventLoopWorkStealing::onTimerExpired, this, _1),
+            boost::bind(&EventLoopWorkStealing::onTimerCanceled, this, _1))
+  , _started(false)
+  , _maxThreads(0)
+  , _capacity(0)
+  , _nWorkers(0)
+  , _nextWorker(0)
+  , _queued(0)
+  , _idle(0)
+  , _wakeups(0)
+  , _retiring(0)
+  , _ioWaiter(false)
+  , _waking(0)
+  , _affinityGrace(0)
+  , _pinThreads(false)
+  , _workerThreads(new WorkerThreadPool())
+  {
+    _name = "workstealingeventloop";
+  }
+
+  EventLoopWorkStealing::~EventLoopWorkStealing()
+  {
+    if (*_running && currentWorker())
+      qiLogError() << "Destroying EventLoopPrivate from itself while running";
+    stop();
+    join();
+  }
+
+  void EventLoopWorkStealing::start(int nthread)
+  {
+    if (*_running || _started)
+      return;
+    if (nthread == 0)
+    {
+      nthread = boost::thread::hardware_concurrency();
+      if (nthread < 3)
+        nthread = 3;
+      const char* envNthread = getenv("QI_EVENTLOOP_THREAD_COUNT");
+      if (envNthread)
+        nthread = strtol(envNthread, 0, 0);
+    }
+    _maxThreads = qi::os::getEnvDefault("QI_EVENTLOOP_MAX_THREADS", 150);
+    _affinityGrace = qi::MicroSeconds(qi::os::getEnvDefault("QI_EVENTLOOP_AFFINITY_GRACE_US", 500u));
+    _pinThreads = qi::os::getEnvDefault("QI_EVENTLOOP_PIN_THREADS", false);
+    // Queues can not be added while other workers steal from them,
+    // so allocate all the ones the pool may grow to.
+    _capacity = std::max(static_cast<unsigned int>(nthread),
+                         _maxThreads ? _maxThreads : DefaultWorkerCapacity);
+    _workers.reset(new Worker[_capacity]);
+    _controller.start(_name, nthread);
+    _started = true;
+    _work = new boost::asio::io_service::work(_io);
+    for (int i=0; i<nthread; ++i)
+      spawnWorker();
+    _workerThreads->launch(&EventLoopWorkStealing::_pingThread, this);
+    while (!*_running)
+      qi::os::msleep(0);
+  }
+
+  bool EventLoopWorkStealing::spawnWorker()
+  {
+    // Only called by start() and the ping thread, one after the other.
+    // Reuse the queue of a worker which left the pool, if any.
+    const unsigned int count = _nWorkers.load();
+    unsigned int index = 0;
+    while (index < count && _workers[index].running.load())
+      ++index;
+    if (index >= _capacity)
+      return false;
+    Worker& worker = _workers[index];
+    worker.owner = this;
+    worker.index = index;
+    worker.running = true;
+    if (index == count)
+      _nWorkers = index + 1;
+    _workerThreads->launch(&EventLoopWorkStealing::_runWorker, this, &worker);
+    return true;
+  }
+
+  boost::thread_specific_ptr<EventLoopWorkStealing::Worker>& EventLoopWorkStealing::currentWorkerPtr()
+  {
+    // Workers are owned by their event loop
+    static boost::thread_specific_ptr<Worker> worker([](Worker*) {});
+    return worker;
+  }
+
+  EventLoopWorkStealing::Worker* EventLoopWorkStealing::currentWorker()
+  {
+    Worker* worker = currentWorkerPtr().get();
+    return (worker && worker->owner == this) ? worker : 0;
+  }
+
+  void EventLoopWorkStealing::destroy()
+  {
+    // Joining the workers from one of them would deadlock
+    if (currentWorker())
+      std::thread(boost::bind(&EventLoopWorkStealing::destroy, this)).detach();
+    else
+      delete this;
+  }
+
+  bool EventLoopWorkStealing::isInThisContext()
+  {
+    // Like EventLoopAsio, never claim to be in context: metaCall() would
+    // otherwise turn asynchronous calls from the pool into synchronous ones.
+    return false;
+  }
+
+  static void ping_me(bool & ping, boost::condition_variable& cond,
+                      qi::Atomic<uint32_t>& activeTask, unsigned int& othersActive)
+  {
+    othersActive = *activeTask - 1; // not counting ourselves
+    ping = true;
+    cond.notify_all();
+  }
+
+  static bool bool_identity(bool& b)
+  {
+    return b;
+  }
+
+  static void wake_up()
+  {
+  }
+
+  void EventLoopWorkStealing::_pingThread()
+  {
+    qi::os::setCurrentThreadName("EvLoop.mon");
+    static unsigned int msTimeout = qi::os::getEnvDefault("QI_EVENTLOOP_PING_TIMEOUT", 500u);
+    static unsigned int msGrace = qi::os::getEnvDefault("QI_EVENTLOOP_GRACE_PERIOD", 0u);
+    static unsigned int maxTimeouts = qi::os::getEnvDefault("QI_EVENTLOOP_MAX_TIMEOUTS", 20u);
+    ++_nThreads;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool gotPong = false;
+    unsigned int othersActive = 0;
+    unsigned int nbTimeout = 0;
+    while (_work.load())
+    {
+      _workerThreads->joinFinished();
+      qiLogDebug() << "Ping";
+      gotPong = false;
+      const qi::SteadyClockTimePoint pingTime = qi::SteadyClock::now();
+      post(qi::Seconds(0), boost::bind(&ping_me, boost::ref(gotPong), boost::ref(cond),
+                                           boost::ref(_activeTask), boost::ref(othersActive)));
+      boost::mutex::scoped_lock l(mutex);
+      EventLoopPoolController::Sample sample;
+      sample.timedOut = !cond.timed_wait(l,
+        boost::get_system_time()+ boost::posix_time::milliseconds(msTimeout),
+        boost::bind(&bool_identity, boost::ref(gotPong)));
+      sample.queueDelay = qi::SteadyClock::now() - pingTime;
+      sample.threads = *_nThreads - 1; // we count in nThreads
+      sample.activeTasks = sample.timedOut ? *_activeTask : othersActive;
+      const int change = _controller.decide(sample);
+      if (change > 0)
+      {
+        if ((_maxThreads && *_nThreads >= _maxThreads + 1) // we count in nThreads
+            || !spawnWorker())
+        {
+          if (sample.timedOut)
+          {
+            ++nbTimeout;
+            qiLogInfo() << "Threadpool " << _name << " limit reached (" << nbTimeout << " timeouts, number of tasks: " << *_totalTask << ", number of active tasks: " << *_activeTask <<  ", number of threads: " << sample.threads << ")";
+
+            if (nbTimeout >= maxTimeouts)
+            {
+              qiLogError() << "Threadpool " << _name <<
+                ": System seems to be deadlocked, sending emergency signal";
+              if (_emergencyCallback)
+              {
+                try {
+                  _emergencyCallback();
+                } catch (...) {
+                }
+              }
+            }
+          }
+        }
+        else
+        {
+          qiLogInfo("qi.eventloop.pool") << _name << ": Spawned one more thread (" << *_nThreads << ')';
+          _controller.threadsAdded(1);
+        }
+      }
+      else if (change < 0)
+      {
+        qiLogInfo("qi.eventloop.pool") << _name << ": Stopping " << -change << " idle threads ("
+                                       << sample.threads << ')';
+        // The first idle workers to notice leave the pool, wake them up
+        _retiring += -change;
+        for (int i = 0; i < -change; ++i)
+          _io.post(&wake_up);
+        _controller.threadsRemoved(-change);
+      }
+      if (sample.timedOut)
+      {
+        qi::os::msleep(msGrace);
+      }
+      else
+      {
+        nbTimeout = 0;
+        qiLogDebug() << "Ping ok";
+        qi::os::msleep(msTimeout);
+      }
+    }
+    if (!--_nThreads)
+      --_running;
+  }
+
+  bool EventLoopWorkStealing::popTask(Worker& self, Task& task, qi::SteadyClockTimePoint& retry)
+  {
+    if (!_queued.load())
+      return false;
+    {
+      boost::mutex::scoped_lock lock(self.mutex);
+      if (!self.tasks.empty())
+      {
+        task = std::move(self.tasks.front());
+        self.tasks.pop_front();
+        --_queued;
+        return true;
+      }
+    }
+    // Steal the oldest half of the first busy queue found after ours,
+    // so that we do not come back for each task.
+    const unsigned int count = _nWorkers.load();
+    std::vector<Task> stolen;
+    qi::SteadyClockTimePoint now;
+    for (unsigned int i = 1; i < count && stolen.empty(); ++i)
+    {
+      Worker& victim = _workers[(self.index + i) % count];
+      boost::mutex::scoped_lock lock(victim.mutex, boost::try_to_lock);
+      if (!lock.owns_lock() || victim.tasks.empty())
+        continue;
+      // Leave the victim some time to run the tasks posted to it
+      const qi::SteadyClockTimePoint stealAfter = victim.tasks.front().stealAfter;
+      if (stealAfter != qi::SteadyClockTimePoint() && victim.running.load())
+      {
+        if (now == qi::SteadyClockTimePoint())
+          now = qi::SteadyClock::now();
+        if (stealAfter > now)
+        {
+          if (retry == qi::SteadyClockTimePoint() || stealAfter < retry)
+            retry = stealAfter;
+          continue;
+        }
+      }
+      const std::size_t n = (victim.tasks.size() + 1) / 2;
+      stolen.reserve(n);
+      for (std::size_t j = 0; j < n; ++j)
+      {
+        stolen.push_back(std::move(victim.tasks.front()));
+        victim.tasks.pop_front();
+      }
+    }
+    if (stolen.empty())
+      return false;
+    task = std::move(stolen.front());
+    --_queued;
+    if (stolen.size() > 1)
+    {
+      boost::mutex::scoped_lock lock(self.mutex);
+      for (std::size_t j = 1; j < stolen.size(); ++j)
+        self.tasks.push_back(std::move(stolen[j]));
+    }
+    return true;
+  }
+
+  void EventLoopWorkStealing::_runWorker(Worker* self)
+  {
+    qiLogDebug() << this << "run starting from pool";
+    qi::os::setCurrentThreadName(_name);
+    if (_pinThreads)
+    {
+      const unsigned int cpuCount = std::max(boost::thread::hardware_concurrency(), 1u);
+      const std::vector<int> cpus(1, static_cast<int>(self->index % cpuCount));
+      if (!qi::os::setCurrentThreadCPUAffinity(cpus))
+        qiLogWarning() << _name << ": cannot pin thread " << self->index << " to CPU " << cpus[0];
+    }
+    currentWorkerPtr().reset(self);
+    self->busy = true;
+    _running.setIfEquals(0, 1);
+    ++_nThreads;
+
+    unsigned int sincePoll = 0;
+    bool retired = false;
+    while (true) {
+      try
+      {
+        Task task;
+        qi::SteadyClockTimePoint retry;
+        if (popTask(*self, task, retry))
+        {
+          invoke(task);
+          // Do not let a stream of tasks starve sockets and timers
+          if (++sincePoll == IoPollInterval)
+          {
+            sincePoll = 0;
+            _io.poll();
+          }
+          continue;
+        }
+        sincePoll = 0;
+        if (leavePool())
+        {
+          // We may have been the one polling the io_service, and the sleepers
+          // would not notice that nobody does anymore: hand it over.
+          if (!_ioWaiter.load())
+            wakeAnySleeper();
+          retired = true;
+          break;
+        }
+        // The loop was stopped and has no more work
+        if (!waitForWork(*self, retry))
+          break;
+      } catch(const detail::TerminateThread& /* e */) {
+        break;
+      } catch(const std::exception& e) {
+        qiLogWarning() << "Error caught in eventloop(" << _name << ").async: " << e.what();
+      } catch(...) {
+        qiLogWarning() << "Uncaught exception in eventloop(" << _name << ")";
+      }
+    }
+    currentWorkerPtr().release();
+    self->busy = false;
+    // Tasks pushed to our queue meanwhile will be stolen by the other workers
+    self->running = false;
+    if (retired)
+      _workerThreads->markFinished();
+    if (!--_nThreads)
+      --_running;
+  }
+
+  bool EventLoopWorkStealing::leavePool()
+  {
+    unsigned int retiring = _retiring.load();
+    while (retiring && !_retiring.compare_exchange_weak(retiring, retiring - 1))
+      ;
+    return retiring != 0;
+  }
+
+  bool EventLoopWorkStealing::waitForWork(Worker& self, qi::SteadyClockTimePoint retry)
+  {
+    // A worker waiting for a task it may steal later sleeps, so that it does
+    // not keep the io_service from the others meanwhile.
+    bool expected = false;
+    if (retry != qi::SteadyClockTimePoint() || !_ioWaiter.compare_exchange_strong(expected, true))
+    {
+      self.busy = false;
+      sleep(self, retry);
+      self.busy = true;
+      return true;
+    }
+    self.busy = false;
+    std::size_t handled = 1;
+    {
+      ScopedCount idle(_idle);
+      // A task pushed before we were counted idle did not wake us up
+      if (!_queued.load())
+        handled = _io.run_one();
+    }
+    self.busy = true;
+    _ioWaiter = false;
+    // Hand the io_service over while we run the tasks we got,
+    // or let the next worker see that the loop is stopped.
+    const bool more = handled || _queued.load();
+    if (!handled || _queued.load())
+      wakeAnySleeper();
+    return more;
+  }
+
+  void EventLoopWorkStealing::sleep(Worker& self, qi::SteadyClockTimePoint retry)
+  {
+    const bool timed = retry != qi::SteadyClockTimePoint();
+    {
+      // a wake up is only for the sleep it ended
+      boost::mutex::scoped_lock lock(self.mutex);
+      self.woken = false;
+    }
+    {
+      boost::mutex::scoped_lock lock(_sleepersMutex);
+      self.sleeping = true;
+      if (!timed)
+        _sleepers.push_back(&self);
+    }
+    // Tasks or the io_service may have been left to us before we slept
+    if (timed || (!_queued.load() && _ioWaiter.load()))
+    {
+      // schedule() wakes us up after pushing to our queue, it may have done it before we slept
+      boost::mutex::scoped_lock lock(self.mutex);
+      const auto wokenUp = [&]{ return self.woken || !self.tasks.empty(); };
+      if (timed)
+        self.wakeUp.wait_for(lock, retry - qi::SteadyClock::now(), wokenUp);
+      else
+        self.wakeUp.wait(lock, wokenUp);
+    }
+    boost::mutex::scoped_lock lock(_sleepersMutex);
+    if (self.sleeping)
+    {
+      self.sleeping = false;
+      if (!timed)
+        _sleepers.erase(std::find(_sleepers.begin(), _sleepers.end(), &self));
+    }
+    else
+    {
+      // we were woken up, we run now
+      --_waking;
+    }
+  }
+
+  bool EventLoopWorkStealing::wakeSleeper(Worker& worker)
+  {
+    {
+      boost::mutex::scoped_lock lock(_sleepersMutex);
+      if (!worker.sleeping)
+        return false;
+      worker.sleeping = false;
+      std::vector<Worker*>::iterator it = std::find(_sleepers.begin(), _sleepers.end(), &worker);
+      if (it != _sleepers.end())
+        _sleepers.erase(it);
+      ++_waking;
+    }
+    notify(worker);
+    return true;
+  }
+
+  bool EventLoopWorkStealing::wakeAnySleeper()
+  {
+    Worker* worker;
+    {
+      boost::mutex::scoped_lock lock(_sleepersMutex);
+      if (_sleepers.empty())
+        return false;
+      worker = _sleepers.back();
+      _sleepers.pop_back();
+      worker->sleeping = false;
+      ++_waking;
+    }
+    notify(*worker);
+    return true;
+  }
+
+  void EventLoopWorkStealing::notify(Worker& worker)
+  {
+    {
+      boost::mutex::scoped_lock lock(worker.mutex);
+      worker.woken = true;
+    }
+    // Notify unlocked: the worker would otherwise wake up to wait for the
+    // mutex, and thieves would fail to lock its queue meanwhile.
+    worker.wakeUp.notify_one();
+  }
+
+  static void wokenUp(std::atomic<unsigned int>* wakeups)
+  {
+    --*wakeups;
+  }
+
+  void EventLoopWorkStealing::wakeIoWaiter()
+  {
+    if (_idle.load() > _wakeups.load())
+    {
+      ++_wakeups;
+      _io.post(boost::bind(&wokenUp, &_wakeups));
+    }
+  }
+
+  void EventLoopWorkStealing::schedule(Task task, int preferred)
+  {
+    const unsigned int count = _nWorkers.load();
+    Worker* worker = 0;
+    bool affine = false;
+    if (preferred >= 0 && static_cast<unsigned int>(preferred) < count)
+    {
+      Worker& candidate = _workers[preferred];
+      boost::mutex::scoped_lock lock(candidate.mutex);
+      if (candidate.running.load() && candidate.tasks.size() <= _queued.load() / count + AffinitySlack)
+      {
+        candidate.tasks.push_back(std::move(task));
+        worker = &candidate;
+        affine = true;
+      }
+    }
+    if (!worker)
+    {
+      task.stealAfter = qi::SteadyClockTimePoint();
+      worker = currentWorker();
+      if (!worker)
+      {
+        // Skip the queues of the workers which left the pool
+        worker = &_workers[_nextWorker++ % count];
+        for (unsigned int i = 1; i < count && !worker->running.load(); ++i)
+          worker = &_workers[_nextWorker++ % count];
+      }
+      boost::mutex::scoped_lock lock(worker->mutex);
+      worker->tasks.push_back(std::move(task));
+    }
+    ++_queued;
+    // A worker being woken up will steal the task if nobody runs it first
+    if (!affine && _waking.load())
+      return;
+    // Wake the owner of the queue up if it sleeps. Else wake a sleeping worker
+    // up, which will steal the task if the owner does not run it first, rather
+    // than the one waiting on the io_service, which would have to hand it over.
+    if (wakeSleeper(*worker))
+      return;
+    if (affine && !worker->busy.load())
+      wakeIoWaiter();
+    else if (!wakeAnySleeper())
+      wakeIoWaiter();
+  }
+
+  void EventLoopWorkStealing::invoke(Task& task)
+  {
+    ScopedExitDec _(_totalTask);
+    ScopedIncDec active(_activeTask);
+    tracepoint(qi_qi, eventloop_task_start, task.id);
+
+    try
+    {
+      task.callback();
+      tracepoint(qi_qi, eventloop_task_stop, task.id);
+      if (task.promise)
+        task.promise->setValue(0);
+    }
+    catch (const detail::TerminateThread& /* e */)
+    {
+      throw;
+    }
+    catch (const std::exception& ex)
+    {
+      tracepoint(qi_qi, eventloop_task_error, task.id);
+      if (task.promise)
+        task.promise->setError(ex.what());
+    }
+    catch (...)
+    {
+      tracepoint(qi_qi, eventloop_task_error, task.id);
+      if (task.promise)
+        task.promise->setError("unknown error");
+    }
+  }
+
+  void EventLoopWorkStealing::onTimerExpired(TimerWheel::Timer& timer)
+  {
+    Task task;
+    task.callback = std::move(timer.callback);
+    task.id = timer.id;
+    task.promise = std::move(timer.promise);
+    schedule(std::move(task));
+  }
+
+  void EventLoopWorkStealing::onTimerCanceled(TimerWheel::Timer& timer)
+  {
+    --_totalTask;
+    tracepoint(qi_qi, eventloop_task_cancel, timer.id);
+    if (timer.promise)
+      timer.promise->setCanceled();
+  }
+
+  void EventLoopWorkStealing::stop()
+  {
+    qiLogDebug() << "stopping eventloopworkstealing: " << this;
+    boost::recursive_mutex::scoped_lock sl(_mutex);
+    if (_work.load())
+    {
+      boost::asio::io_service::work* w = _work;
+      _work = nullptr;
+      delete w;
+    }
+  }
+
+  void EventLoopWorkStealing::join()
+  {
+    qiLogVerbose()
+        << "Waiting threads from the pool \"" << _name << "\", remaining tasks: "
+        << *_totalTask << " (" << *_activeTask <<  " active)...";
+    _workerThreads->joinAll();
+    assert(*_running == 0);
+    qiLogDebug()  << "Waiting done";
+  }
+
+  void EventLoopWorkStealing::post(qi::Duration delay,
+      const boost::function<void ()>& cb)
+  {
+    if (delay == qi::Duration(0)) {
+      Task task;
+      task.callback = cb;
+      task.id = ++gTaskId;
+      tracepoint(qi_qi, eventloop_post, task.id, cb.target_type().name());
+      ++_totalTask;
+      schedule(std::move(task));
+    }
+    else
+      post(qi::SteadyClock::now() + delay, cb);
+  }
+
+  int EventLoopWorkStealing::currentThreadIndex()
+  {
+    Worker* worker = currentWorker();
+    return worker ? static_cast<int>(worker->index) : -1;
+  }
+
+  void EventLoopWorkStealing::postOnThread(int index, const boost::function<void ()>& cb)
+  {
+    Task task;
+    task.callback = cb;
+    task.id = ++gTaskId;
+    if (index >= 0)
+      task.stealAfter = qi::SteadyClock::now() + _affinityGrace;
+    tracepoint(qi_qi, eventloop_post, task.id, cb.target_type().name());
+    ++_totalTask;
+    schedule(std::move(task), index);
+  }
+
+  qi::Future<void> EventLoopWorkStealing::asyncCall(qi::Duration delay,
+      boost::function<void ()> cb)
+  {
+    if (!_work.load())
+      return qi::makeFutureError<void>("Schedule attempt on destroyed thread pool");
+
+    Task task;
+    task.callback = cb;
+    task.id = ++gTaskId;
+    tracepoint(qi_qi, eventloop_delay, task.id, cb.target_type().name(), boost::chrono::duration_cast<qi::MicroSeconds>(delay).count());
+    ++_totalTask;
+    if (delay > Duration::zero())
+      return _timers.async(qi::SteadyClock::now() + delay, cb, task.id);
+    Promise<void> prom(PromiseNoop<void>);
+    task.promise = prom;
+    schedule(std::move(task));
+    return prom.future();
+  }
+
+  void EventLoopWorkStealing::post(qi::SteadyClockTimePoint timepoint,
+      const boost::function<void ()>& cb)
+  {
+    if (!_work.load())
+      return;
+
+    ++_totalTask;
+    _timers.post(timepoint, cb, ++gTaskId);
+  }
+
+  qi::Future<void> EventLoopWorkStealing::asyncCall(qi::SteadyClockTimePoint timepoint,
+      boost::function<void ()> cb)
+  {
+    if (!_work.load())
+      return qi::makeFutureError<void>("Schedule attempt on destroyed thread pool");
+
+    ++_totalTask;
+    return _timers.async(timepoint, cb, ++gTaskId);
+  }
+
+  void EventLoopWorkStealing::setMaxThreads(unsigned int max)
+  {
+    if (max > _capacity)
+      qiLogVerbose() << _name << ": at most " << _capacity << " threads can be used";
+    _maxThreads = max;
+  }
+
+  void EventLoopWorkStealing::setMinThreads(unsigned int min)
+  {
+    _controller.setMinThreads(min);
+  }
+
+  EventLoop::PoolStatus EventLoopWorkStealing::poolStatus()
+  {
+    EventLoop::PoolStatus status;
+    _controller.fillStatus(status);
+    const unsigned int threads = *_nThreads;
+    status.threads = threads ? threads - 1 : 0; // without the ping thread
+    status.maxThreads = _maxThreads;
+    status.activeTasks = *_activeTask;
+    const unsigned int total = *_totalTask;
+    status.pendingTasks = total > status.activeTasks ? total - status.activeTasks : 0;
+    return status;
+  }
+
+  void* EventLoopWorkStealing::nativeHandle()
+  {
+    return static_cast<void*>(&_io);
+  }
+}
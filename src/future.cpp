@@ -14,16 +14,37 @@ qiLogCategory("qi.future");
 namespace qi {
 
   namespace detail {
+    /* Only the state is needed to set and read a future: the mutex and the
+     * condition used to block in wait() are created by the first waiter.
+     *
+     * The state is published before the callbacks are run, so that connect()
+     * can tell it must call late callbacks itself. A future is only seen as
+     * finished once its callbacks have run, except by the thread running them.
+     */
     class FutureBasePrivate {
     public:
+      struct Waiter
+      {
+        boost::mutex mutex;
+        boost::condition_variable cond;
+      };
+
       void* operator new(size_t);
       void operator delete(void*);
       FutureBasePrivate();
-      boost::condition_variable_any _cond;
-      boost::recursive_mutex    _mutex;
+      ~FutureBasePrivate();
+      Waiter& waiter();
+
       std::string               _error;
       qi::Atomic<int>           _state;
       qi::Atomic<int>           _cancelRequested;
+      qi::Atomic<int>           _resultReserved;
+      qi::Atomic<int>           _callbacksDone;
+      // written before the state is published, read after it is seen
+      boost::thread::id         _notifier;
+      boost::atomic<Waiter*>    _waiter;
+      // only created for the deprecated FutureBase::mutex()
+      boost::atomic<boost::recursive_mutex*> _mutex;
     };
 
     struct FutureBasePrivatePoolTag { };
@@ -40,12 +61,33 @@ namespace qi {
     }
 
     FutureBasePrivate::FutureBasePrivate()
-      : _cond(),
-        _mutex(),
-        _error()
+      : _error()
+      , _waiter(nullptr)
+      , _mutex(nullptr)
     {
       _state = FutureState_None;
       _cancelRequested = false;
+      _resultReserved = false;
+      _callbacksDone = false;
+    }
+
+    FutureBasePrivate::~FutureBasePrivate()
+    {
+      delete _waiter.load();
+      delete _mutex.load();
+    }
+
+    FutureBasePrivate::Waiter& FutureBasePrivate::waiter()
+    {
+      Waiter* waiter = _waiter.load();
+      if (waiter)
+        return *waiter;
+      Waiter* created = new Waiter;
+      if (_waiter.compare_exchange_strong(waiter, created))
+        return *created;
+      // an other thread created it first
+      delete created;
+      return *waiter;
     }
 
     FutureBase::FutureBase()
@@ -65,41 +107,80 @@ namespace qi {
 
     static bool waitFinished(FutureBasePrivate* p)
     {
-      return *p->_state != FutureState_Running;
+      const int state = *p->_state;
+      if (state == FutureState_Running)
+        return false;
+      if (state == FutureState_None)
+        return true;
+      return *p->_callbacksDone || p->_notifier == boost::this_thread::get_id();
+    }
+
+    // Once the result is published the callbacks being run are waited for
+    // whatever the timeout, as when they were run under the future lock
+    template <typename F>
+    static FutureState waitFor(FutureBasePrivate* p, F waitResult)
+    {
+      if (!waitFinished(p))
+      {
+        FutureBasePrivate::Waiter& waiter = p->waiter();
+        boost::mutex::scoped_lock lock(waiter.mutex);
+        waitResult(waiter.cond, lock);
+        if (*p->_state != FutureState_Running)
+          waiter.cond.wait(lock, boost::bind(&waitFinished, p));
+      }
+      return FutureState(*p->_state);
     }
 
     FutureState FutureBase::wait(int msecs) const {
-      boost::recursive_mutex::scoped_lock lock(_p->_mutex);
-      if (*_p->_state != FutureState_Running)
-        return FutureState(*_p->_state);
-      if (msecs == FutureTimeout_Infinite)
-        _p->_cond.wait(lock, boost::bind(&waitFinished, _p));
-      else if (msecs > 0)
-        _p->_cond.wait_for(lock, qi::MilliSeconds(msecs),
-            boost::bind(&waitFinished, _p));
-      // msecs <= 0 : do nothing just return the state
-      return FutureState(*_p->_state);
+      FutureBasePrivate* p = _p;
+      return waitFor(p, [msecs, p](boost::condition_variable& cond, boost::mutex::scoped_lock& lock) {
+        if (msecs == FutureTimeout_Infinite)
+          cond.wait(lock, boost::bind(&waitFinished, p));
+        else if (msecs > 0)
+          cond.wait_for(lock, qi::MilliSeconds(msecs), boost::bind(&waitFinished, p));
+        // msecs <= 0 : do nothing just return the state
+      });
     }
 
     FutureState FutureBase::wait(qi::Duration duration) const {
-      boost::recursive_mutex::scoped_lock lock(_p->_mutex);
-      if (*_p->_state != FutureState_Running)
-        return FutureState(*_p->_state);
-      _p->_cond.wait_for(lock, duration, boost::bind(&waitFinished, _p));
-      return FutureState(*_p->_state);
+      FutureBasePrivate* p = _p;
+      return waitFor(p, [duration, p](boost::condition_variable& cond, boost::mutex::scoped_lock& lock) {
+        cond.wait_for(lock, duration, boost::bind(&waitFinished, p));
+      });
     }
 
     FutureState FutureBase::wait(qi::SteadyClock::time_point timepoint) const {
-      boost::recursive_mutex::scoped_lock lock(_p->_mutex);
-      if (*_p->_state != FutureState_Running)
-        return FutureState(*_p->_state);
-      _p->_cond.wait_until(lock, timepoint, boost::bind(&waitFinished, _p));
-      return FutureState(*_p->_state);
+      FutureBasePrivate* p = _p;
+      return waitFor(p, [timepoint, p](boost::condition_variable& cond, boost::mutex::scoped_lock& lock) {
+        cond.wait_until(lock, timepoint, boost::bind(&waitFinished, p));
+      });
+    }
+
+    bool FutureBase::reserveResult() {
+      if (*_p->_state != FutureState_Running || !_p->_resultReserved.setIfEquals(false, true))
+        return false;
+      _p->_notifier = boost::this_thread::get_id();
+      return true;
+    }
+
+    bool FutureBase::isResultReserved() const {
+      return *_p->_resultReserved;
+    }
+
+    boost::recursive_mutex& FutureBase::mutex()
+    {
+      boost::recursive_mutex* mutex = _p->_mutex.load();
+      if (mutex)
+        return *mutex;
+      boost::recursive_mutex* created = new boost::recursive_mutex;
+      if (_p->_mutex.compare_exchange_strong(mutex, created))
+        return *created;
+      delete created;
+      return *mutex;
     }
 
     void FutureBase::reportValue() {
-      //always set by setValue
-      //boost::recursive_mutex::scoped_lock lock(_p->_mutex);
+      //always set by setValue, after reserveResult
       _p->_state = FutureState_FinishedWithValue;
     }
 
@@ -108,16 +189,14 @@ namespace qi {
     }
 
     void FutureBase::reportCanceled() {
-      //always set by setCanceled
-      //boost::recursive_mutex::scoped_lock lock(_p->_mutex);
+      //always set by setCanceled, after reserveResult
       _p->_state = FutureState_Canceled;
     }
 
     void FutureBase::reportError(const std::string &message) {
-      //always set by setError
-      //boost::recursive_mutex::scoped_lock lock(_p->_mutex);
-      _p->_state = FutureState_FinishedWithError;
+      //always set by setError, after reserveResult
       _p->_error = message;
+      _p->_state = FutureState_FinishedWithError;
     }
 
     void FutureBase::reportStart() {
@@ -125,12 +204,19 @@ namespace qi {
     }
 
     void FutureBase::notifyFinish() {
-      _p->_cond.notify_all();
+      // The callbacks have run: a waiter created after this load sees it
+      _p->_callbacksDone = true;
+      FutureBasePrivate::Waiter* waiter = _p->_waiter.load();
+      if (!waiter)
+        return;
+      boost::mutex::scoped_lock lock(waiter->mutex);
+      waiter->cond.notify_all();
     }
 
     bool FutureBase::isFinished() const {
       FutureState v = FutureState(*_p->_state);
-      return v == FutureState_FinishedWithValue || v == FutureState_FinishedWithError || v == FutureState_Canceled;
+      return (v == FutureState_FinishedWithValue || v == FutureState_FinishedWithError || v == FutureState_Canceled)
+          && waitFinished(_p);
     }
 
     bool FutureBase::isRunning() const {
@@ -164,11 +250,6 @@ namespace qi {
         throw FutureException(FutureException::ExceptionState_FutureHasNoError);
       return _p->_error;
     }
-
-    boost::recursive_mutex& FutureBase::mutex()
-    {
-      return _p->_mutex;
-    }
   }
 
   std::string FutureException::stateToString(const ExceptionState &es) {
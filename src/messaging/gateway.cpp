@@ -17,12 +17,14 @@
 #include <qi/messaging/gateway.hpp>
 #include <qi/future.hpp>
 #include <qi/signal.hpp>
+#include <qi/getenv.hpp>
 
 #include "tcptransportsocket.hpp"
 #include "servicedirectoryclient.hpp"
 #include "transportserver.hpp"
 #include "clientauthenticator_p.hpp"
 #include "gateway_p.hpp"
+#include "sharedmemorybuffer.hpp"
 
 qiLogCategory("qimessaging.gateway");
 
@@ -74,6 +76,13 @@ struct _pending_msg_eraser
 };
 
 using boolptr = boost::shared_ptr<bool>;
+
+// Messages are forwarded without being decoded, so the buffers they carry
+// must travel inline to reach peers on other machines.
+void disableSharedMemoryBuffers(qi::TransportSocketPtr socket)
+{
+  socket->advertiseCapability(qi::SharedMemoryBuffer::capabilityName, qi::AnyValue::from(false));
+}
 }
 
 namespace qi
@@ -143,6 +152,8 @@ qi::Future<void> Gateway::attachToServiceDirectory(const Url& serviceDirectoryUr
 
 GatewayPrivate::GatewayPrivate(bool ea)
   : _enforceAuth(ea)
+  , _eventBacklogMax(qi::os::getEnvDefault("QI_GATEWAY_EVENT_BACKLOG_MAX", 0u))
+  , _droppedEvents(0)
   , _dying(false)
 {
   _socketCache.init();
@@ -211,6 +222,7 @@ void GatewayPrivate::close(bool clearEndpoints)
     boost::recursive_mutex::scoped_lock lock(_eventSubMutex);
     _pendingEventSubscriptions.clear();
     _eventSubscribers.clear();
+    clearEventFanOut();
   }
   if (clearEndpoints)
     _endpoints.clear();
@@ -366,6 +378,7 @@ void GatewayPrivate::onClientDisconnected(TransportSocketPtr socket, std::string
   {
     boost::recursive_mutex::scoped_lock lock(_eventSubMutex);
     _eventSubscribers.erase(socket);
+    removeEventFanOut(socket);
     EventsEndpointMap::iterator it = _eventSubscribers.begin();
     while (it != _eventSubscribers.end())
     {
@@ -530,6 +543,7 @@ void GatewayPrivate::serviceDisconnected(ServiceId sid)
         it->second.erase(sit);
       }
     }
+    removeServiceEventFanOut(sid);
   }
   {
     boost::recursive_mutex::scoped_lock lock(_serviceMutex);
@@ -739,6 +753,7 @@ void GatewayPrivate::clientAuthenticationMessages(const Message& msg,
 void GatewayPrivate::onClientConnection(TransportSocketPtr socket)
 {
   qiLogVerbose() << "Client " << socket->remoteEndpoint().str() << " has knocked knocked knocked on the gateway";
+  disableSharedMemoryBuffers(socket);
   SignalSubscriberPtr sub = boost::make_shared<SignalSubscriber>();
   boolptr firstMessage = boost::make_shared<bool>(true);
 
@@ -761,6 +776,7 @@ void GatewayPrivate::onClientConnection(TransportSocketPtr socket)
 void GatewayPrivate::onLocalClientConnection(TransportSocketPtr socket)
 {
   qiLogVerbose() << "Client " << socket->remoteEndpoint().str() << " has connected on the local endpoint.";
+  disableSharedMemoryBuffers(socket);
   SignalSubscriberPtr sub = boost::make_shared<SignalSubscriber>();
   boolptr firstMessage = boost::make_shared<bool>(true);
 
@@ -796,6 +812,7 @@ void GatewayPrivate::forgeServiceInfo(ServiceInfo& serviceInfo)
 void GatewayPrivate::startServiceAuthentication(TransportSocketPtr serviceSocket, ServiceId sid)
 {
   ClientAuthenticatorPtr authenticator = _clientAuthenticatorFactory->newAuthenticator();
+  disableSharedMemoryBuffers(serviceSocket);
   CapabilityMap socketCaps = serviceSocket->localCapabilities();
   {
     CapabilityMap tmp = authenticator->initialAuthData();
@@ -908,6 +925,7 @@ void GatewayPrivate::removeEventSubscriber(ServiceId sid,
     gwLink = info.gwLink;
     info.remoteSubscribers.erase(client);
     remainingSubs = info.remoteSubscribers.size();
+    updateEventFanOut(host, sid, object, event, info);
   }
   // no more subscribers: unregister the gateway from the event
   // send the message to the service host
@@ -1062,6 +1080,69 @@ void GatewayPrivate::handleReplyMessage(GwTransaction& t)
   }
 }
 
+void GatewayPrivate::updateEventFanOut(EventHostEndpoint host,
+                                       ServiceId service,
+                                       ObjectId object,
+                                       EventId event,
+                                       const EventSubInfo& info)
+{
+  const EventKey key(host, service, object, event);
+  EventSubscribersPtr subscribers;
+  if (!info.remoteSubscribers.empty())
+  {
+    boost::shared_ptr<EventSubscribers> list = boost::make_shared<EventSubscribers>();
+    list->reserve(info.remoteSubscribers.size());
+    for (std::map<EventSubscriberEndpoint, SignalLink>::const_iterator it = info.remoteSubscribers.begin(),
+                                                                        end = info.remoteSubscribers.end();
+         it != end;
+         ++it)
+      list->push_back(it->first);
+    subscribers = list;
+  }
+
+  // the previous list is released out of the lock
+  boost::mutex::scoped_lock lock(_eventFanOutMutex);
+  if (subscribers)
+    _eventFanOut[key].swap(subscribers);
+  else
+    _eventFanOut.erase(key);
+}
+
+void GatewayPrivate::removeEventFanOut(EventHostEndpoint host)
+{
+  std::vector<EventSubscribersPtr> removed;
+  boost::mutex::scoped_lock lock(_eventFanOutMutex);
+  for (EventFanOutMap::iterator it = _eventFanOut.begin(); it != _eventFanOut.end();)
+    if (it->first.host == host)
+    {
+      removed.push_back(it->second);
+      it = _eventFanOut.erase(it);
+    }
+    else
+      ++it;
+}
+
+void GatewayPrivate::removeServiceEventFanOut(ServiceId service)
+{
+  std::vector<EventSubscribersPtr> removed;
+  boost::mutex::scoped_lock lock(_eventFanOutMutex);
+  for (EventFanOutMap::iterator it = _eventFanOut.begin(); it != _eventFanOut.end();)
+    if (it->first.service == service)
+    {
+      removed.push_back(it->second);
+      it = _eventFanOut.erase(it);
+    }
+    else
+      ++it;
+}
+
+void GatewayPrivate::clearEventFanOut()
+{
+  EventFanOutMap removed;
+  boost::mutex::scoped_lock lock(_eventFanOutMutex);
+  _eventFanOut.swap(removed);
+}
+
 void GatewayPrivate::handleEventMessage(GwTransaction& t, TransportSocketPtr socket)
 {
   Message& msg = t.content;
@@ -1069,27 +1150,38 @@ void GatewayPrivate::handleEventMessage(GwTransaction& t, TransportSocketPtr soc
   unsigned int object = msg.object();
   unsigned int event = msg.event();
 
+  qiLogDebug() << "Handling event " << service << "." << object << "." << event << "...";
+  EventSubscribersPtr subscribers;
   {
-    boost::recursive_mutex::scoped_lock lock(_eventSubMutex);
-    qiLogDebug() << "Handling event " << service << "." << object << "." << event << "...";
-    EventsEndpointMap::iterator endpointIt;
-    EventServiceMap::iterator serviceIt;
-    EventsPerObjectMap::iterator objectIt;
-    ClientsPerEventMap::iterator eventIt;
-    if ((endpointIt = _eventSubscribers.find(socket)) == _eventSubscribers.end() ||
-        (serviceIt = endpointIt->second.find(service)) == endpointIt->second.end() ||
-        (objectIt = serviceIt->second.find(object)) == serviceIt->second.end() ||
-        (eventIt = objectIt->second.find(event)) == objectIt->second.end())
+    boost::mutex::scoped_lock lock(_eventFanOutMutex);
+    EventFanOutMap::const_iterator it = _eventFanOut.find(EventKey(socket, service, object, event));
+    if (it == _eventFanOut.end())
     {
       qiLogDebug() << "No subscribers.";
       return;
     }
+    subscribers = it->second;
+  }
 
-    std::map<TransportSocketPtr, SignalLink>& subs = eventIt->second.remoteSubscribers;
-
-    qiLogDebug() << "Forwarding event to " << subs.size() << " subscribers.";
-    for (std::map<TransportSocketPtr, SignalLink>::iterator it = subs.begin(), end = subs.end(); it != end; ++it)
-      it->first->send(msg);
+  // Every subscriber shares this message and its payload: complete the header
+  // once, so that the sockets only read it.
+  msg._p->complete();
+  qiLogDebug() << "Forwarding event to " << subscribers->size() << " subscribers.";
+  for (EventSubscribers::const_iterator it = subscribers->begin(), end = subscribers->end(); it != end; ++it)
+  {
+    const EventSubscriberEndpoint& subscriber = *it;
+    // when a backlog limit is set, a subscriber which does not keep up loses
+    // events, instead of making the gateway queue them without bound
+    if (_eventBacklogMax && subscriber->sendQueueSize() >= _eventBacklogMax)
+    {
+      const unsigned int dropped = ++_droppedEvents;
+      qiLogDebug() << "Subscriber " << subscriber.get() << " is lagging, dropping event " << service << "."
+                   << object << "." << event;
+      if (dropped % 1000 == 1)
+        qiLogWarning() << "Dropped " << dropped << " events for subscribers which do not keep up";
+      continue;
+    }
+    subscriber->send(msg);
   }
 }
 
@@ -1249,8 +1341,11 @@ void GatewayPrivate::registerEventListenerCall(GwTransaction& t, TransportSocket
       return;
     }
     else
+    {
       // If some clients were already subscribed, add this new client to the list.
       eventIt->second.remoteSubscribers[origin] = signalLink;
+      updateEventFanOut(eventHost, serviceId, objectId, event, eventIt->second);
+    }
   }
   values.destroy();
 
@@ -1294,6 +1389,7 @@ void GatewayPrivate::registerEventListenerReply(GwTransaction& t, TransportSocke
     EventSubInfo& eventInfo = _eventSubscribers[eventHost][service][object][event];
     eventInfo.remoteSubscribers[client] = link;
     eventInfo.gwLink = link;
+    updateEventFanOut(eventHost, service, object, event, eventInfo);
     _pendingEventSubscriptions.erase(evIt);
   }
   Message rep;
@@ -7,8 +7,10 @@
 #ifndef _SRC_MESSAGING_GATEWAY_P_HPP_
 #define _SRC_MESSAGING_GATEWAY_P_HPP_
 
+#include <boost/functional/hash.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <qi/messaging/gateway.hpp>
 #include <qi/property.hpp>
@@ -72,6 +74,37 @@ private:
   ServiceId _originalServiceId;
 };
 
+// An event as received by the gateway: the socket of its host, and its address
+// on that socket. The key owns the socket, so that a socket allocated where a
+// closed one was can not match its entries.
+struct EventKey
+{
+  TransportSocketPtr host;
+  ServiceId service;
+  ObjectId object;
+  EventId event;
+  EventKey(const TransportSocketPtr& h, ServiceId s, ObjectId o, EventId e)
+    : host(h)
+    , service(s)
+    , object(o)
+    , event(e)
+  {
+  }
+  bool operator==(const EventKey& k) const
+  {
+    return k.host == host && k.service == service && k.object == object && k.event == event;
+  }
+};
+
+inline std::size_t hash_value(const EventKey& k)
+{
+  std::size_t seed = boost::hash_value(k.host.get());
+  boost::hash_combine(seed, k.service);
+  boost::hash_combine(seed, k.object);
+  boost::hash_combine(seed, k.event);
+  return seed;
+}
+
 class GatewayPrivate : public qi::Trackable<GatewayPrivate>
 {
 public:
@@ -205,6 +238,24 @@ private:
   EventsEndpointMap _eventSubscribers;
   boost::recursive_mutex _eventSubMutex;
 
+  // Subscribers of each event, as immutable lists replaced whenever
+  // _eventSubscribers changes, so that events are sent out of any lock.
+  using EventSubscribers = std::vector<EventSubscriberEndpoint>;
+  using EventSubscribersPtr = boost::shared_ptr<const EventSubscribers>;
+  using EventFanOutMap = boost::unordered_map<EventKey, EventSubscribersPtr>;
+  EventFanOutMap _eventFanOut;
+  boost::mutex _eventFanOutMutex;
+  // Events are not sent to subscribers which have this many messages waiting
+  // to be written, 0 (the default) for no limit. See QI_GATEWAY_EVENT_BACKLOG_MAX.
+  std::size_t _eventBacklogMax;
+  Atomic<unsigned int> _droppedEvents;
+
+  void updateEventFanOut(EventHostEndpoint host, ServiceId service, ObjectId object, EventId event,
+                         const EventSubInfo& info);
+  void removeEventFanOut(EventHostEndpoint host);
+  void removeServiceEventFanOut(ServiceId service);
+  void clearEventFanOut();
+
   void removeEventSubscriber(ServiceId service,
                              uint32_t object,
                              uint32_t event,
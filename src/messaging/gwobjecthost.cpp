@@ -51,6 +51,66 @@ private:
 
 unsigned int MockObjectHost::id_ = 2;
 
+void GwObjectHost::cacheMethodObjects(ServiceId service, ObjectId object, const MetaObject& metaObject)
+{
+  const MetaObject::MethodMap methods = metaObject.methodMap();
+  for (MetaObject::MethodMap::const_iterator it = methods.begin(), end = methods.end(); it != end; ++it)
+  {
+    unsigned char objects = MethodObjects_None;
+    if (hasObjectsSomewhere(it->second.parametersSignature()))
+      objects |= MethodObjects_Parameters;
+    if (hasObjectsSomewhere(it->second.returnSignature()))
+      objects |= MethodObjects_Return;
+    _methodObjects[MethodAddress(service, object, it->first)] = objects;
+  }
+}
+
+void GwObjectHost::uncacheMethodObjects(ServiceId service, ObjectId object, const MetaObject& metaObject)
+{
+  const MetaObject::MethodMap methods = metaObject.methodMap();
+  for (MetaObject::MethodMap::const_iterator it = methods.begin(), end = methods.end(); it != end; ++it)
+    _methodObjects.erase(MethodAddress(service, object, it->first));
+}
+
+// Whether the object host has nothing to do with msg: no object can be in its
+// payload, and it is neither addressed to nor coming from an object of a client.
+bool GwObjectHost::isPlainMessage(const Message& msg, TransportSocketPtr sender)
+{
+  unsigned char objects;
+  switch (msg.type())
+  {
+  case Message::Type_Call:
+  case Message::Type_Post:
+    // calls on objects of clients are redirected to them
+    if (msg.service() == Message::Service_Server && msg.object() > Message::GenericObject_Main)
+      return false;
+    objects = MethodObjects_Parameters;
+    break;
+  case Message::Type_Reply:
+    // the MetaObjects of services are cached from these replies
+    if (msg.function() == Message::BoundObjectFunction_MetaObject)
+      return false;
+    objects = MethodObjects_Return;
+    break;
+  case Message::Type_Error:
+  case Message::Type_Event:
+    objects = MethodObjects_None;
+    break;
+  default:
+    return false;
+  }
+
+  boost::shared_lock<boost::shared_mutex> lock(_mutex);
+  // the other messages of the clients which own objects may have to be readdressed
+  if (objects != MethodObjects_Parameters && _hostObjectBank.find(sender) != _hostObjectBank.end())
+    return false;
+  if (objects == MethodObjects_None)
+    return true;
+  MethodObjectsMap::const_iterator it = _methodObjects.find(MethodAddress(msg.service(), msg.object(), msg.function()));
+  // unknown methods take the slow path, which knows how to handle them
+  return it != _methodObjects.end() && !(it->second & objects);
+}
+
 void GwObjectHost::assignClientMessageObjectsGwIds(const Signature& signature, Message& msg, TransportSocketPtr sender)
 {
   // if there's no chance of any object being in the call we're done.
@@ -98,7 +158,12 @@ void GwObjectHost::assignClientMessageObjectsGwIds(const Signature& signature, M
   {
     boost::upgrade_lock<boost::shared_mutex> lock(_mutex);
     boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
-    _objectsMetaObjects.insert(newObjectsMetaObjects.begin(), newObjectsMetaObjects.end());
+    for (std::map<GwObjectId, MetaObject>::const_iterator it = newObjectsMetaObjects.begin(),
+                                                          end = newObjectsMetaObjects.end();
+         it != end;
+         ++it)
+      if (_objectsMetaObjects.insert(*it).second)
+        cacheMethodObjects(Message::Service_Server, it->first, it->second);
     _objectsOrigin.insert(newObjectsOrigin.begin(), newObjectsOrigin.end());
     _hostObjectBank[sender].insert(newHostObjectBank.begin(), newHostObjectBank.end());
   }
@@ -151,7 +216,9 @@ void GwObjectHost::harvestServiceOriginatingObjects(Message& msg, TransportSocke
           sit->second.find(msg.object()) == sit->second.end())
       {
         boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
-        _servicesMetaObjects[msg.service()][Message::GenericObject_Main] = extractReturnedMetaObject(msg, sender);
+        MetaObject& metaObject = _servicesMetaObjects[msg.service()][Message::GenericObject_Main];
+        metaObject = extractReturnedMetaObject(msg, sender);
+        cacheMethodObjects(msg.service(), Message::GenericObject_Main, metaObject);
         return;
       }
       metaObject = &_servicesMetaObjects[msg.service()][msg.object()];
@@ -202,7 +269,13 @@ void GwObjectHost::harvestServiceOriginatingObjects(Message& msg, TransportSocke
   {
     boost::upgrade_lock<boost::shared_mutex> lock(_mutex);
     boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
-    _servicesMetaObjects[msg.service()].insert(newServicesMetaObject.begin(), newServicesMetaObject.end());
+    std::map<ObjectId, MetaObject>& serviceMetaObjects = _servicesMetaObjects[msg.service()];
+    for (std::map<ObjectId, MetaObject>::const_iterator it = newServicesMetaObject.begin(),
+                                                        end = newServicesMetaObject.end();
+         it != end;
+         ++it)
+      if (serviceMetaObjects.insert(*it).second)
+        cacheMethodObjects(msg.service(), it->first, it->second);
   }
   passed.destroy();
 }
@@ -249,6 +322,12 @@ void GwObjectHost::treatMessage(GwTransaction& t, TransportSocketPtr sender)
   qiLogDebug() << "treatMessage: " << t.content.address();
   Message& msg = t.content;
 
+  if (isPlainMessage(msg, sender))
+  {
+    qiLogDebug() << "Forwarding " << msg.address() << " as is";
+    return;
+  }
+
   if (msg.type() != Message::Type_Event)
     harvestMessageObjects(msg, sender);
 
@@ -289,7 +368,14 @@ void GwObjectHost::serviceDisconnected(ServiceId id)
 {
   boost::upgrade_lock<boost::shared_mutex> lock(_mutex);
   boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
-  _servicesMetaObjects.erase(id);
+  std::map<ServiceId, std::map<ObjectId, MetaObject> >::iterator sit = _servicesMetaObjects.find(id);
+  if (sit != _servicesMetaObjects.end())
+  {
+    for (std::map<ObjectId, MetaObject>::const_iterator it = sit->second.begin(), end = sit->second.end(); it != end;
+         ++it)
+      uncacheMethodObjects(id, it->first, it->second);
+    _servicesMetaObjects.erase(sit);
+  }
   std::map<ServiceId, std::list<GwObjectId> >::iterator findIt = _objectsUsedOnServices.find(id);
   if (findIt == _objectsUsedOnServices.end())
     return;
@@ -341,7 +427,12 @@ void GwObjectHost::clientDisconnected(TransportSocketPtr socket)
 
   for (std::vector<GwObjectId>::iterator it = allIds.begin(), end = allIds.end(); it != end; ++it)
   {
-    _objectsMetaObjects.erase(*it);
+    std::map<GwObjectId, MetaObject>::iterator mit = _objectsMetaObjects.find(*it);
+    if (mit != _objectsMetaObjects.end())
+    {
+      uncacheMethodObjects(Message::Service_Server, *it, mit->second);
+      _objectsMetaObjects.erase(mit);
+    }
     _objectsOrigin.erase(*it);
   }
   _hostObjectBank.erase(socket);
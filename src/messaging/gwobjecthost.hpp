@@ -12,8 +12,10 @@
 #include <vector>
 #include <list>
 
+#include <boost/functional/hash.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <qi/atomic.hpp>
 #include <qi/type/metaobject.hpp>
@@ -51,6 +53,34 @@ struct ObjectAddress
   }
 };
 
+// Address of a method of an object known to the gateway. Objects originating
+// from clients are addressed as {Service_Server, their GwObjectId}.
+struct MethodAddress
+{
+  ServiceId service;
+  ObjectId object;
+  unsigned int method;
+  MethodAddress(ServiceId s, ObjectId o, unsigned int m)
+    : service(s)
+    , object(o)
+    , method(m)
+  {
+  }
+  bool operator==(const MethodAddress& o) const
+  {
+    return o.service == service && o.object == object && o.method == method;
+  }
+};
+
+inline std::size_t hash_value(const MethodAddress& a)
+{
+  std::size_t seed = 0;
+  boost::hash_combine(seed, a.service);
+  boost::hash_combine(seed, a.object);
+  boost::hash_combine(seed, a.method);
+  return seed;
+}
+
 namespace qi
 {
 class MetaObject;
@@ -76,10 +106,27 @@ public:
   ObjectAddress getOriginalObjectAddress(const ObjectAddress& gwObjectAddress);
 
 private:
+  // What the signatures of a method may carry, see _methodObjects.
+  enum MethodObjects
+  {
+    MethodObjects_None = 0,
+    MethodObjects_Parameters = 1,
+    MethodObjects_Return = 2,
+  };
+  using MethodObjectsMap = boost::unordered_map<MethodAddress, unsigned char>;
+
+  bool isPlainMessage(const Message& msg, TransportSocketPtr sender);
+  void cacheMethodObjects(ServiceId service, ObjectId object, const MetaObject& metaObject);
+  void uncacheMethodObjects(ServiceId service, ObjectId object, const MetaObject& metaObject);
   void assignClientMessageObjectsGwIds(const Signature& sig, Message& msg, TransportSocketPtr sender);
 
   boost::shared_mutex _mutex;
 
+  // Whether the parameters and the return value of each method of the cached
+  // MetaObjects can hold objects, filled along with the MetaObjects. Messages
+  // for methods which can not are forwarded without looking at their payload.
+  MethodObjectsMap _methodObjects;
+
   // Objects originating from services
   // TODO OPTI: stocker une methodmap a la place du metaobject.
   // Retirer les methodes de la map quand elles sont appelees et qu'il y a pas d'object dedans.
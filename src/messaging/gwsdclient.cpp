@@ -3,6 +3,7 @@
 #include "authprovider_p.hpp"
 #include "transportsocket.hpp"
 #include "gwsdclient.hpp"
+#include "sharedmemorybuffer.hpp"
 
 qiLogCategory("qigateway.sdclient");
 
@@ -340,6 +341,8 @@ void GwSDClient::onSocketConnected(FutureSync<void> future, Promise<void> promis
     return;
   }
   _sdSocket->disconnected.connect(disconnected);
+  // The gateway forwards messages as is, see GatewayPrivate
+  _sdSocket->advertiseCapability(SharedMemoryBuffer::capabilityName, AnyValue::from(false));
   ClientAuthenticatorPtr authenticator = _authFactory->newAuthenticator();
   CapabilityMap authCaps;
   {
@@ -0,0 +1,126 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <boost/make_shared.hpp>
+
+#include <qi/log.hpp>
+#include <qi/buffer.hpp>
+
+#include <src/buffer_p.hpp>
+
+#include "messagepool.hpp"
+
+qiLogCategory("qimessaging.messagepool");
+
+namespace qi
+{
+  MessagePool::MessagePool(std::size_t maxRetainedBytes)
+    : _maxRetainedBytes(maxRetainedBytes)
+    , _hits(0)
+    , _misses(0)
+    , _dropped(0)
+    , _bytesRetained(0)
+  {
+  }
+
+  MessagePool::~MessagePool()
+  {
+    qiLogDebug() << this << " hits: " << _hits.load() << ", misses: " << _misses.load()
+                 << ", dropped: " << _dropped.load();
+  }
+
+  // Class 0 fits in the static storage of a Buffer, class n holds up to 2^(9+n) bytes.
+  int MessagePool::sizeClass(std::size_t payloadSize)
+  {
+    for (int i = 0; i < ClassCount; ++i)
+      if (payloadSize <= classCapacity(i))
+        return i;
+    return -1;
+  }
+
+  std::size_t MessagePool::classCapacity(int sizeClass)
+  {
+    if (sizeClass == 0)
+      return STATIC_BLOCK;
+    return std::size_t(1) << (9 + sizeClass);
+  }
+
+  std::size_t MessagePool::retainedSize(const MessagePrivate& p)
+  {
+    const BufferPrivate& b = *p.buffer._p;
+    return sizeof(MessagePrivate) + sizeof(BufferPrivate) + (b._bigdata ? b.available : 0);
+  }
+
+  void MessagePool::acquire(Message& msg, std::size_t payloadSize)
+  {
+    int sc = sizeClass(payloadSize);
+    if (sc < 0 || !_maxRetainedBytes)
+    {
+      ++_misses;
+      msg._p = boost::make_shared<MessagePrivate>();
+      return;
+    }
+    // Take the smallest message that fits
+    for (int i = sc; i < ClassCount; ++i)
+    {
+      if (!_free[i].empty())
+      {
+        msg._p = std::move(_free[i].back());
+        _free[i].pop_back();
+        _bytesRetained -= retainedSize(*msg._p);
+        ++_hits;
+        return;
+      }
+    }
+    ++_misses;
+    msg._p = boost::make_shared<MessagePrivate>();
+    // Allocate the whole class capacity, so that the message can be reused
+    // for any payload of this class.
+    if (sc > 0)
+    {
+      msg._p->buffer.reserve(classCapacity(sc));
+      msg._p->buffer.clear();
+    }
+  }
+
+  void MessagePool::release(Message& msg)
+  {
+    MessagePrivatePtr p;
+    p.swap(msg._p);
+    if (!p || !_maxRetainedBytes)
+      return;
+    // Someone kept the message, its payload or a slice of it, we can not reuse it
+    if (!p.unique() || !p->buffer._p.unique() || !p->buffer._p->reclaim())
+    {
+      ++_dropped;
+      return;
+    }
+    std::size_t size = retainedSize(*p);
+    if (_bytesRetained.load() + size > _maxRetainedBytes)
+    {
+      ++_dropped;
+      return;
+    }
+    const BufferPrivate& b = *p->buffer._p;
+    std::size_t available = b._bigdata ? b.available : STATIC_BLOCK;
+    int sc = ClassCount - 1;
+    while (sc > 0 && classCapacity(sc) > available)
+      --sc;
+    p->buffer.clear();
+    p->signature.clear();
+    _bytesRetained += size;
+    _free[sc].push_back(std::move(p));
+  }
+
+  MessagePool::Stats MessagePool::stats() const
+  {
+    Stats s;
+    s.hits = _hits.load();
+    s.misses = _misses.load();
+    s.dropped = _dropped.load();
+    s.bytesRetained = _bytesRetained.load();
+    return s;
+  }
+}
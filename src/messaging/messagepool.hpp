@@ -0,0 +1,75 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _SRC_MESSAGEPOOL_HPP_
+#define _SRC_MESSAGEPOOL_HPP_
+
+#include <atomic>
+#include <vector>
+
+#include "message.hpp"
+
+namespace qi
+{
+
+  /**
+  * @brief The MessagePool class recycles the storage of received messages
+  * @internal
+  *
+  * A socket acquires a message once it knows the payload size of the frame
+  * it is reading, and gives it back with release() after dispatch.
+  * Between the two calls the message holds no storage.
+  * Messages are kept by payload size class, so that a recycled message can
+  * receive its payload without reallocating its buffer.
+  *
+  * A message is only recycled if nobody else kept a reference on it, on
+  * its buffer or on a slice of its buffer during dispatch.
+  *
+  * acquire() and release() are not thread-safe: they are meant to be called
+  * from the read path of a single socket. stats() may be called from anywhere.
+  */
+  class MessagePool
+  {
+  public:
+    struct Stats
+    {
+      std::size_t hits;          // acquire() served from the pool
+      std::size_t misses;        // acquire() had to allocate
+      std::size_t dropped;       // release() could not keep the message
+      std::size_t bytesRetained; // memory currently held by the pool
+    };
+
+    /// @param maxRetainedBytes upper bound of the memory kept by the pool, 0 disables pooling
+    explicit MessagePool(std::size_t maxRetainedBytes);
+    ~MessagePool();
+
+    /// Set msg to a message whose buffer can receive payloadSize bytes without reallocating.
+    void acquire(Message& msg, std::size_t payloadSize);
+    /// Give back a message after dispatch. msg is left empty.
+    void release(Message& msg);
+
+    Stats stats() const;
+
+  private:
+    using MessagePrivatePtr = boost::shared_ptr<MessagePrivate>;
+
+    static const int ClassCount = 12;
+    static int sizeClass(std::size_t payloadSize);
+    static std::size_t classCapacity(int sizeClass);
+    static std::size_t retainedSize(const MessagePrivate& p);
+
+    std::vector<MessagePrivatePtr> _free[ClassCount];
+    std::size_t _maxRetainedBytes;
+
+    std::atomic<std::size_t> _hits;
+    std::atomic<std::size_t> _misses;
+    std::atomic<std::size_t> _dropped;
+    std::atomic<std::size_t> _bytesRetained;
+  };
+
+}
+
+#endif  // _SRC_MESSAGEPOOL_HPP_
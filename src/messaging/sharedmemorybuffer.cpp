@@ -0,0 +1,199 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <qi/buffer.hpp>
+#include <qi/clock.hpp>
+#include <qi/getenv.hpp>
+#include <qi/log.hpp>
+#include <qi/os.hpp>
+
+#include <src/buffer_p.hpp>
+
+#include "sharedmemorybuffer.hpp"
+
+#if !defined(_WIN32) && !defined(ANDROID)
+# define QI_HAS_SHARED_MEMORY_BUFFER
+# include <cerrno>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+qiLogCategory("qimessaging.sharedmemorybuffer");
+
+namespace qi
+{
+  const char* const SharedMemoryBuffer::capabilityName = "SharedMemoryBuffers";
+
+  std::size_t SharedMemoryBuffer::threshold()
+  {
+    static const std::size_t result = qi::os::getEnvDefault<std::size_t>("QI_SHARED_MEMORY_BUFFER_THRESHOLD", 0);
+    return result;
+  }
+
+#ifdef QI_HAS_SHARED_MEMORY_BUFFER
+
+  namespace
+  {
+    const char* const segmentPrefix = "/qi-shm-";
+
+    // Time given to a peer to map a segment before the sender unlinks it
+    const qi::Seconds segmentLifetime(30);
+
+    /* Segments exported by this process and maybe not yet mapped by the
+     * receiver. Unlinking a segment the receiver already unlinked is harmless,
+     * and a mapped segment remains valid after being unlinked.
+     */
+    class ExportedSegments
+    {
+    public:
+      ~ExportedSegments()
+      {
+        for (const Segment& s : _segments)
+          ::shm_unlink(s.name.c_str());
+      }
+
+      void add(const std::string& name)
+      {
+        const qi::SteadyClock::time_point now = qi::SteadyClock::now();
+        boost::mutex::scoped_lock lock(_mutex);
+        while (!_segments.empty() && now - _segments.front().created > segmentLifetime)
+        {
+          ::shm_unlink(_segments.front().name.c_str());
+          _segments.pop_front();
+        }
+        Segment s = { name, now };
+        _segments.push_back(s);
+      }
+
+    private:
+      struct Segment
+      {
+        std::string name;
+        qi::SteadyClock::time_point created;
+      };
+      boost::mutex _mutex;
+      std::deque<Segment> _segments;
+    };
+
+    ExportedSegments& exportedSegments()
+    {
+      static ExportedSegments segments;
+      return segments;
+    }
+
+    void unmapSegment(unsigned char* data, std::size_t size)
+    {
+      ::munmap(data, size);
+    }
+
+    std::runtime_error importError(const std::string& name, const std::string& what)
+    {
+      std::stringstream err;
+      err << "Cannot map shared memory buffer " << name << ": " << what;
+      return std::runtime_error(err.str());
+    }
+  }
+
+  bool SharedMemoryBuffer::enabled()
+  {
+    return threshold() != 0;
+  }
+
+  std::string SharedMemoryBuffer::exportBuffer(const Buffer& buffer)
+  {
+    static std::atomic<unsigned int> counter(0);
+    const std::size_t size = buffer.size();
+    if (!size)
+      return std::string();
+
+    const std::string name = segmentPrefix + boost::lexical_cast<std::string>(qi::os::getpid())
+        + "-" + boost::lexical_cast<std::string>(++counter);
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+      qiLogVerbose() << "shm_open(" << name << ") failed: " << strerror(errno);
+      return std::string();
+    }
+    void* data = MAP_FAILED;
+    if (::ftruncate(fd, size) == 0)
+      data = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+      qiLogVerbose() << "Cannot allocate shared memory segment of " << size << " bytes: " << strerror(errno);
+      ::shm_unlink(name.c_str());
+      return std::string();
+    }
+    memcpy(data, buffer.data(), size);
+    ::munmap(data, size);
+
+    exportedSegments().add(name);
+    qiLogDebug() << "Exported " << size << " bytes in " << name;
+    return name;
+  }
+
+  Buffer SharedMemoryBuffer::importBuffer(const std::string& name, std::size_t size)
+  {
+    // Only open segments created by exportBuffer
+    if (name.compare(0, strlen(segmentPrefix), segmentPrefix) != 0
+        || name.find('/', 1) != std::string::npos)
+      throw importError(name, "invalid segment name");
+    if (!size)
+      return Buffer();
+
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      throw importError(name, strerror(errno));
+    // The sender does not need it anymore, only our mapping keeps it alive.
+    ::shm_unlink(name.c_str());
+
+    struct ::stat st;
+    if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < size)
+    {
+      ::close(fd);
+      throw importError(name, "segment is too small");
+    }
+    // A private writable mapping, so that the buffer can be modified without
+    // affecting the segment.
+    void* data = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+      throw importError(name, strerror(errno));
+
+    Buffer result;
+    result._p->adopt(static_cast<unsigned char*>(data), size, &unmapSegment);
+    return result;
+  }
+
+#else
+
+  bool SharedMemoryBuffer::enabled()
+  {
+    return false;
+  }
+
+  std::string SharedMemoryBuffer::exportBuffer(const Buffer&)
+  {
+    return std::string();
+  }
+
+  Buffer SharedMemoryBuffer::importBuffer(const std::string& name, std::size_t)
+  {
+    throw std::runtime_error("Cannot map shared memory buffer " + name + ": not supported on this platform");
+  }
+
+#endif
+}
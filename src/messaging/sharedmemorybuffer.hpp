@@ -0,0 +1,51 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _SRC_SHAREDMEMORYBUFFER_HPP_
+#define _SRC_SHAREDMEMORYBUFFER_HPP_
+
+#include <string>
+
+#include <qi/buffer.hpp>
+
+namespace qi
+{
+
+  /**
+  * @brief Exchange large raw buffers between local peers through shared memory
+  * @internal
+  *
+  * The sender copies the buffer in a new shared memory segment and only
+  * serializes the segment name. The receiver maps the segment and unlinks it,
+  * the resulting Buffer reads the mapping directly and unmaps it on destruction.
+  *
+  * This is enabled by setting QI_SHARED_MEMORY_BUFFER_THRESHOLD to the minimum
+  * size in bytes of the buffers to send this way, and is only used with peers
+  * that advertised the capability named capabilityName, which local socket
+  * transports do when this is enabled.
+  *
+  * A segment that was never mapped, because the message was lost or never
+  * decoded, is unlinked by the sender after a while or when it exits.
+  */
+  class SharedMemoryBuffer
+  {
+  public:
+    static const char* const capabilityName;
+
+    /// Whether this process sends buffers through shared memory.
+    static bool enabled();
+    /// Minimum size of the buffers sent through shared memory.
+    static std::size_t threshold();
+
+    /// Copy buffer in a new segment. Return the segment name, or an empty string on failure.
+    static std::string exportBuffer(const Buffer& buffer);
+    /// Map the segment exported by a peer. Throw std::runtime_error on failure.
+    static Buffer importBuffer(const std::string& name, std::size_t size);
+  };
+
+}
+
+#endif  // _SRC_SHAREDMEMORYBUFFER_HPP_
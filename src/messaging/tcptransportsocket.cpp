@@ -22,9 +22,11 @@
 #include <boost/make_shared.hpp>
 
 #include "tcptransportsocket.hpp"
+#include "sharedmemorybuffer.hpp"
 
 #include <qi/log.hpp>
 #include <qi/os.hpp>
+#include <qi/getenv.hpp>
 
 qiLogCategory("qimessaging.transportsocket");
 
@@ -63,17 +65,28 @@ namespace qi
     , _sslHandshake(false)
     , _sslContext(boost::asio::ssl::context::sslv23)
     , _abort(false)
-    , _msg(0)
+    , _readBuffer(qi::os::getEnvDefault<std::size_t>("QI_TCP_READ_BUFFER_SIZE", 16384))
+    , _readBegin(0)
+    , _readEnd(0)
+    , _messagePool(qi::os::getEnvDefault<std::size_t>("QI_MESSAGE_POOL_MAX_BYTES", 262144))
     , _connecting(false)
     , _sending(false)
+    // Setting QI_TCP_SEND_BATCH_MAX_MESSAGES to 1 restores one write per message
+    , _sendBatchMaxMessages(std::max(1u, qi::os::getEnvDefault("QI_TCP_SEND_BATCH_MAX_MESSAGES", 64u)))
+    , _sendBatchMaxBytes(qi::os::getEnvDefault<std::size_t>("QI_TCP_SEND_BATCH_MAX_BYTES", 65536))
   {
     _eventLoop = eventLoop;
     _err = 0;
     _status = qi::TransportSocket::Status::Disconnected;
 
+    // The read buffer must at least hold a header and a small payload.
+    // Setting QI_TCP_READ_BUFFER_SIZE to 0 reads each header and payload separately.
+    if (!_readBuffer.empty() && _readBuffer.size() < 1024)
+      _readBuffer.resize(1024);
+
     if (s != 0)
     {
-      _socket = SocketPtr((boost::asio::ssl::stream<boost::asio::ip::tcp::socket>*) s);
+      _socket = SocketPtr((Stream*) s);
       _status = qi::TransportSocket::Status::Connected;
       // Transmit each Message without delay
       setSocketOptions();
@@ -86,7 +99,6 @@ namespace qi
   {
     qiLogDebug() << this;
     error("Destroying TcpTransportSocket");
-    delete _msg;
     qiLogVerbose() << "deleted " << this;
   }
 
@@ -99,7 +111,6 @@ namespace qi
   {
     qiLogDebug() << this;
 
-    _msg = new qi::Message();
     boost::recursive_mutex::scoped_lock l(_closingMutex);
 
     if (_abort)
@@ -108,25 +119,141 @@ namespace qi
       return;
     }
 
+    if (_ssl && !_sslHandshake)
+    {
+      qi::Promise<void> prom;
+      _socket->async_handshake(boost::asio::ssl::stream_base::server,
+        boost::bind(&TcpTransportSocket::handshake, shared_from_this(), _1, _socket, prom));
+      return;
+    }
+
+    if (!_readBuffer.empty())
+    {
+      // Do not keep the lock while we dispatch buffered messages
+      l.unlock();
+      processReadBuffer();
+      return;
+    }
+
     if (_ssl)
     {
-      if (!_sslHandshake)
+      boost::asio::async_read(*_socket,
+        boost::asio::buffer(&_header, sizeof(MessagePrivate::MessageHeader)),
+        boost::bind(&TcpTransportSocket::onReadHeader, shared_from_this(), _1, _2, _socket));
+    }
+    else
+    {
+      boost::asio::async_read(_socket->next_layer(),
+        boost::asio::buffer(&_header, sizeof(MessagePrivate::MessageHeader)),
+        boost::bind(&TcpTransportSocket::onReadHeader, shared_from_this(), _1, _2, _socket));
+    }
+  }
+
+  /*
+   * Parse and dispatch all complete messages present in the read buffer,
+   * then read more data.
+   * A payload too big to fit in the read buffer is read straight into
+   * the message buffer instead.
+   */
+  void TcpTransportSocket::processReadBuffer()
+  {
+    static const std::size_t headerSize = sizeof(MessagePrivate::MessageHeader);
+    while (!_abort)
+    {
+      std::size_t available = _readEnd - _readBegin;
+      if (available < headerSize)
+        break;
+      memcpy(&_header, &_readBuffer[_readBegin], headerSize);
+      if (!checkHeader())
+        return;
+      std::size_t payload = _header.size;
+      available -= headerSize;
+      if (payload > available && payload <= _readBuffer.size() / 2)
+        break; // wait for the rest of this message in the read buffer
+
+      _messagePool.acquire(_msg, payload);
+      _msg._p->header = _header;
+      _readBegin += headerSize;
+      if (payload > available)
       {
-        qi::Promise<void> prom;
-        _socket->async_handshake(boost::asio::ssl::stream_base::server,
-          boost::bind(&TcpTransportSocket::handshake, shared_from_this(), _1, _socket, prom));
+        char* ptr = static_cast<char*>(_msg._p->buffer.reserve(payload));
+        memcpy(ptr, &_readBuffer[_readBegin], available);
+        _readBegin = _readEnd = 0;
+        readPayload(ptr + available, payload - available);
         return;
       }
+      if (payload)
+        memcpy(_msg._p->buffer.reserve(payload), &_readBuffer[_readBegin], payload);
+      _readBegin += payload;
+      if (!dispatchMessage())
+        return;
+    }
+    if (_abort)
+      return;
+
+    // Move the beginning of the next message at the front of the buffer
+    if (_readBegin)
+    {
+      memmove(&_readBuffer[0], &_readBuffer[_readBegin], _readEnd - _readBegin);
+      _readEnd -= _readBegin;
+      _readBegin = 0;
+    }
+
+    boost::recursive_mutex::scoped_lock l(_closingMutex);
+
+    if (_abort)
+    {
+      error("Aborted");
+      return;
+    }
+
+    boost::asio::mutable_buffers_1 b =
+      boost::asio::buffer(&_readBuffer[_readEnd], _readBuffer.size() - _readEnd);
+    if (_ssl)
+    {
+      _socket->async_read_some(b,
+        boost::bind(&TcpTransportSocket::onReadSome, shared_from_this(), _1, _2, _socket));
+    }
+    else
+    {
+      _socket->next_layer().async_read_some(b,
+        boost::bind(&TcpTransportSocket::onReadSome, shared_from_this(), _1, _2, _socket));
+    }
+  }
+
+  void TcpTransportSocket::onReadSome(const boost::system::error_code& erc,
+    std::size_t len, SocketPtr)
+  {
+    if (erc)
+    {
+      error("System error: " + erc.message());
+      return;
+    }
+    _readEnd += len;
+    processReadBuffer();
+  }
 
+  void TcpTransportSocket::readPayload(void* ptr, std::size_t size)
+  {
+    boost::recursive_mutex::scoped_lock l(_closingMutex);
+
+    if (_abort)
+    {
+      error("Aborted");
+      return;
+    }
+
+    if (_ssl)
+    {
       boost::asio::async_read(*_socket,
-        boost::asio::buffer(_msg->_p->getHeader(), sizeof(MessagePrivate::MessageHeader)),
-        boost::bind(&TcpTransportSocket::onReadHeader, shared_from_this(), _1, _2, _socket));
+        boost::asio::buffer(ptr, size),
+        boost::bind(&TcpTransportSocket::onReadData, shared_from_this(), _1, _2, _socket));
     }
     else
     {
       boost::asio::async_read(_socket->next_layer(),
-        boost::asio::buffer(_msg->_p->getHeader(), sizeof(MessagePrivate::MessageHeader)),
-        boost::bind(&TcpTransportSocket::onReadHeader, shared_from_this(), _1, _2, _socket));
+        boost::asio::buffer(ptr, size),
+        boost::bind(&TcpTransportSocket::onReadData, shared_from_this(), _1, _2, _socket));
     }
   }
 
@@ -135,10 +262,31 @@ namespace qi
     boost::recursive_mutex::scoped_lock lock(_closingMutex);
     if (!_socket)
       return qi::Url();
-    return qi::Url(
-      _socket->lowest_layer().remote_endpoint().address().to_string(),
-      "tcp",
-      _socket->lowest_layer().remote_endpoint().port());
+    // Convert the generic endpoint back to its actual family
+    boost::asio::generic::stream_protocol::endpoint ep = _socket->lowest_layer().remote_endpoint();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (ep.protocol().family() == AF_UNIX)
+    {
+      boost::asio::local::stream_protocol::endpoint lep;
+      memcpy(lep.data(), ep.data(), ep.size());
+      lep.resize(ep.size());
+      return qi::Url("unix://" + lep.path());
+    }
+#endif
+    boost::asio::ip::tcp::endpoint tep;
+    memcpy(tep.data(), ep.data(), ep.size());
+    tep.resize(ep.size());
+    return qi::Url(tep.address().to_string(), "tcp", tep.port());
+  }
+
+  bool TcpTransportSocket::isLocalSocket() const
+  {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    boost::system::error_code ec;
+    return _socket->lowest_layer().local_endpoint(ec).protocol().family() == AF_UNIX;
+#else
+    return false;
+#endif
   }
 
   void TcpTransportSocket::onReadHeader(const boost::system::error_code& erc,
@@ -155,20 +303,35 @@ namespace qi
       _continueReading();
       return;
     }
-    assert(len == sizeof(_msg->_p->header));
+    assert(len == sizeof(_header));
+    if (!checkHeader())
+      return;
+
+    size_t payload = _header.size;
+    _messagePool.acquire(_msg, payload);
+    _msg._p->header = _header;
+
+    if (payload)
+      readPayload(_msg._p->buffer.reserve(payload), payload);
+    else
+      onReadData(boost::system::error_code(), 0, _socket);
+  }
+
+  bool TcpTransportSocket::checkHeader()
+  {
     // check magic
-    if (_msg->_p->header.magic != MessagePrivate::magic)
+    if (_header.magic != MessagePrivate::magic)
     {
       qiLogWarning() << "Incorrect magic from "
-        << _socket->lowest_layer().remote_endpoint().address().to_string()
+        << remoteEndpoint().str()
         << ", disconnecting"
            " (expected " << MessagePrivate::magic
-        << ", got " << _msg->_p->header.magic << ").";
+        << ", got " << _header.magic << ").";
       error("Protocol error");
-      return;
+      return false;
     }
 
-    size_t payload = _msg->_p->header.size;
+    size_t payload = _header.size;
     if (payload)
     {
       static size_t maxPayload = 0;
@@ -190,61 +353,44 @@ namespace qi
           << " above maximum configured payload " << maxPayload << ", closing link."
              " (configure with environment variable QI_MAX_MESSAGE_PAYLOAD)";
         error("Message too big");
-        return;
-      }
-
-      void* ptr = _msg->_p->buffer.reserve(payload);
-
-      boost::recursive_mutex::scoped_lock l(_closingMutex);
-
-      if (_abort)
-      {
-        error("Aborted");
-        return;
-      }
-
-      if (_ssl)
-      {
-        boost::asio::async_read(*_socket,
-          boost::asio::buffer(ptr, payload),
-          boost::bind(&TcpTransportSocket::onReadData, shared_from_this(), _1, _2, _socket));
-      }
-      else
-      {
-        boost::asio::async_read(_socket->next_layer(),
-          boost::asio::buffer(ptr, payload),
-          boost::bind(&TcpTransportSocket::onReadData, shared_from_this(), _1, _2, _socket));
+        return false;
       }
     }
-    else
-      onReadData(boost::system::error_code(), 0, _socket);
+
+    return true;
   }
 
   void TcpTransportSocket::onReadData(const boost::system::error_code& erc,
-    std::size_t len, SocketPtr)
+    std::size_t, SocketPtr)
   {
     if (erc)
     {
       error("System error: " + erc.message());
       return;
     }
-    qiLogDebug() << this << " Recv (" << _msg->type() << "):" << _msg->address();
+    if (dispatchMessage())
+      _continueReading();
+  }
+
+  bool TcpTransportSocket::dispatchMessage()
+  {
+    qiLogDebug() << this << " Recv (" << _msg.type() << "):" << _msg.address();
     static int usWarnThreshold = os::getenv("QIMESSAGING_SOCKET_DISPATCH_TIME_WARN_THRESHOLD").empty()?0:strtol(os::getenv("QIMESSAGING_SOCKET_DISPATCH_TIME_WARN_THRESHOLD").c_str(),0,0);
     qi::int64_t start = 0;
     if (usWarnThreshold)
       start = os::ustime(); // call might be not that cheap
     if ((!hasReceivedRemoteCapabilities() &&
-          _msg->service() == Message::Service_Server &&
-          _msg->function() == Message::ServerFunction_Authenticate)
-        || _msg->type() == Message::Type_Capability)
+          _msg.service() == Message::Service_Server &&
+          _msg.function() == Message::ServerFunction_Authenticate)
+        || _msg.type() == Message::Type_Capability)
     {
       // This one is for us
-      if (_msg->type() != Message::Type_Error)
+      if (_msg.type() != Message::Type_Error)
       {
         AnyReference cmRef;
         try
         {
-          cmRef = _msg->value(typeOf<CapabilityMap>()->signature(), shared_from_this());
+          cmRef = _msg.value(typeOf<CapabilityMap>()->signature(), shared_from_this());
           CapabilityMap cm = cmRef.to<CapabilityMap>();
           cmRef.destroy();
           boost::mutex::scoped_lock lock(_contextMutex);
@@ -254,21 +400,22 @@ namespace qi
         {
           cmRef.destroy();
           qiLogError() << "Ill-formed capabilities message: " << e.what();
-          return error("Ill-formed capabilities message.");
+          error("Ill-formed capabilities message.");
+          return false;
         }
       }
-      if (_msg->type() != Message::Type_Capability)
+      if (_msg.type() != Message::Type_Capability)
       {
-        messageReady(*_msg);
-        socketEvent(SocketEventData(*_msg));
-        _dispatcher.dispatch(*_msg);
+        messageReady(_msg);
+        socketEvent(SocketEventData(_msg));
+        _dispatcher.dispatch(_msg);
       }
     }
     else
     {
-      messageReady(*_msg);
-      socketEvent(SocketEventData(*_msg));
-      _dispatcher.dispatch(*_msg);
+      messageReady(_msg);
+      socketEvent(SocketEventData(_msg));
+      _dispatcher.dispatch(_msg);
     }
     if (usWarnThreshold)
     {
@@ -276,9 +423,8 @@ namespace qi
       if (duration > usWarnThreshold)
         qiLogWarning() << "Dispatch to user took " << duration << "us";
     }
-    delete _msg;
-    _msg = 0;
-    _continueReading();
+    _messagePool.release(_msg);
+    return true;
   }
 
   void TcpTransportSocket::error(const std::string& erc)
@@ -307,7 +453,7 @@ namespace qi
         if (_socket)
         {
           // Unconditionally try to shutdown if socket is present, it might be in connecting state.
-          _socket->lowest_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both, er);
+          _socket->lowest_layer().shutdown(boost::asio::socket_base::shutdown_both, er);
           _socket->lowest_layer().close(er);
         }
       }
@@ -333,11 +479,26 @@ namespace qi
     {
       _sslContext.set_verify_mode(boost::asio::ssl::verify_none);
     }
-    _socket = SocketPtr(new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>((*(boost::asio::io_service*)_eventLoop->nativeHandle()), _sslContext));
+    _socket = SocketPtr(new Stream((*(boost::asio::io_service*)_eventLoop->nativeHandle()), _sslContext));
     _url = url;
     _status = qi::TransportSocket::Status::Connecting;
     _connecting = true;
     _err = 0;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (_url.protocol() == "unix")
+    {
+      // No resolution for local sockets, the host is the socket path
+      qiLogVerbose() << "Trying to connect to " << _url.host();
+      qi::Promise<void> connectPromise;
+      _socket->lowest_layer().async_connect(boost::asio::local::stream_protocol::endpoint(_url.host()),
+                                            boost::bind(&TcpTransportSocket::onConnected,
+                                                        shared_from_this(),
+                                                        boost::asio::placeholders::error,
+                                                        _socket,
+                                                        connectPromise));
+      return connectPromise.future();
+    }
+#endif
     if (_url.port() == 0) {
       qiLogError() << "Error try to connect to a bad address: " << _url.str();
 
@@ -405,7 +566,7 @@ namespace qi
 
 
     // asynchronous connect
-    _socket->lowest_layer().async_connect(*it,
+    _socket->lowest_layer().async_connect(it->endpoint(),
                                           boost::bind(&TcpTransportSocket::onConnected,
                                                       shared_from_this(),
                                                       boost::asio::placeholders::error,
@@ -497,6 +658,14 @@ namespace qi
 
   void TcpTransportSocket::setSocketOptions()
   {
+    if (isLocalSocket())
+    {
+      // Large buffers can be exchanged through shared memory with local peers
+      if (SharedMemoryBuffer::enabled())
+        advertiseCapability(SharedMemoryBuffer::capabilityName, AnyValue::from(true));
+      // Below options only make sense for TCP
+      return;
+    }
     // Transmit each Message without delay
     const boost::asio::ip::tcp::no_delay option( true );
     try {
@@ -622,17 +791,22 @@ namespace qi
     if (!_sending)
     {
       _sending = true;
-      send_(msg);
+      send_(boost::make_shared<MessageBatch>(1, msg));
     }
     else
       _sendQueue.push_back(msg);
     return true;
   }
 
-  void TcpTransportSocket::send_(qi::Message msg)
+  std::size_t TcpTransportSocket::sendQueueSize()
+  {
+    boost::mutex::scoped_lock lock(_sendQueueMutex);
+    return _sendQueue.size();
+  }
+
+  static void appendMessageBuffers(std::vector<boost::asio::const_buffer>& b, qi::Message& msg)
   {
     using boost::asio::buffer;
-    std::vector<boost::asio::const_buffer> b;
     msg._p->complete();
     // Send header
     b.push_back(buffer(msg._p->getHeader(), sizeof(qi::MessagePrivate::MessageHeader)));
@@ -652,6 +826,14 @@ namespace qi
       b.push_back(buffer(subs[i].second.data(), subs[i].second.size()));
     }
     b.push_back(buffer((const char*)buf.data() + pos, sz - pos));
+  }
+
+  void TcpTransportSocket::send_(MessageBatchPtr batch)
+  {
+    // Gather all queued messages in a single write
+    std::vector<boost::asio::const_buffer> b;
+    for (unsigned i = 0; i < batch->size(); ++i)
+      appendMessageBuffers(b, (*batch)[i]);
 
     boost::recursive_mutex::scoped_lock l(_closingMutex);
 
@@ -661,31 +843,55 @@ namespace qi
       return;
     }
 
-    _dispatcher.sent(msg);
+    for (unsigned i = 0; i < batch->size(); ++i)
+      _dispatcher.sent((*batch)[i]);
 
     if (_ssl)
     {
       boost::asio::async_write(*_socket, b,
-        boost::bind(&TcpTransportSocket::sendCont, shared_from_this(), _1, msg, _socket));
+        boost::bind(&TcpTransportSocket::sendCont, shared_from_this(), _1, batch, _socket));
     }
     else
     {
       boost::asio::async_write(_socket->next_layer(), b,
-        boost::bind(&TcpTransportSocket::sendCont, shared_from_this(), _1, msg, _socket));
+        boost::bind(&TcpTransportSocket::sendCont, shared_from_this(), _1, batch, _socket));
     }
   }
 
   /*
-   * warning: msg is given to the callback so as not to drop buffers refcount
+   * Take as many queued messages as allowed by the batch bounds.
+   * The first message is always taken, even if it is bigger than
+   * _sendBatchMaxBytes.
+   * Must be called with _sendQueueMutex locked.
    */
-  void TcpTransportSocket::sendCont(const boost::system::error_code& erc, qi::Message msg, SocketPtr)
+  TcpTransportSocket::MessageBatchPtr TcpTransportSocket::popSendBatch()
+  {
+    MessageBatchPtr batch = boost::make_shared<MessageBatch>();
+    std::size_t bytes = 0;
+    while (!_sendQueue.empty() && batch->size() < _sendBatchMaxMessages)
+    {
+      const Message& m = _sendQueue.front();
+      std::size_t sz = sizeof(MessagePrivate::MessageHeader) + m.buffer().totalSize();
+      if (!batch->empty() && bytes + sz > _sendBatchMaxBytes)
+        break;
+      bytes += sz;
+      batch->push_back(m);
+      _sendQueue.pop_front();
+    }
+    return batch;
+  }
+
+  /*
+   * warning: batch is given to the callback so as not to drop buffers refcount
+   */
+  void TcpTransportSocket::sendCont(const boost::system::error_code& erc, MessageBatchPtr, SocketPtr)
   {
     // The class does not wait for us to terminate, but it will set abort to true.
     // So do not use this before checking abort.
     if (erc || _abort)
       return; // read-callback will also get the error, avoid dup and ignore it
 
-    qi::Message m;
+    MessageBatchPtr batch;
     {
       boost::mutex::scoped_lock lock(_sendQueueMutex);
       if (_sendQueue.empty())
@@ -694,11 +900,10 @@ namespace qi
         return;
       }
 
-      m = _sendQueue.front();
-      _sendQueue.pop_front();
+      batch = popSendBatch();
     }
 
-    send_(m);
+    send_(batch);
   }
 
 }
@@ -19,22 +19,36 @@
 # include "transportsocket.hpp"
 # include <qi/eventloop.hpp>
 # include "messagedispatcher.hpp"
+# include "messagepool.hpp"
 
 namespace qi
 {
+  /**
+   * Transport over a stream socket: tcp://, tcps:// (TCP over SSL), and
+   * unix:// (local socket) where the platform supports it.
+   */
   class TcpTransportSocket : public TransportSocket, public boost::enable_shared_from_this<TcpTransportSocket>
   {
   public:
+    /// The underlying socket is generic so that it can be of any family
+    using Stream = boost::asio::ssl::stream<boost::asio::generic::stream_protocol::socket>;
+
     explicit TcpTransportSocket(EventLoop* eventloop = getEventLoop(), bool ssl = false, void* s = 0);
     virtual ~TcpTransportSocket();
 
     virtual qi::FutureSync<void> connect(const qi::Url &url);
     virtual qi::FutureSync<void> disconnect();
     virtual bool send(const qi::Message &msg);
+    virtual std::size_t sendQueueSize();
     virtual void startReading();
     virtual qi::Url remoteEndpoint() const;
+
+    /// Pool recycling incoming messages, for statistics
+    const MessagePool& messagePool() const { return _messagePool; }
   private:
-    using SocketPtr = boost::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>;
+    using SocketPtr = boost::shared_ptr<Stream>;
+    using MessageBatch = std::vector<Message>;
+    using MessageBatchPtr = boost::shared_ptr<MessageBatch>;
     void error(const std::string& erc);
     void onResolved(const boost::system::error_code& erc,
                     boost::asio::ip::tcp::resolver::iterator it,
@@ -45,9 +59,16 @@ namespace qi
                     qi::Promise<void> connectPromise);
     void onReadHeader(const boost::system::error_code& erc, std::size_t, SocketPtr s);
     void onReadData(const boost::system::error_code& erc, std::size_t, SocketPtr s);
-    void send_(qi::Message msg);
-    void sendCont(const boost::system::error_code& erc, qi::Message msg, SocketPtr s);
+    void onReadSome(const boost::system::error_code& erc, std::size_t, SocketPtr s);
+    void processReadBuffer();
+    void readPayload(void* ptr, std::size_t size);
+    bool checkHeader();
+    bool dispatchMessage();
+    void send_(MessageBatchPtr batch);
+    void sendCont(const boost::system::error_code& erc, MessageBatchPtr batch, SocketPtr s);
+    MessageBatchPtr popSendBatch();
     void setSocketOptions();
+    bool isLocalSocket() const;
     void _continueReading();
     bool _ssl;
     bool _sslHandshake;
@@ -57,12 +78,23 @@ namespace qi
     bool                _abort; // used to notify send callback sendCont that we are dead
 
     // data to rebuild message
-    qi::Message        *_msg;
+    // When _readBuffer is not empty, messages are parsed from it, with
+    // unparsed data in [_readBegin, _readEnd). Otherwise the header and
+    // the payload of each message are read separately.
+    std::vector<char>   _readBuffer;
+    std::size_t         _readBegin;
+    std::size_t         _readEnd;
+    MessagePrivate::MessageHeader _header;
+    qi::Message         _msg;
+    MessagePool         _messagePool;
     bool                _connecting;
 
     boost::mutex        _sendQueueMutex; // protects _sendQueue, _sending and closing
     std::deque<Message> _sendQueue;
     bool                _sending;
+    // bounds of a single gathered write, see popSendBatch()
+    unsigned int        _sendBatchMaxMessages;
+    std::size_t         _sendBatchMaxBytes;
     mutable boost::recursive_mutex        _closingMutex;
     boost::shared_ptr<boost::asio::ip::tcp::resolver> _r;
 
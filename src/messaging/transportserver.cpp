@@ -27,6 +27,7 @@
 #include "transportserver.hpp"
 #include "transportsocket.hpp"
 #include "transportserverasio_p.hpp"
+#include "transportserverunix_p.hpp"
 
 qiLogCategory("qimessaging.transportserver");
 
@@ -53,6 +54,12 @@ namespace qi
     {
       impl = new TransportServerAsioPrivate(this, ctx);
     }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    else if (url.protocol() == "unix")
+    {
+      impl = new TransportServerUnixPrivate(this, ctx);
+    }
+#endif
     else
     {
       const char* s = "Unrecognized protocol to create the TransportServer.";
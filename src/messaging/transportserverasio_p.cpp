@@ -30,7 +30,7 @@ namespace qi
 
   void _onAccept(TransportServerImplPtr p,
                  const boost::system::error_code& erc,
-                 boost::asio::ssl::stream<boost::asio::ip::tcp::socket>* s
+                 TcpTransportSocket::Stream* s
                  )
   {
     boost::shared_ptr<TransportServerAsioPrivate> ts = boost::dynamic_pointer_cast<TransportServerAsioPrivate>(p);
@@ -54,7 +54,7 @@ namespace qi
   }
 
   void TransportServerAsioPrivate::onAccept(const boost::system::error_code& erc,
-    boost::asio::ssl::stream<boost::asio::ip::tcp::socket>* s
+    TcpTransportSocket::Stream* s
     )
   {
     qiLogDebug() << this << " onAccept";
@@ -78,9 +78,18 @@ namespace qi
             qi::MicroSeconds(AcceptDownRetryTimerUs));
         return;
       }
+      // errors such as running out of file descriptors last a while, do not
+      // spin on them
+      _acceptRetryDelay = nextAcceptRetryDelay(_acceptRetryDelay);
+      qiLogDebug() << this << " Accepting again in " << qi::to_string(_acceptRetryDelay);
+      context->asyncDelay(boost::bind(&TransportServerAsioPrivate::accept,
+                                      boost::static_pointer_cast<TransportServerAsioPrivate>(shared_from_this())),
+                          _acceptRetryDelay);
+      return;
     }
     else
     {
+        _acceptRetryDelay = qi::Duration(0);
         qi::TransportSocketPtr socket = qi::TcpTransportSocketPtr(new TcpTransportSocket(context, _ssl, s));
         self->newConnection(socket);
 
@@ -88,7 +97,14 @@ namespace qi
             qiLogError() << "bug: socket not stored by the newConnection handler (usecount:" << socket.use_count() << ")";
         }
     }
-    _s = new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(_acceptor->get_io_service(), _sslContext);
+    accept();
+  }
+
+  void TransportServerAsioPrivate::accept()
+  {
+    if (!_live || !_acceptor)
+      return;
+    _s = new TcpTransportSocket::Stream(_acceptor->get_io_service(), _sslContext);
     _acceptor->async_accept(_s->lowest_layer(),
                            boost::bind(_onAccept, shared_from_this(), _1, _s));
   }
@@ -274,7 +290,7 @@ namespace qi
       _sslContext.use_private_key_file(self->_identityKey.c_str(), boost::asio::ssl::context::pem);
     }
 
-    _s = new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(_acceptor->get_io_service(), _sslContext);
+    _s = new TcpTransportSocket::Stream(_acceptor->get_io_service(), _sslContext);
     _acceptor->async_accept(_s->lowest_layer(),
       boost::bind(_onAccept, shared_from_this(), _1, _s));
     _connectionPromise.setValue(0);
@@ -302,6 +318,13 @@ namespace qi
     return false;
   }
 
+  qi::Duration TransportServerAsioPrivate::nextAcceptRetryDelay(qi::Duration previous)
+  {
+    if (previous <= qi::Duration(0))
+      return qi::MilliSeconds(10);
+    return std::min<qi::Duration>(previous * 2, qi::Seconds(1));
+  }
+
   TransportServerAsioPrivate::TransportServerAsioPrivate(TransportServer* self,
                                                                  EventLoop* ctx)
     : TransportServerImpl(self, ctx)
@@ -312,6 +335,7 @@ namespace qi
     , _s(NULL)
     , _ssl(false)
     , _port(0)
+    , _acceptRetryDelay(0)
   {
   }
 
@@ -13,6 +13,7 @@
 # include <qi/api.hpp>
 # include <qi/url.hpp>
 # include "transportserver.hpp"
+# include "tcptransportsocket.hpp"
 
 namespace qi
 {
@@ -27,23 +28,28 @@ namespace qi
     virtual void close();
     void updateEndpoints();
     static bool isFatalAcceptError(int errorCode);
+    /// Delay before accepting again after an other error, growing with each one
+    static qi::Duration nextAcceptRetryDelay(qi::Duration previous);
     TransportServer* _self;
     boost::asio::ip::tcp::acceptor* _acceptor;
     void onAccept(const boost::system::error_code& erc,
-      boost::asio::ssl::stream<boost::asio::ip::tcp::socket>* s
+      TcpTransportSocket::Stream* s
       );
     TransportServerAsioPrivate();
     bool _live;
     boost::asio::ssl::context _sslContext;
-    boost::asio::ssl::stream<boost::asio::ip::tcp::socket>* _s;
+    TcpTransportSocket::Stream* _s;
     bool _ssl;
     unsigned short _port;
     qi::Future<void> _asyncEndpoints;
     Url _listenUrl;
+    // reset by a successful accept
+    qi::Duration _acceptRetryDelay;
 
     static const int64_t AcceptDownRetryTimerUs;
 
   private:
+    void accept();
     void restartAcceptor();
   };
 }
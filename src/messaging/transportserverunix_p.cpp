@@ -0,0 +1,152 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+#include <cstdio>
+
+#include <qi/log.hpp>
+
+#include "transportserverunix_p.hpp"
+#include "transportserverasio_p.hpp"
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+#include <sys/stat.h>
+
+qiLogCategory("qimessaging.transportserver");
+
+namespace qi
+{
+  TransportServerUnixPrivate::TransportServerUnixPrivate(TransportServer* self, EventLoop* ctx)
+    : TransportServerImpl(self, ctx)
+    , _acceptor(new boost::asio::local::stream_protocol::acceptor(*(boost::asio::io_service*)ctx->nativeHandle()))
+    , _sslContext(boost::asio::ssl::context::sslv23)
+    , _live(true)
+    , _acceptRetryDelay(0)
+  {
+  }
+
+  TransportServerUnixPrivate::~TransportServerUnixPrivate()
+  {
+    delete _acceptor;
+    _acceptor = 0;
+  }
+
+  qi::Future<void> TransportServerUnixPrivate::listen(const qi::Url& url)
+  {
+    const std::string& path = url.host();
+    if (path.empty())
+    {
+      const char* s = "Listen error: no socket path.";
+      qiLogError() << s;
+      return qi::makeFutureError<void>(s);
+    }
+
+    boost::asio::local::stream_protocol::endpoint ep(path);
+    boost::system::error_code ec;
+    {
+      // A socket file left by a dead process would make bind fail,
+      // but do not steal the path of a live server.
+      boost::asio::local::stream_protocol::socket probe(_acceptor->get_io_service());
+      probe.connect(ep, ec);
+      if (!ec)
+      {
+        std::string s = "Listen error: " + path + " is already in use.";
+        qiLogError() << s;
+        return qi::makeFutureError<void>(s);
+      }
+      struct ::stat st;
+      if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        ::remove(path.c_str());
+    }
+
+    qiLogDebug() << "Will listen on " << path;
+    _acceptor->open(ep.protocol(), ec);
+    if (!ec)
+      _acceptor->bind(ep, ec);
+    if (!ec)
+      _acceptor->listen(boost::asio::socket_base::max_connections, ec);
+    if (ec)
+    {
+      qiLogError("qimessaging.server.listen") << ec.message();
+      return qi::makeFutureError<void>(ec.message());
+    }
+    // From now on the socket file is ours, and removed by close()
+    _path = path;
+
+    {
+      boost::mutex::scoped_lock l(_endpointsMutex);
+      _endpoints.push_back(url);
+    }
+    qiLogInfo() << "TransportServer will listen on: " << url.str();
+
+    accept();
+    _connectionPromise.setValue(0);
+    return _connectionPromise.future();
+  }
+
+  void TransportServerUnixPrivate::accept()
+  {
+    if (!_live)
+      return;
+    TcpTransportSocket::Stream* s = new TcpTransportSocket::Stream(_acceptor->get_io_service(), _sslContext);
+    _acceptor->async_accept(s->lowest_layer(),
+      boost::bind(&TransportServerUnixPrivate::onAccept,
+                  boost::static_pointer_cast<TransportServerUnixPrivate>(shared_from_this()), _1, s));
+  }
+
+  void TransportServerUnixPrivate::onAccept(const boost::system::error_code& erc,
+                                            TcpTransportSocket::Stream* s)
+  {
+    qiLogDebug() << this << " onAccept";
+    if (!_live)
+    {
+      delete s;
+      return;
+    }
+    if (erc)
+    {
+      qiLogDebug() << "accept error " << erc.message();
+      delete s;
+      self->acceptError(erc.value());
+      if (TransportServerAsioPrivate::isFatalAcceptError(erc.value()))
+      {
+        qiLogError() << "fatal accept error on " << _path << ": " << erc.value();
+        return;
+      }
+      // errors such as running out of file descriptors last a while, do not
+      // spin on them
+      _acceptRetryDelay = TransportServerAsioPrivate::nextAcceptRetryDelay(_acceptRetryDelay);
+      qiLogDebug() << this << " Accepting again in " << qi::to_string(_acceptRetryDelay);
+      context->asyncDelay(boost::bind(&TransportServerUnixPrivate::accept,
+                                      boost::static_pointer_cast<TransportServerUnixPrivate>(shared_from_this())),
+                          _acceptRetryDelay);
+      return;
+    }
+    else
+    {
+      _acceptRetryDelay = qi::Duration(0);
+      qi::TransportSocketPtr socket = qi::TcpTransportSocketPtr(new TcpTransportSocket(context, false, s));
+      self->newConnection(socket);
+
+      if (socket.unique()) {
+        qiLogError() << "bug: socket not stored by the newConnection handler (usecount:" << socket.use_count() << ")";
+      }
+    }
+    accept();
+  }
+
+  void TransportServerUnixPrivate::close()
+  {
+    qiLogDebug() << this << " close";
+    if (!_live)
+      return;
+    _live = false;
+    boost::system::error_code ec;
+    _acceptor->close(ec);
+    if (!_path.empty())
+      ::remove(_path.c_str());
+  }
+}
+
+#endif
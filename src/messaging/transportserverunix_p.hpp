@@ -0,0 +1,49 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _SRC_TRANSPORTSERVERUNIX_P_HPP_
+#define _SRC_TRANSPORTSERVERUNIX_P_HPP_
+
+# include <boost/asio.hpp>
+# include <boost/asio/ssl.hpp>
+
+# include <qi/url.hpp>
+# include "transportserver.hpp"
+# include "tcptransportsocket.hpp"
+
+# ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+namespace qi
+{
+  /**
+   * Listen on a local socket, with urls of the form unix:///path/to/socket.
+   * Accepted connections are handled by TcpTransportSocket.
+   */
+  class TransportServerUnixPrivate : public TransportServerImpl
+  {
+  public:
+    TransportServerUnixPrivate(TransportServer* self, EventLoop* ctx);
+    virtual ~TransportServerUnixPrivate();
+
+    virtual qi::Future<void> listen(const qi::Url& listenUrl);
+    virtual void close();
+
+  private:
+    void accept();
+    void onAccept(const boost::system::error_code& erc, TcpTransportSocket::Stream* s);
+
+    boost::asio::local::stream_protocol::acceptor* _acceptor;
+    boost::asio::ssl::context _sslContext;
+    std::string _path;
+    bool _live;
+    // reset by a successful accept
+    qi::Duration _acceptRetryDelay;
+  };
+}
+
+# endif
+
+#endif  // _SRC_TRANSPORTSERVERUNIX_P_HPP_
@@ -36,6 +36,12 @@ namespace qi
     {
       return TcpTransportSocketPtr(new TcpTransportSocket(eventLoop, true));
     }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    else if (protocol == "unix")
+    {
+      return TcpTransportSocketPtr(new TcpTransportSocket(eventLoop, false));
+    }
+#endif
     else
     {
       qiLogError() << "Unrecognized protocol to create the TransportSocket: " << protocol;
@@ -64,6 +64,9 @@ namespace qi
     virtual qi::FutureSync<void> disconnect()                = 0;
 
     virtual bool send(const qi::Message &msg)                = 0;
+    /// Number of messages given to send() and not written yet, for callers
+    /// applying backpressure. Sockets without a send queue return 0.
+    virtual std::size_t sendQueueSize() { return 0; }
     /// Must be called once if the socket is obtained through TransportServer::newConnection()
     virtual void  startReading() = 0;
 
@@ -75,7 +75,20 @@ static UrlVector localhost_only(const UrlVector& input)
   for (UrlVector::const_iterator it = input.begin(), end = input.end(); it != end; ++it)
   {
     const std::string& host = it->host();
-    if (boost::algorithm::starts_with(host, "127.") || host == "localhost")
+    if (it->protocol() != "unix" && (boost::algorithm::starts_with(host, "127.") || host == "localhost"))
+      result.push_back(*it);
+  }
+  return result;
+}
+
+static UrlVector filter_protocol(const UrlVector& input, const std::string& protocol, bool keep)
+{
+  UrlVector result;
+
+  result.reserve(input.size());
+  for (UrlVector::const_iterator it = input.begin(), end = input.end(); it != end; ++it)
+  {
+    if ((it->protocol() == protocol) == keep)
       result.push_back(*it);
   }
   return result;
@@ -89,14 +102,20 @@ Future<TransportSocketPtr> TransportSocketCache::socket(const ServiceInfo& servI
   bool local = machineId == os::getMachineId();
   UrlVector connectionCandidates;
 
-  // If the connection is local, we're mainly interested in localhost endpoint
+  // If the connection is local, we're mainly interested in local sockets,
+  // and then in localhost endpoints
   if (local)
-    connectionCandidates = localhost_only(servInfo.endpoints());
+  {
+    connectionCandidates = filter_protocol(servInfo.endpoints(), "unix", true);
+    if (connectionCandidates.size() == 0)
+      connectionCandidates = localhost_only(servInfo.endpoints());
+  }
 
   // If the connection isn't local or if the service doesn't expose local endpoints,
   // try and connect to whatever is available.
+  // Local sockets of another machine are never reachable.
   if (connectionCandidates.size() == 0)
-    connectionCandidates = servInfo.endpoints();
+    connectionCandidates = filter_protocol(servInfo.endpoints(), "unix", false);
 
   couple->endpoint = TransportSocketPtr();
   couple->state = State_Pending;
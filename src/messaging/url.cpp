@@ -149,6 +149,12 @@ namespace qi {
     split_me(url);
   }
 
+  // Local socket urls name a path, not a host and a port
+  static bool usesPort(const std::string& protocol)
+  {
+    return protocol != "unix";
+  }
+
   UrlPrivate::UrlPrivate(const std::string& url, unsigned short defaultPort)
     : url(url)
     , protocol()
@@ -156,7 +162,7 @@ namespace qi {
     , port(defaultPort)
     , components(0)
   {
-    if (!(split_me(url) & PORT)) {
+    if (!(split_me(url) & PORT) && usesPort(protocol)) {
       port = defaultPort;
       components |= PORT;
       std::stringstream ss;
@@ -192,7 +198,7 @@ namespace qi {
       components |= SCHEME;
       this->url = protocol + "://" + url;
     }
-    if (!(result & PORT)) {
+    if (!(result & PORT) && usesPort(protocol)) {
       port = defaultPort;
       components |= PORT;
       std::stringstream ss;
@@ -202,6 +208,8 @@ namespace qi {
   }
 
   bool UrlPrivate::isValid() const {
+    if ((components & SCHEME) && !usesPort(protocol))
+      return (components & HOST) == HOST;
     return (components & (PORT | SCHEME)) == (PORT | SCHEME);
   }
 
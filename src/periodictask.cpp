@@ -4,10 +4,15 @@
  * found in the COPYING file.
  */
 
+#include <map>
+#include <vector>
+
 #include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
 #include <boost/thread.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <qi/log.hpp>
+#include <qi/getenv.hpp>
 #include <qi/periodictask.hpp>
 
 
@@ -17,31 +22,71 @@ qiLogCategory("qi.PeriodicTask");
 enum class TaskState
 {
   Stopped = 0,
-  Scheduled = 1, //< scheduled in an async()
+  Scheduled = 1, //< waiting in the scheduler, or dispatched
   Running = 2,   //< being executed
   Stopping = 5, //< stop requested
   Triggering = 6, //< force trigger
-  TriggerReady = 7, //< force trigger (step 2)
 };
 
 /* Transition matrix:
- Stopped      -> Starting [start()]
- Starting     -> Rescheduling [start()]
- Rescheduling -> Scheduled [start(), _wrap()]
- Scheduled    -> Running   [start()]
- Running      -> Rescheduling [ _wrap() ]
- Stopping     -> Stopped   [stop(), _wrap(), trigger()]
- Running      -> Stopping [stop()]
- Scheduled    -> Stopping [stop()]
+ Stopped      -> Scheduled [start()]
+ Scheduled    -> Running   [_wrap()]
+ Running      -> Scheduled [_wrap()]
+ Running      -> Stopping  [stop()]
+ Scheduled    -> Stopping  [stop()]
+ Stopping     -> Stopped   [stop(), _wrap()]
  Scheduled    -> Triggering [trigger()]
+ Triggering   -> Scheduled [trigger()]
  Triggering   -> Running [_wrap()]
- Triggering   -> Rescheduling [_trigger()]
 
- - State Rescheduling is a lock on _state and on _task
+ - stop() and trigger() take the task back from the scheduler when it was not
+   dispatched yet, otherwise _wrap() handles the transition
 */
 
 namespace qi
 {
+  struct PeriodicTaskPrivate;
+  using PeriodicTaskPrivatePtr = boost::shared_ptr<PeriodicTaskPrivate>;
+
+  /* Deadlines of all the periodic tasks of the process.
+   *
+   * Deadlines are rounded up to ticks of QI_PERIODICTASK_RESOLUTION_US
+   * (default 1ms) counted from the origin of the steady clock, and the tasks
+   * due on a same tick are kept together. A single timer of the default event
+   * loop, armed on the earliest tick, dispatches all the tasks of the ticks
+   * which are due in one go.
+   *
+   * This origin is also the one of the grids of the tasks which compensate
+   * their call time, so tasks with equal or harmonic periods share ticks.
+   */
+  class PeriodicTaskScheduler
+  {
+  public:
+    static PeriodicTaskScheduler& instance();
+
+    /// Dispatch task at deadline. The task must not be scheduled already.
+    void schedule(const PeriodicTaskPrivatePtr& task, qi::SteadyClockTimePoint deadline);
+    /// Take task back, return false if it is not waiting for its deadline.
+    bool unschedule(PeriodicTaskPrivate* task);
+    /// Smallest point of the grid of period which is not before t.
+    qi::SteadyClockTimePoint gridPoint(qi::SteadyClockTimePoint t, qi::Duration period) const;
+
+  private:
+    using Tick = qi::int64_t;
+    using Tasks = std::vector<PeriodicTaskPrivatePtr>;
+
+    PeriodicTaskScheduler();
+
+    void arm(Tick tick);
+    void onTimer(Tick tick);
+
+    const qi::Duration _resolution;
+    boost::mutex _mutex;
+    std::map<Tick, Tasks> _ticks;
+    bool _armed;
+    Tick _armedTick;
+    qi::Future<void> _timer;
+  };
 
   struct PeriodicTaskPrivate :
     boost::enable_shared_from_this<PeriodicTaskPrivate>
@@ -49,30 +94,150 @@ namespace qi
     MethodStatistics        _callStats;
     qi::SteadyClockTimePoint _statsDisplayTime;
     PeriodicTask::Callback  _callback;
-    PeriodicTask::ScheduleCallback _scheduleCallback;
+    qi::Strand*             _strand;
     qi::Duration            _period;
     TaskState               _state;
-    qi::Future<void>        _task;
+    qi::SteadyClockTimePoint _deadline;
     std::string             _name;
     bool                    _compensateCallTime;
     int                     _tid;
     boost::mutex            _mutex;
     boost::condition_variable _cond;
 
-    void _reschedule(qi::Duration delay = qi::Duration(0));
+    // timing statistics since start(), under _mutex
+    unsigned int            _calls;
+    unsigned int            _overruns;
+    qi::Duration            _jitterSum;
+    qi::Duration            _maxJitter;
+
+    // under the mutex of the scheduler
+    bool                    _queued;
+    qi::int64_t             _tick;
+
+    void _reschedule(qi::SteadyClockTimePoint deadline);
+    void _dispatch();
     void _wrap();
-    void _onTaskFinished(const qi::Future<void>& fut);
   };
+
+  PeriodicTaskScheduler& PeriodicTaskScheduler::instance()
+  {
+    // never destroyed, its timer may still fire while the process exits
+    static PeriodicTaskScheduler* scheduler = new PeriodicTaskScheduler;
+    return *scheduler;
+  }
+
+  PeriodicTaskScheduler::PeriodicTaskScheduler()
+    : _resolution(qi::MicroSeconds(std::max(1u, qi::os::getEnvDefault("QI_PERIODICTASK_RESOLUTION_US", 1000u))))
+    , _armed(false)
+    , _armedTick(0)
+  {
+  }
+
+  qi::SteadyClockTimePoint PeriodicTaskScheduler::gridPoint(qi::SteadyClockTimePoint t, qi::Duration period) const
+  {
+    if (period <= qi::Duration(0))
+      return t;
+    const qi::Duration::rep n = (t.time_since_epoch().count() + period.count() - 1) / period.count();
+    return qi::SteadyClockTimePoint(period * n);
+  }
+
+  void PeriodicTaskScheduler::schedule(const PeriodicTaskPrivatePtr& task, qi::SteadyClockTimePoint deadline)
+  {
+    const Tick tick = (deadline.time_since_epoch().count() + _resolution.count() - 1) / _resolution.count();
+    boost::optional<qi::Future<void> > superseded;
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      assert(!task->_queued);
+      task->_queued = true;
+      task->_tick = tick;
+      _ticks[tick].push_back(task);
+      if (!_armed || tick < _armedTick)
+      {
+        if (_armed)
+          superseded = _timer;
+        arm(tick);
+      }
+    }
+    // outside of the lock, canceling runs the callbacks of the future
+    if (superseded)
+      superseded->cancel();
+  }
+
+  bool PeriodicTaskScheduler::unschedule(PeriodicTaskPrivate* task)
+  {
+    PeriodicTaskPrivatePtr removed;
+    boost::mutex::scoped_lock lock(_mutex);
+    if (!task->_queued)
+      return false;
+    std::map<Tick, Tasks>::iterator it = _ticks.find(task->_tick);
+    assert(it != _ticks.end());
+    Tasks& tasks = it->second;
+    for (Tasks::iterator t = tasks.begin(); t != tasks.end(); ++t)
+      if (t->get() == task)
+      {
+        // the last reference may be in the tick, release it out of the lock
+        removed.swap(*t);
+        tasks.erase(t);
+        break;
+      }
+    if (tasks.empty())
+      _ticks.erase(it);
+    task->_queued = false;
+    // the timer stays armed, it rearms itself when it finds nothing due
+    return true;
+  }
+
+  void PeriodicTaskScheduler::arm(Tick tick)
+  {
+    _armed = true;
+    _armedTick = tick;
+    _timer = getEventLoop()->asyncAt(
+        boost::bind(&PeriodicTaskScheduler::onTimer, this, tick),
+        qi::SteadyClockTimePoint(_resolution * tick));
+  }
+
+  void PeriodicTaskScheduler::onTimer(Tick tick)
+  {
+    Tasks due;
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      if (_armed && _armedTick == tick)
+        _armed = false;
+      const Tick now = qi::SteadyClock::now().time_since_epoch().count() / _resolution.count();
+      while (!_ticks.empty() && _ticks.begin()->first <= now)
+      {
+        Tasks& tasks = _ticks.begin()->second;
+        for (Tasks::iterator t = tasks.begin(); t != tasks.end(); ++t)
+        {
+          (*t)->_queued = false;
+          due.push_back(std::move(*t));
+        }
+        _ticks.erase(_ticks.begin());
+      }
+      if (!_ticks.empty() && (!_armed || _ticks.begin()->first < _armedTick))
+        arm(_ticks.begin()->first);
+    }
+    if (!due.empty())
+      qiLogDebug() << "tick " << tick << ": dispatching " << due.size() << " tasks";
+    for (Tasks::iterator t = due.begin(); t != due.end(); ++t)
+      (*t)->_dispatch();
+  }
+
   static const int invalidThreadId = -1;
   PeriodicTask::PeriodicTask() :
     _p(new PeriodicTaskPrivate)
   {
+    _p->_strand = nullptr;
     _p->_period = qi::Duration(-1);
     _p->_tid = invalidThreadId;
     _p->_compensateCallTime =false;
     _p->_statsDisplayTime = qi::SteadyClock::now();
     _p->_name = "PeriodicTask_" + boost::lexical_cast<std::string>(this);
     _p->_state = TaskState::Stopped;
+    _p->_calls = 0;
+    _p->_overruns = 0;
+    _p->_queued = false;
+    _p->_tick = 0;
   }
 
 
@@ -95,11 +260,7 @@ namespace qi
 
   void PeriodicTask::setStrand(qi::Strand* strand)
   {
-    if (strand)
-      _p->_scheduleCallback = boost::bind(
-          &qi::Strand::asyncDelay<const Callback&>, strand, _1, _2);
-    else
-      _p->_scheduleCallback = ScheduleCallback();
+    _p->_strand = strand;
   }
 
   void PeriodicTask::setUsPeriod(qi::int64_t usp)
@@ -132,7 +293,20 @@ namespace qi
       qiLogDebug() << static_cast<int>(_p->_state) << " task was not stopped";
       return; // Already running or being started.
     }
-    _p->_reschedule(immediate ? qi::Duration(0) : _p->_period);
+    _p->_calls = 0;
+    _p->_overruns = 0;
+    _p->_jitterSum = qi::Duration(0);
+    _p->_maxJitter = qi::Duration(0);
+
+    const qi::SteadyClockTimePoint now = qi::SteadyClock::now();
+    if (immediate)
+      _p->_reschedule(now);
+    else if (_p->_compensateCallTime)
+      // first point of the grid at least a period away, so that the task gets
+      // in phase with the others without being called early
+      _p->_reschedule(PeriodicTaskScheduler::instance().gridPoint(now + _p->_period, _p->_period));
+    else
+      _p->_reschedule(now + _p->_period);
   }
 
   void PeriodicTask::asyncStop()
@@ -157,10 +331,14 @@ namespace qi
       }
       _p->_cond.wait(l);
     }
-    // We do not want to wait for callback to trigger. Since at this point
-    // the callback (_wrap)  is not allowed to touch _task, we can just
-    // cancel/wait it
-    _p->_task.cancel();
+    // We do not want to wait for the deadline. If the task was already
+    // dispatched, _wrap will see that we are stopping.
+    if (PeriodicTaskScheduler::instance().unschedule(_p.get()))
+    {
+      qiLogDebug() << "run canceled";
+      _p->_state = TaskState::Stopped;
+      _p->_cond.notify_all();
+    }
   }
 
   void PeriodicTask::stop()
@@ -182,49 +360,41 @@ namespace qi
     if (_p->_state == TaskState::Scheduled)
     {
       _p->_state = TaskState::Triggering;
-      _p->_task.cancel();
-      while (_p->_state == TaskState::Triggering)
-        _p->_cond.wait(l);
-      if (_p->_state != TaskState::TriggerReady)
+      if (!PeriodicTaskScheduler::instance().unschedule(_p.get()))
       {
+        // already dispatched, wait for _wrap to take it
+        while (_p->_state == TaskState::Triggering)
+          _p->_cond.wait(l);
         qiLogDebug() << "already triggered";
         return;
       }
-      _p->_reschedule();
+      _p->_reschedule(qi::SteadyClock::now());
     }
   }
 
-  void PeriodicTaskPrivate::_onTaskFinished(const qi::Future<void>& fut)
+  void PeriodicTaskPrivate::_reschedule(qi::SteadyClockTimePoint deadline)
   {
-    if (fut.isCanceled())
-    {
-      qiLogDebug() << "run canceled";
-      boost::mutex::scoped_lock l(_mutex);
-      if (_state == TaskState::Stopping)
-        _state = TaskState::Stopped;
-      else if (_state == TaskState::Triggering)
-        _state = TaskState::TriggerReady;
-      else
-        assert(false && "state is not stopping nor triggering");
-      _cond.notify_all();
-    }
+    qiLogDebug() << "rescheduling at " << qi::to_string(deadline);
+    _deadline = deadline;
+    _state = TaskState::Scheduled;
+    if (deadline <= qi::SteadyClock::now())
+      _dispatch();
+    else
+      PeriodicTaskScheduler::instance().schedule(shared_from_this(), deadline);
   }
 
-  void PeriodicTaskPrivate::_reschedule(qi::Duration delay)
+  void PeriodicTaskPrivate::_dispatch()
   {
-    qiLogDebug() << "rescheduling in " << qi::to_string(delay);
-    if (_scheduleCallback)
-      _task = _scheduleCallback(boost::bind(&PeriodicTaskPrivate::_wrap, shared_from_this()), delay);
+    if (_strand)
+      _strand->post(boost::bind(&PeriodicTaskPrivate::_wrap, shared_from_this()));
     else
-      _task = getEventLoop()->asyncDelay(boost::bind(&PeriodicTaskPrivate::_wrap, shared_from_this()), delay);
-    _state = TaskState::Scheduled;
-    _task.connect(boost::bind(
-          &PeriodicTaskPrivate::_onTaskFinished, shared_from_this(), _1));
+      getEventLoop()->post(boost::bind(&PeriodicTaskPrivate::_wrap, shared_from_this()));
   }
 
   void PeriodicTaskPrivate::_wrap()
   {
     qiLogDebug() << "callback start";
+    qi::SteadyClockTimePoint deadline;
     {
       boost::mutex::scoped_lock l(_mutex);
       assert(_state != TaskState::Stopped);
@@ -240,16 +410,18 @@ namespace qi
       }
       assert(_state == TaskState::Scheduled || _state == TaskState::Triggering);
       _state = TaskState::Running;
+      deadline = _deadline;
       _cond.notify_all();
     }
     bool shouldAbort = false;
+    qi::SteadyClockTimePoint start;
     qi::SteadyClockTimePoint now;
     qi::Duration delta;
     qi::int64_t usr, sys;
     bool compensate = _compensateCallTime; // we don't want that bool to change in the middle
     try
     {
-      qi::SteadyClockTimePoint start = qi::SteadyClock::now();
+      start = qi::SteadyClock::now();
       std::pair<qi::int64_t, qi::int64_t> cpu = qi::os::cputime();
       _tid = os::gettid();
       _callback();
@@ -305,6 +477,14 @@ namespace qi
       qiLogDebug() << "continuing";
       {
         boost::mutex::scoped_lock l(_mutex);
+        const qi::Duration jitter = std::max(qi::Duration(0), start - deadline);
+        ++_calls;
+        _jitterSum += jitter;
+        _maxJitter = std::max(_maxJitter, jitter);
+        const bool overrun = _period > qi::Duration(0) && now > deadline + _period;
+        if (overrun)
+          ++_overruns;
+
         if (_state != TaskState::Running)
         {
           qiLogDebug() << "continuing " << static_cast<int>(_state);
@@ -313,7 +493,20 @@ namespace qi
           _cond.notify_all();
           return;
         }
-        _reschedule(std::max(qi::Duration(0), _period - (compensate ? delta : qi::Duration(0))));
+        if (compensate)
+        {
+          // the next point of the grid, or the first one not already missed
+          PeriodicTaskScheduler& scheduler = PeriodicTaskScheduler::instance();
+          qi::SteadyClockTimePoint next = scheduler.gridPoint(deadline + qi::Duration(1), _period);
+          if (overrun)
+          {
+            next = std::max(next, scheduler.gridPoint(now, _period));
+            qiLogDebug() << _name << " overran its period, skipping to " << qi::to_string(next);
+          }
+          _reschedule(next);
+        }
+        else
+          _reschedule(now + _period);
       }
     }
   }
@@ -342,4 +535,15 @@ namespace qi
     }
     return s == TaskState::Stopped || s == TaskState::Stopping;
   }
+
+  PeriodicTask::Statistics PeriodicTask::statistics() const
+  {
+    Statistics stats;
+    boost::mutex::scoped_lock l(_p->_mutex);
+    stats.calls = _p->_calls;
+    stats.overruns = _p->_overruns;
+    stats.meanJitter = _p->_calls ? _p->_jitterSum / _p->_calls : qi::Duration(0);
+    stats.maxJitter = _p->_maxJitter;
+    return stats;
+  }
 }
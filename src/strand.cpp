@@ -3,7 +3,9 @@
 **  See COPYING for the license
 */
 #include <atomic>
+#include <boost/thread/thread.hpp>
 #include <qi/strand.hpp>
+#include <qi/eventloop.hpp>
 #include <qi/log.hpp>
 #include <qi/future.hpp>
 #include <qi/getenv.hpp>
@@ -30,6 +32,108 @@ struct StrandPrivate::Callback
   qi::Future<void> asyncFuture;
 };
 
+struct StrandPrivate::Job
+{
+  boost::atomic<Job*> next;
+  // a job has either a callback, when posted, or a cbStruct, when it has a future
+  boost::function<void()> callback;
+  boost::shared_ptr<Callback> cbStruct;
+};
+
+/* Intrusive multiple producers single consumer queue: pushing is one
+ * exchange, popping takes no lock.
+ *
+ * The consumer is whoever brings _pending from 0, for as long as it does not
+ * bring it back to 0.
+ */
+class StrandPrivate::JobQueue
+{
+public:
+  JobQueue()
+    : _head(&_stub)
+    , _tail(&_stub)
+  {
+    _stub.next = nullptr;
+  }
+
+  ~JobQueue()
+  {
+    while (Job* job = pop())
+      delete job;
+  }
+
+  void push(Job* job)
+  {
+    job->next.store(nullptr, boost::memory_order_relaxed);
+    Job* prev = _head.exchange(job, boost::memory_order_acq_rel);
+    prev->next.store(job, boost::memory_order_release);
+  }
+
+  /// @return the oldest job, or null if the queue is empty or a push is not finished
+  Job* pop()
+  {
+    Job* tail = _tail;
+    Job* next = tail->next.load(boost::memory_order_acquire);
+    if (tail == &_stub)
+    {
+      if (!next)
+        return nullptr;
+      _tail = next;
+      tail = next;
+      next = next->next.load(boost::memory_order_acquire);
+    }
+    if (next)
+    {
+      _tail = next;
+      return tail;
+    }
+    if (tail != _head.load(boost::memory_order_acquire))
+      return nullptr;
+    // tail is the last job, put the stub behind it to be able to detach it
+    push(&_stub);
+    next = tail->next.load(boost::memory_order_acquire);
+    if (next)
+    {
+      _tail = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  /// @return the oldest job, the caller knowing that there is one
+  Job* take()
+  {
+    Job* job;
+    // a producer may be between its exchange and its link, it will not be long
+    while (!(job = pop()))
+      boost::this_thread::yield();
+    return job;
+  }
+
+private:
+  boost::atomic<Job*> _head;
+  Job* _tail;
+  Job _stub;
+};
+
+StrandPrivate::StrandPrivate(qi::ExecutionContext& eventLoop)
+  : _eventLoop(eventLoop)
+  , _curId(0)
+  , _aliveCount(0)
+  , _pending(0)
+  , _posting(0)
+  , _processingThread(0)
+  , _dying(false)
+  , _queue(new JobQueue)
+  , _affinityEventLoop(nullptr)
+  , _lastThread(-1)
+{
+}
+
+StrandPrivate::~StrandPrivate()
+{
+}
+
 boost::shared_ptr<StrandPrivate::Callback> StrandPrivate::createCallback(boost::function<void()> cb)
 {
   ++_aliveCount;
@@ -72,43 +176,72 @@ Future<void> StrandPrivate::asyncDelayImpl(boost::function<void()> cb, qi::Durat
 void StrandPrivate::enqueue(boost::shared_ptr<Callback> cbStruct)
 {
   qiLogDebug() << "Enqueueing job id " << cbStruct->id;
-  bool shouldschedule = false;
 
+  boost::mutex::scoped_lock lock(_mutex);
+  // the callback may have been canceled
+  if (cbStruct->state == State::None)
   {
-    boost::mutex::scoped_lock lock(_mutex);
-    // the callback may have been canceled
-    if (cbStruct->state == State::None)
-    {
-      if (_dying)
-      {
-        cbStruct->promise.setError("the strand is dying");
-        return;
-      }
-
-      _queue.push_back(cbStruct);
-      cbStruct->state = State::Scheduled;
-    }
-    else
+    if (_dying)
     {
-      assert(cbStruct->state == State::Canceled);
-      qiLogDebug() << "Job was canceled, dropping";
+      cbStruct->promise.setError("the strand is dying");
       return;
     }
-    // if process was not scheduled yet, do it, there is work to do
-    if (!_processing)
-    {
-      _processing = true;
-      shouldschedule = true;
-    }
+
+    cbStruct->state = State::Scheduled;
+  }
+  else
+  {
+    assert(cbStruct->state == State::Canceled);
+    qiLogDebug() << "Job was canceled, dropping";
+    return;
   }
 
-  if (shouldschedule)
+  // pushed under the lock, so that a join() seeing _dying unset after us also
+  // sees the job pending. cancel() may mark it canceled from now on, process()
+  // will skip it
+  Job* job = new Job;
+  job->cbStruct = std::move(cbStruct);
+  push(job);
+}
+
+void StrandPrivate::postJob(boost::function<void()> cb)
+{
+  // join() waits for the posts which did not see _dying set, and they drop
+  // their job otherwise, like the jobs still queued when the strand dies
+  ++_posting;
+  if (!_dying)
+  {
+    Job* job = new Job;
+    job->callback = std::move(cb);
+    push(job);
+  }
+  if (--_posting == 0 && _dying)
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    _processFinished.notify_all();
+  }
+}
+
+void StrandPrivate::push(Job* job)
+{
+  _queue->push(job);
+  // if process was not scheduled yet, do it, there is work to do
+  if (_pending.fetch_add(1) == 0)
   {
     qiLogDebug() << "StrandPrivate::process was not scheduled, doing it";
-    _eventLoop.async(boost::bind(&StrandPrivate::process, shared_from_this()));
+    scheduleProcess();
   }
 }
 
+void StrandPrivate::scheduleProcess()
+{
+  if (_affinityEventLoop)
+    _affinityEventLoop->postOnThread(_lastThread,
+        boost::bind(&StrandPrivate::process, shared_from_this()));
+  else
+    _eventLoop.async(boost::bind(&StrandPrivate::process, shared_from_this()));
+}
+
 void StrandPrivate::process()
 {
   static const unsigned int QI_STRAND_QUANTUM_US =
@@ -116,7 +249,10 @@ void StrandPrivate::process()
 
   qiLogDebug() << "StrandPrivate::process started";
 
-  _processingThread = qi::os::gettid();
+  int thread = qi::os::gettid();
+  _processingThread = thread;
+  if (_affinityEventLoop)
+    _lastThread = _affinityEventLoop->currentThreadIndex();
 
   qi::SteadyClockTimePoint start = qi::SteadyClock::now();
 
@@ -124,68 +260,108 @@ void StrandPrivate::process()
 
   do
   {
-    boost::shared_ptr<Callback> cbStruct;
+    if (_dying)
     {
-      boost::mutex::scoped_lock lock(_mutex);
-      if (_dying)
-      {
-        qiLogDebug() << this << " strand is dying, stopping process";
-        break;
-      }
+      qiLogDebug() << this << " strand is dying, dropping the remaining jobs";
+      do
+        drop(_queue->take());
+      while (--_pending != 0);
+      finished = true;
+      break;
+    }
 
-      assert(_processing);
-      if (_queue.empty())
+    Job* job = _queue->take();
+    if (!job->cbStruct)
+    {
+      try {
+        job->callback();
+      }
+      catch (std::exception& e) {
+        qiLogVerbose() << "Posted job has thrown: " << e.what();
+      }
+      catch (...) {
+        qiLogVerbose() << "Posted job has thrown";
+      }
+    }
+    else
+    {
+      boost::shared_ptr<Callback>& cbStruct = job->cbStruct;
+      bool run = false;
       {
-        qiLogDebug() << "Queue empty, stopping";
-        finished = true;
-        break;
+        boost::mutex::scoped_lock lock(_mutex);
+        if (cbStruct->state == State::Scheduled)
+        {
+          --_aliveCount;
+          cbStruct->state = State::Running;
+          run = true;
+        }
       }
-      cbStruct = _queue.front();
-      _queue.pop_front();
-      if (cbStruct->state == State::Scheduled)
+      if (run)
       {
-        --_aliveCount;
-        cbStruct->state = State::Running;
+        qiLogDebug() << "Executing job id " << cbStruct->id;
+        try {
+          cbStruct->callback();
+          cbStruct->promise.setValue(0);
+        }
+        catch (std::exception& e) {
+          cbStruct->promise.setError(e.what());
+        }
+        catch (...) {
+          cbStruct->promise.setError("callback has thrown in strand");
+        }
+        qiLogDebug() << "Finished job id " << cbStruct->id;
       }
       else
       {
         // Job was canceled, cancel() already has done --_aliveCount
         qiLogDebug() << "Abandoning job id " << cbStruct->id
           << ", state: " << static_cast<int>(cbStruct->state);
-        continue;
       }
     }
-    qiLogDebug() << "Executing job id " << cbStruct->id;
-    try {
-      cbStruct->callback();
-      cbStruct->promise.setValue(0);
-    }
-    catch (std::exception& e) {
-      cbStruct->promise.setError(e.what());
-    }
-    catch (...) {
-      cbStruct->promise.setError("callback has thrown in strand");
+    delete job;
+
+    if (--_pending == 0)
+    {
+      qiLogDebug() << "Queue empty, stopping";
+      finished = true;
+      break;
     }
-    qiLogDebug() << "Finished job id " << cbStruct->id;
   } while (qi::SteadyClock::now() - start < qi::MicroSeconds(QI_STRAND_QUANTUM_US));
 
-  _processingThread = 0;
+  // once _pending went back to 0, another process() may already have started
+  _processingThread.compare_exchange_strong(thread, 0);
 
+  if (!finished)
   {
+    qiLogDebug() << "Strand quantum expired, rescheduling";
+    scheduleProcess();
+  }
+  else
+  {
+    // join() waits for _pending to be 0 under the lock
     boost::mutex::scoped_lock lock(_mutex);
-    // if we still have work
-    if (!finished && !_dying)
-    {
-      qiLogDebug() << "Strand quantum expired, rescheduling";
-      lock.unlock();
-      _eventLoop.async(boost::bind(&StrandPrivate::process, shared_from_this()));
-    }
-    else
+    _processFinished.notify_all();
+  }
+}
+
+void StrandPrivate::drop(Job* job)
+{
+  if (job->cbStruct)
+  {
+    bool scheduled = false;
     {
-      _processing = false;
-      _processFinished.notify_all();
+      boost::mutex::scoped_lock lock(_mutex);
+      if (job->cbStruct->state == State::Scheduled)
+      {
+        job->cbStruct->state = State::Canceled;
+        --_aliveCount;
+        scheduled = true;
+      }
     }
+    if (scheduled)
+      job->cbStruct->promise.setError("the strand is dying");
   }
+  delete job;
 }
 
 void StrandPrivate::cancel(boost::shared_ptr<Callback> cbStruct)
@@ -202,22 +378,9 @@ void StrandPrivate::cancel(boost::shared_ptr<Callback> cbStruct)
       cbStruct->promise.setCanceled();
       break;
     case State::Scheduled:
-      qiLogDebug() << "Was scheduled, removing it from queue";
-      {
-        bool erased = false;
-        for (Queue::iterator iter = _queue.begin(); iter != _queue.end(); ++iter)
-          if ((*iter)->id == cbStruct->id)
-          {
-            _queue.erase(iter);
-            erased = true;
-            break;
-          }
-        // state was scheduled, so the callback must be there
-        assert(erased);
-        // Silence compile warning unused erased
-        (void)erased;
-
-      }
+      // left in the queue, process() skips it
+      qiLogDebug() << "Was scheduled, marking it canceled";
+      cbStruct->state = State::Canceled;
       --_aliveCount;
       cbStruct->promise.setCanceled();
       break;
@@ -239,6 +402,13 @@ Strand::Strand(qi::ExecutionContext& eventloop)
 {
 }
 
+Strand::Strand(qi::ExecutionContext& eventloop, Affinity affinity)
+  : _p(new StrandPrivate(eventloop))
+{
+  if (affinity == Affinity::Thread)
+    _p->_affinityEventLoop = dynamic_cast<qi::EventLoop*>(&eventloop);
+}
+
 Strand::~Strand()
 {
   join();
@@ -257,7 +427,7 @@ void Strand::join()
 
   {
     boost::unique_lock<boost::mutex> lock(_p->_mutex);
-    qiLogVerbose() << this << " joining (processing: " << _p->_processing
+    qiLogVerbose() << this << " joining (pending: " << _p->_pending
       << ", size: " << _p->_aliveCount << ")";
 
     _p->_dying = true;
@@ -271,17 +441,8 @@ void Strand::join()
 
     boost::atomic_exchange(&prv, _p);
 
-    prv->_processFinished.wait(lock, [&]{ return !prv->_processing; });
-    while (!prv->_queue.empty())
-    {
-      auto task = std::move(prv->_queue.front());
-      prv->_queue.pop_front();
-      if (task->state == StrandPrivate::State::Canceled)
-        continue;
-      assert(task->state == StrandPrivate::State::Scheduled);
-      task->promise.setError("the strand is dying");
-      --prv->_aliveCount;
-    }
+    // process() drops the remaining jobs once it sees _dying
+    prv->_processFinished.wait(lock, [&]{ return prv->_pending == 0 && prv->_posting == 0; });
 
     qiLogVerbose() << this << " joined, remaining tasks: " << prv->_aliveCount;
   }
@@ -329,7 +490,7 @@ void Strand::postImpl(boost::function<void()> callback)
 {
   auto prv = boost::atomic_load(&_p);
   if (prv)
-    prv->enqueue(prv->createCallback(std::move(callback)));
+    prv->postJob(std::move(callback));
 }
 
 bool Strand::isInThisContext()
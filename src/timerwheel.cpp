@@ -0,0 +1,328 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/bind.hpp>
+
+#include "timerwheel.hpp"
+
+namespace qi
+{
+  // Duration of a tick of the first level
+  static const qi::Duration TickDuration = qi::MilliSeconds(1);
+
+  TimerWheel::TimerWheel(boost::asio::io_service& io, Callback onExpired, Callback onCanceled)
+    : _timer(io)
+    , _onExpired(onExpired)
+    , _onCanceled(onCanceled)
+    , _origin(qi::SteadyClock::now())
+    , _current(0)
+    , _armed(false)
+    , _armedTick(0)
+    , _size(0)
+    , _free(None)
+  {
+    for (Level& level : _levels)
+    {
+      std::fill(level.heads, level.heads + SlotCount, None);
+      std::fill(level.used, level.used + SlotCount / 64, 0);
+    }
+  }
+
+  TimerWheel::~TimerWheel()
+  {
+    // wait for the cancellations in progress, and disable the next ones
+    destroy();
+    boost::mutex::scoped_lock lock(_mutex);
+    boost::system::error_code erc;
+    _timer.cancel(erc);
+  }
+
+  std::size_t TimerWheel::size() const
+  {
+    boost::mutex::scoped_lock lock(_mutex);
+    return _size;
+  }
+
+  void TimerWheel::post(qi::SteadyClockTimePoint deadline, boost::function<void()> callback, qi::uint32_t id)
+  {
+    Timer timer;
+    timer.callback = std::move(callback);
+    timer.id = id;
+    boost::mutex::scoped_lock lock(_mutex);
+    qi::uint32_t index;
+    schedule(deadline, std::move(timer), index);
+  }
+
+  qi::Future<void> TimerWheel::async(qi::SteadyClockTimePoint deadline, boost::function<void()> callback, qi::uint32_t id)
+  {
+    Timer timer;
+    timer.callback = std::move(callback);
+    timer.id = id;
+    boost::mutex::scoped_lock lock(_mutex);
+    qi::uint32_t index;
+    Handle handle = schedule(deadline, std::move(timer), index);
+    Cancel cancel = { weakPtr(), handle };
+    qi::Promise<void> promise(cancel);
+    _entries[index].timer.promise = promise;
+    return promise.future();
+  }
+
+  TimerWheel::Handle TimerWheel::schedule(qi::SteadyClockTimePoint deadline, Timer timer, qi::uint32_t& index)
+  {
+    index = allocate();
+    Entry& entry = _entries[index];
+    entry.timer = std::move(timer);
+    entry.expiry = std::max(toTick(deadline, true), _current);
+    insert(index);
+    ++_size;
+    if (!_armed || entry.expiry < _armedTick)
+    {
+      _armed = true;
+      _armedTick = entry.expiry;
+      _timer.expires_at(tickTime(_armedTick));
+      _timer.async_wait(boost::bind(&TimerWheel::onTimer, this, _1));
+    }
+    return (Handle(entry.generation) << 32) | index;
+  }
+
+  void TimerWheel::cancel(Handle handle)
+  {
+    const qi::uint32_t index = static_cast<qi::uint32_t>(handle);
+    const qi::uint32_t generation = static_cast<qi::uint32_t>(handle >> 32);
+    Timer timer;
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      if (index >= _entries.size() || _entries[index].generation != generation
+          || _entries[index].level == LevelCount) // already run or canceled
+        return;
+      unlink(index);
+      timer = std::move(_entries[index].timer);
+      release(index);
+      // Do not keep the io_service running for nothing
+      if (!_size && _armed)
+      {
+        boost::system::error_code erc;
+        _timer.cancel(erc);
+        _armed = false;
+      }
+    }
+    _onCanceled(timer);
+  }
+
+  void TimerWheel::onTimer(const boost::system::error_code& erc)
+  {
+    if (erc)
+      return; // rearmed or canceled
+    std::vector<Timer> expired;
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      advance(toTick(qi::SteadyClock::now(), false), expired);
+      if (_size)
+      {
+        _armed = true;
+        _armedTick = nextTick();
+        _timer.expires_at(tickTime(_armedTick));
+        _timer.async_wait(boost::bind(&TimerWheel::onTimer, this, _1));
+      }
+      else
+        _armed = false;
+    }
+    for (Timer& timer : expired)
+      _onExpired(timer);
+  }
+
+  TimerWheel::Tick TimerWheel::toTick(qi::SteadyClockTimePoint time, bool roundUp) const
+  {
+    if (time <= _origin)
+      return 0;
+    const qi::Duration elapsed = time - _origin;
+    Tick tick = elapsed / TickDuration;
+    if (roundUp && TickDuration * static_cast<qi::Duration::rep>(tick) < elapsed)
+      ++tick;
+    return tick;
+  }
+
+  qi::SteadyClockTimePoint TimerWheel::tickTime(Tick tick) const
+  {
+    return _origin + TickDuration * static_cast<qi::Duration::rep>(tick);
+  }
+
+  qi::uint32_t TimerWheel::allocate()
+  {
+    if (_free == None)
+    {
+      _entries.emplace_back();
+      Entry& entry = _entries.back();
+      entry.generation = 0;
+      entry.level = LevelCount;
+      return static_cast<qi::uint32_t>(_entries.size() - 1);
+    }
+    const qi::uint32_t index = _free;
+    _free = _entries[index].next;
+    return index;
+  }
+
+  void TimerWheel::release(qi::uint32_t index)
+  {
+    Entry& entry = _entries[index];
+    entry.timer = Timer();
+    entry.level = LevelCount;
+    ++entry.generation;
+    entry.next = _free;
+    _free = index;
+    --_size;
+  }
+
+  void TimerWheel::insert(qi::uint32_t index)
+  {
+    Entry& entry = _entries[index];
+    const Tick delta = entry.expiry - _current;
+    unsigned int level = 0;
+    while (level < LevelCount - 1 && delta >= (Tick(1) << (LevelBits * (level + 1))))
+      ++level;
+    Tick when = entry.expiry;
+    // Beyond the range of the wheel, wait in the last slot and come back
+    if (delta >= (Tick(1) << (LevelBits * LevelCount)))
+      when = _current + (Tick(SlotCount - 1) << (LevelBits * (LevelCount - 1)));
+    const unsigned int slot = (when >> (LevelBits * level)) & (SlotCount - 1);
+
+    Level& l = _levels[level];
+    entry.level = static_cast<unsigned char>(level);
+    entry.slot = static_cast<unsigned char>(slot);
+    entry.prev = None;
+    entry.next = l.heads[slot];
+    if (entry.next != None)
+      _entries[entry.next].prev = index;
+    l.heads[slot] = index;
+    l.used[slot / 64] |= qi::uint64_t(1) << (slot % 64);
+  }
+
+  void TimerWheel::unlink(qi::uint32_t index)
+  {
+    Entry& entry = _entries[index];
+    Level& l = _levels[entry.level];
+    if (entry.prev != None)
+      _entries[entry.prev].next = entry.next;
+    else
+      l.heads[entry.slot] = entry.next;
+    if (entry.next != None)
+      _entries[entry.next].prev = entry.prev;
+    if (l.heads[entry.slot] == None)
+      l.used[entry.slot / 64] &= ~(qi::uint64_t(1) << (entry.slot % 64));
+  }
+
+  void TimerWheel::cascade()
+  {
+    for (unsigned int level = 1; level < LevelCount; ++level)
+    {
+      Level& l = _levels[level];
+      const unsigned int slot = (_current >> (LevelBits * level)) & (SlotCount - 1);
+      qi::uint32_t index = l.heads[slot];
+      l.heads[slot] = None;
+      l.used[slot / 64] &= ~(qi::uint64_t(1) << (slot % 64));
+      while (index != None)
+      {
+        const qi::uint32_t next = _entries[index].next;
+        insert(index);
+        index = next;
+      }
+      if (slot != 0)
+        break;
+    }
+  }
+
+  void TimerWheel::advance(Tick tick, std::vector<Timer>& expired)
+  {
+    const Tick mask = SlotCount - 1;
+    while (_size && _current <= tick)
+    {
+      const unsigned int slot = _current & mask;
+      if (slot == 0)
+        cascade();
+      const Tick blockEnd = (_current | mask) + 1;
+      const int next = nextUsedSlot(0, slot);
+      // The next used slot may be in the next turn of the level
+      if (next < 0 || static_cast<unsigned int>(next) < slot)
+      {
+        _current = std::min(blockEnd, tick + 1);
+        continue;
+      }
+      const Tick due = (_current & ~mask) + next;
+      if (due > tick)
+      {
+        _current = tick + 1;
+        break;
+      }
+      _current = due;
+      Level& l = _levels[0];
+      qi::uint32_t index = l.heads[next];
+      l.heads[next] = None;
+      l.used[next / 64] &= ~(qi::uint64_t(1) << (next % 64));
+      while (index != None)
+      {
+        const qi::uint32_t following = _entries[index].next;
+        expired.push_back(std::move(_entries[index].timer));
+        release(index);
+        index = following;
+      }
+      ++_current;
+    }
+    if (_current <= tick)
+      _current = tick + 1;
+  }
+
+  int TimerWheel::nextUsedSlot(unsigned int level, unsigned int from) const
+  {
+    const qi::uint64_t* used = _levels[level].used;
+    const unsigned int words = SlotCount / 64;
+    // Search [from, SlotCount) then [0, from)
+    for (unsigned int n = 0; n <= words; ++n)
+    {
+      const unsigned int word = (from / 64 + n) % words;
+      qi::uint64_t bits = used[word];
+      if (n == 0)
+        bits &= ~qi::uint64_t(0) << (from % 64);
+      else if (n == words)
+        bits &= (qi::uint64_t(1) << (from % 64)) - 1;
+      if (bits)
+      {
+        unsigned int bit = 0;
+        while (!(bits & (qi::uint64_t(1) << bit)))
+          ++bit;
+        return word * 64 + bit;
+      }
+    }
+    return -1;
+  }
+
+  TimerWheel::Tick TimerWheel::nextTick() const
+  {
+    const Tick mask = SlotCount - 1;
+    Tick result = ~Tick(0);
+    const unsigned int slot0 = _current & mask;
+    const int next0 = nextUsedSlot(0, slot0);
+    if (next0 >= 0)
+      result = _current + ((next0 - slot0) & mask);
+    // Upper levels only need the wheel when their slot is cascaded
+    for (unsigned int level = 1; level < LevelCount; ++level)
+    {
+      const Tick block = _current >> (LevelBits * level);
+      const unsigned int slot = block & mask;
+      // At the start of a block, the slot of the block is not cascaded yet
+      const bool pending = (_current & ((Tick(1) << (LevelBits * level)) - 1)) == 0;
+      const int next = nextUsedSlot(level, pending ? slot : (slot + 1) & mask);
+      if (next < 0)
+        continue;
+      Tick distance = (next - slot) & mask;
+      if (!distance && !pending)
+        distance = SlotCount;
+      result = std::min(result, (block + distance) << (LevelBits * level));
+    }
+    return result;
+  }
+}
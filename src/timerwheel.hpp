@@ -0,0 +1,133 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _SRC_TIMERWHEEL_HPP_
+#define _SRC_TIMERWHEEL_HPP_
+
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <qi/clock.hpp>
+#include <qi/future.hpp>
+#include <qi/trackable.hpp>
+
+namespace qi
+{
+  /**
+   * Delayed tasks of an event loop.
+   *
+   * Tasks are sorted by the tick of their deadline in a hierarchical wheel:
+   * 4 levels of 256 slots, the first one with a slot per millisecond, each
+   * next one with a slot per turn of the previous one. Scheduling and
+   * canceling are O(1), and the tasks of a level are moved to the lower one
+   * when the lower one has turned.
+   *
+   * A single asio timer, armed at the next deadline, drives the wheel, so that
+   * pending tasks keep the io_service running. Due tasks are given in batch to
+   * the expired callback, canceled ones to the canceled callback, both called
+   * outside of the lock of the wheel.
+   *
+   * The futures of async() track the wheel: canceling them once the wheel is
+   * destroyed does nothing.
+   */
+  class TimerWheel : public qi::Trackable<TimerWheel>
+  {
+  public:
+    struct Timer
+    {
+      boost::function<void()> callback;
+      qi::uint32_t id;
+      boost::optional<qi::Promise<void> > promise; // unset for post()
+    };
+    using Callback = boost::function<void(Timer&)>;
+
+    TimerWheel(boost::asio::io_service& io, Callback onExpired, Callback onCanceled);
+    ~TimerWheel();
+
+    /// Schedule a task which can not be canceled.
+    void post(qi::SteadyClockTimePoint deadline, boost::function<void()> callback, qi::uint32_t id);
+    /// Schedule a task, canceled along with the returned future.
+    qi::Future<void> async(qi::SteadyClockTimePoint deadline, boost::function<void()> callback, qi::uint32_t id);
+
+    /// Number of scheduled tasks.
+    std::size_t size() const;
+
+  private:
+    using Tick = qi::uint64_t;
+    using Handle = qi::uint64_t;
+
+    static const unsigned int LevelBits = 8;
+    static const unsigned int SlotCount = 1 << LevelBits;
+    static const unsigned int LevelCount = 4;
+    static const qi::uint32_t None = 0xFFFFFFFF;
+
+    struct Entry
+    {
+      Timer timer;
+      Tick expiry;
+      qi::uint32_t prev;
+      qi::uint32_t next;
+      qi::uint32_t generation;
+      unsigned char level;
+      unsigned char slot;
+    };
+
+    struct Level
+    {
+      qi::uint32_t heads[SlotCount];
+      qi::uint64_t used[SlotCount / 64];
+    };
+
+    struct Cancel
+    {
+      boost::weak_ptr<TimerWheel> wheel;
+      Handle handle;
+      void operator()(qi::Promise<void>&) const
+      {
+        if (boost::shared_ptr<TimerWheel> locked = wheel.lock())
+          locked->cancel(handle);
+      }
+    };
+
+    qi::uint32_t allocate();
+    void insert(qi::uint32_t index);
+    void unlink(qi::uint32_t index);
+    void release(qi::uint32_t index);
+    Handle schedule(qi::SteadyClockTimePoint deadline, Timer timer, qi::uint32_t& index);
+    void cancel(Handle handle);
+    /// Move the due tasks to expired, up to tick, cascading upper levels.
+    void advance(Tick tick, std::vector<Timer>& expired);
+    void cascade();
+    /// First tick at which the wheel has something to do, if not empty.
+    Tick nextTick() const;
+    /// Index of the first used slot of level at or after from, wrapping, or -1.
+    int nextUsedSlot(unsigned int level, unsigned int from) const;
+    void onTimer(const boost::system::error_code& erc);
+    Tick toTick(qi::SteadyClockTimePoint time, bool roundUp) const;
+    qi::SteadyClockTimePoint tickTime(Tick tick) const;
+
+    using SteadyTimer = boost::asio::basic_waitable_timer<qi::SteadyClock>;
+
+    mutable boost::mutex _mutex;
+    SteadyTimer _timer;
+    Callback _onExpired;
+    Callback _onCanceled;
+    qi::SteadyClockTimePoint _origin;
+    Tick _current; // next tick to process
+    bool _armed;
+    Tick _armedTick;
+    std::size_t _size;
+    std::vector<Entry> _entries;
+    qi::uint32_t _free;
+    Level _levels[LevelCount];
+  };
+}
+
+#endif  // _SRC_TIMERWHEEL_HPP_
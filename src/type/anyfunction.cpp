@@ -2,7 +2,12 @@
 **  Copyright (C) 2012 Aldebaran Robotics
 **  See COPYING for the license
 */
+#include <set>
+#include <boost/atomic.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <qi/atomic.hpp>
 #include <qi/future.hpp>
 #include <qi/signature.hpp>
 #include <qi/anyfunction.hpp>
@@ -50,6 +55,218 @@ namespace qi
     bool          shouldDelete;
   };
 
+  namespace
+  {
+    // How call() gets a value of the expected type out of an argument
+    enum ConversionStep
+    {
+      ConversionStep_Pass,         // already of the expected type
+      ConversionStep_Convert,      // AnyReference::convert()
+      ConversionStep_Deref,        // pointer to the expected type
+      ConversionStep_DerefConvert  // pointer to a convertible type
+    };
+
+    /* Steps found for the arguments of calls to one function type, with the
+     * same argument types and transform. Immutable once published, never freed.
+     */
+    struct ConversionPlan
+    {
+      FunctionTypeInterface*      type;
+      unsigned                    offset; // 1 when a value is prepended
+      std::vector<TypeInterface*> argumentTypes;
+      std::vector<ConversionStep> steps;
+    };
+
+    // Lock-free table of the plans, probed linearly. Once it is full, the
+    // arguments of new signatures are looked at on every call.
+    const std::size_t conversionPlanCacheSize = 1024;
+    const std::size_t conversionPlanCacheProbes = 8;
+
+    qi::Atomic<const ConversionPlan*>* conversionPlanCache()
+    {
+      static qi::Atomic<const ConversionPlan*> cache[conversionPlanCacheSize];
+      return cache;
+    }
+
+    /* Counters of the plans used by the calls of one thread. Only that
+     * thread writes them, so that counting does not make the threads calling
+     * functions share a cache line. conversionCacheStats() adds them up.
+     */
+    struct ConversionCounters
+    {
+      ConversionCounters()
+        : hits(0)
+        , misses(0)
+      {
+      }
+
+      static void increment(boost::atomic<std::size_t>& counter)
+      {
+        counter.store(counter.load(boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+      }
+
+      boost::atomic<std::size_t> hits;
+      boost::atomic<std::size_t> misses;
+    };
+
+    struct ConversionCountersRegistry
+    {
+      ConversionCountersRegistry()
+        : hits(0)
+        , misses(0)
+      {
+      }
+
+      boost::mutex                     mutex;
+      std::set<ConversionCounters*>    live;
+      // counts of the threads which are gone
+      std::size_t                      hits;
+      std::size_t                      misses;
+    };
+
+    ConversionCountersRegistry& conversionCountersRegistry()
+    {
+      // never destroyed, threads may exit after the static destructors ran
+      static ConversionCountersRegistry* registry = new ConversionCountersRegistry();
+      return *registry;
+    }
+
+    void releaseConversionCounters(ConversionCounters* counters)
+    {
+      ConversionCountersRegistry& registry = conversionCountersRegistry();
+      {
+        boost::mutex::scoped_lock lock(registry.mutex);
+        registry.live.erase(counters);
+        registry.hits += counters->hits.load(boost::memory_order_relaxed);
+        registry.misses += counters->misses.load(boost::memory_order_relaxed);
+      }
+      delete counters;
+    }
+
+    ConversionCounters& conversionCounters()
+    {
+      static boost::thread_specific_ptr<ConversionCounters> counters(&releaseConversionCounters);
+      ConversionCounters* current = counters.get();
+      if (!current)
+      {
+        current = new ConversionCounters();
+        ConversionCountersRegistry& registry = conversionCountersRegistry();
+        {
+          boost::mutex::scoped_lock lock(registry.mutex);
+          registry.live.insert(current);
+        }
+        counters.reset(current);
+      }
+      return *current;
+    }
+
+    std::size_t conversionPlanHash(FunctionTypeInterface* type, unsigned offset,
+                                   const AnyReference* args, unsigned count)
+    {
+      std::size_t hash = (reinterpret_cast<std::size_t>(type) >> 4) + offset;
+      for (unsigned i = 0; i < count; ++i)
+        hash = hash * 31 + (reinterpret_cast<std::size_t>(args[i].type()) >> 4);
+      return hash;
+    }
+
+    bool conversionPlanMatches(const ConversionPlan& plan, FunctionTypeInterface* type, unsigned offset,
+                               const AnyReference* args, unsigned count)
+    {
+      if (plan.type != type || plan.offset != offset || plan.argumentTypes.size() != count)
+        return false;
+      for (unsigned i = 0; i < count; ++i)
+        if (plan.argumentTypes[i] != args[i].type())
+          return false;
+      return true;
+    }
+
+    // \p full is set when there is no room left for the plan
+    const ConversionPlan* findConversionPlan(std::size_t hash, FunctionTypeInterface* type, unsigned offset,
+                                             const AnyReference* args, unsigned count, bool& full)
+    {
+      qi::Atomic<const ConversionPlan*>* cache = conversionPlanCache();
+      full = false;
+      for (std::size_t probe = 0; probe < conversionPlanCacheProbes; ++probe)
+      {
+        const ConversionPlan* plan = *cache[(hash + probe) % conversionPlanCacheSize];
+        if (!plan)
+          return 0;
+        if (conversionPlanMatches(*plan, type, offset, args, count))
+          return plan;
+      }
+      full = true;
+      return 0;
+    }
+
+    void publishConversionPlan(std::size_t hash, FunctionTypeInterface* type, unsigned offset,
+                               const AnyReference* args, unsigned count,
+                               const std::vector<ConversionStep>& steps)
+    {
+      ConversionPlan* plan = new ConversionPlan();
+      plan->type = type;
+      plan->offset = offset;
+      plan->argumentTypes.reserve(count);
+      for (unsigned i = 0; i < count; ++i)
+        plan->argumentTypes.push_back(args[i].type());
+      plan->steps = steps;
+
+      // Concurrent first calls may publish the same plan twice, which only
+      // costs a slot.
+      qi::Atomic<const ConversionPlan*>* cache = conversionPlanCache();
+      for (std::size_t probe = 0; probe < conversionPlanCacheProbes; ++probe)
+        if (cache[(hash + probe) % conversionPlanCacheSize].setIfEquals(0, plan))
+          return;
+      delete plan;
+    }
+
+    bool sameType(const AnyReference& value, TypeInterface* target)
+    {
+      return value.type() == target || value.type()->info() == target->info();
+    }
+
+    // Look for a way to convert \p arg to \p target, stored in \p step
+    std::pair<AnyReference, bool> convertArgument(const AnyReference& arg, TypeInterface* target,
+                                                  ConversionStep& step)
+    {
+      if (sameType(arg, target))
+      {
+        step = ConversionStep_Pass;
+        return std::make_pair(arg, false);
+      }
+      step = ConversionStep_Convert;
+      std::pair<AnyReference, bool> v = arg.convert(target);
+      if (v.first.type() || arg.kind() != TypeKind_Pointer)
+        return v;
+      // Try pointer dereference
+      AnyReference deref = *const_cast<AnyReference&>(arg);
+      if (sameType(deref, target))
+      {
+        step = ConversionStep_Deref;
+        return std::make_pair(deref, false);
+      }
+      step = ConversionStep_DerefConvert;
+      return deref.convert(target);
+    }
+
+    // Convert \p arg to \p target the way a previous call did
+    std::pair<AnyReference, bool> applyConversion(const AnyReference& arg, TypeInterface* target,
+                                                  ConversionStep step)
+    {
+      switch (step)
+      {
+      case ConversionStep_Pass:
+        return std::make_pair(arg, false);
+      case ConversionStep_Convert:
+        return arg.convert(target);
+      case ConversionStep_Deref:
+        return std::make_pair(*const_cast<AnyReference&>(arg), false);
+      case ConversionStep_DerefConvert:
+        return (*const_cast<AnyReference&>(arg)).convert(target);
+      }
+      return std::pair<AnyReference, bool>(AnyReference(), false);
+    }
+  }
+
 
 
   AnyReference AnyFunction::call(AnyReference arg1, const AnyReferenceVector& remaining)
@@ -118,54 +335,78 @@ namespace qi
 #endif
     if (transform.prependValue)
       arad.convertedArgs[0] = transform.boundValue;
+
+    // Arguments of the same types as a previous call are converted the same
+    // way, without looking for a conversion again
+    const std::size_t hash = conversionPlanHash(type, offset, args, sz);
+    bool full;
+    const ConversionPlan* plan = findConversionPlan(hash, type, offset, args, sz, full);
+    std::vector<ConversionStep> steps;
+    ConversionCounters& counters = conversionCounters();
+    if (plan)
+      ConversionCounters::increment(counters.hits);
+    else
+    {
+      ConversionCounters::increment(counters.misses);
+      steps.resize(sz);
+    }
+
     for (unsigned i=0; i<sz; ++i)
     {
       const unsigned ti = i + offset;
-      //qiLogDebug() << "argument " << i
-      //   << " " << args[i].type->infoString() << ' ' << args[i].value
-      //   << " to " << target[ti]->infoString();
-      if (args[i].type() == target[ti] || args[i].type()->info() == target[ti]->info())
-        arad.convertedArgs[ti] = args[i].rawValue();
-      else
+      std::pair<AnyReference,bool> v;
+      if (plan)
       {
-        //qiLogDebug() << "needs conversion "
-        //<< args[i].type->infoString() << " -> "
-        //<< target[ti]->infoString();
-        std::pair<AnyReference,bool> v = args[i].convert(target[ti]);
+        v = applyConversion(args[i], target[ti], plan->steps[i]);
+        // a dynamic value may hold something else this time
         if (!v.first.type())
         {
-          // Try pointer dereference
-          if (args[i].kind() == TypeKind_Pointer)
-          {
-            AnyReference deref = *const_cast<AnyReference&>(args[i]);
-            if (deref.type() == target[ti] || deref.type()->info() == target[ti]->info())
-              v = std::make_pair(deref, false);
-            else
-              v = deref.convert(target[ti]);
-          }
-          if (!v.first.type())
-          {
-            throw std::runtime_error(_QI_LOG_FORMAT("Call argument number %d conversion failure from %s to %s. Function signature: %s.",
-                                                    i,
-                                                    args[i].type()->signature().toPrettySignature(),
-                                                    target[ti]->signature().toPrettySignature(),
-                                                    this->parametersSignature(this->transform.dropFirst).toPrettySignature()));
-
-            return AnyReference();
-          }
+          ConversionStep step;
+          v = convertArgument(args[i], target[ti], step);
         }
+      }
+      else
+        v = convertArgument(args[i], target[ti], steps[i]);
 
-        if (v.second)
-          arad.toDestroy[arad.toDestroyPos++] = v.first;
-        arad.convertedArgs[ti] = v.first.rawValue();
+      if (!v.first.type())
+      {
+        throw std::runtime_error(_QI_LOG_FORMAT("Call argument number %d conversion failure from %s to %s. Function signature: %s.",
+                                                i,
+                                                args[i].type()->signature().toPrettySignature(),
+                                                target[ti]->signature().toPrettySignature(),
+                                                this->parametersSignature(this->transform.dropFirst).toPrettySignature()));
+
+        return AnyReference();
       }
+      if (v.second)
+        arad.toDestroy[arad.toDestroyPos++] = v.first;
+      arad.convertedArgs[ti] = v.first.rawValue();
     }
+    if (!plan && !full)
+      publishConversionPlan(hash, type, offset, args, sz, steps);
+
     void* res;
     res = type->call(value, arad.convertedArgs, sz+offset);
     arad.destroy();
     return AnyReference(resultType(), res);
   }
 
+  AnyFunction::ConversionCacheStats AnyFunction::conversionCacheStats()
+  {
+    ConversionCountersRegistry& registry = conversionCountersRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    ConversionCacheStats stats;
+    stats.hits = registry.hits;
+    stats.misses = registry.misses;
+    for (std::set<ConversionCounters*>::const_iterator it = registry.live.begin(), end = registry.live.end();
+         it != end; ++it)
+    {
+      stats.hits += (*it)->hits.load(boost::memory_order_relaxed);
+      stats.misses += (*it)->misses.load(boost::memory_order_relaxed);
+    }
+    return stats;
+  }
+
   const AnyFunction& AnyFunction::dropFirstArgument() const
   {
     transform.dropFirst = true;
@@ -9,8 +9,11 @@
 #include <qi/anyvalue.hpp>
 
 #include "binarycodec_p.hpp"
+#include "serializationplan_p.hpp"
 #include "src/messaging/streamcontext.hpp"
+#include "src/messaging/sharedmemorybuffer.hpp"
 
+#include <qi/getenv.hpp>
 #include <qi/log.hpp>
 #include <qi/anyobject.hpp>
 #include <qi/type/typedispatcher.hpp>
@@ -32,6 +35,17 @@ namespace qi {
   class BinaryDecoder;
   class BinaryEncoder;
 
+  // Size of a raw buffer followed by its actual size and shared memory segment name
+  static const qi::uint32_t sharedRawMarker = 0xFFFFFFFF;
+
+  // Raw buffers of at least this size are decoded as slices of the received
+  // buffer instead of copies, 0 disables slicing
+  static std::size_t rawSliceThreshold()
+  {
+    static const std::size_t result = qi::os::getEnvDefault<std::size_t>("QI_RAW_SLICE_THRESHOLD", 65536);
+    return result;
+  }
+
   class BinaryDecoderPrivate {
     public:
       BinaryDecoderPrivate(qi::BufferReader* buffer);
@@ -178,7 +192,7 @@ namespace qi {
     }
   }
 
-  void BinaryDecoder::read(qi::Buffer &meta) {
+  void BinaryDecoder::read(qi::Buffer &meta, StreamContext* ctx) {
     BufferReader& reader = bufferReader();
     if (reader.hasSubBuffer())
     {
@@ -188,6 +202,35 @@ namespace qi {
     {
       uint32_t sz;
       read(sz);
+      if (sz == sharedRawMarker)
+      {
+        std::string segment;
+        read(sz);
+        read(segment);
+        if (!ctx || !ctx->sharedCapability<bool>(SharedMemoryBuffer::capabilityName, false))
+        {
+          setStatus(Status::ReadError);
+          throw std::runtime_error("Unexpected shared memory buffer " + segment);
+        }
+        if (status() != Status::Ok)
+          throw std::runtime_error("Read of shared memory buffer is past end.");
+        qiLogDebug() << "Mapping buffer of size " << sz << " from " << segment;
+        meta = SharedMemoryBuffer::importBuffer(segment, sz);
+        return;
+      }
+      if (rawSliceThreshold() && sz >= rawSliceThreshold())
+      {
+        qiLogDebug() << "Slicing buffer of size " << sz << " at " << reader.position();
+        if (!reader.peek(sz))
+        {
+          setStatus(Status::ReadPastEnd);
+          std::stringstream err;
+          err << "Read of size " << sz << " is past end.";
+          throw std::runtime_error(err.str());
+        }
+        meta = reader.readSlice(sz);
+        return;
+      }
       qiLogDebug() << "Extracting buffer of size " << sz <<" at " << reader.position();
       meta.clear();
       void* ptr = meta.reserve(sz);
@@ -267,6 +310,18 @@ namespace qi {
     //                         << " at " << buffer().size();
   }
 
+  void BinaryEncoder::writeSharedRaw(const std::string& segment, qi::uint32_t size) {
+    if (!_p->_innerSerialization)
+    {
+      signature() += "r";
+    }
+    ++_p->_innerSerialization;
+    write(sharedRawMarker);
+    write(size);
+    write(segment);
+    --_p->_innerSerialization;
+  }
+
   void BinaryEncoder::writeValue(const AnyReference &value, boost::function<void()> recurse)
   {
     qi::Signature sig = value.signature();
@@ -379,6 +434,130 @@ namespace qi {
 
   namespace detail {
 
+    // Write a tuple of scalars as copies of its storage, see SerializationPlan
+    static bool serializeFlat(const AnyReference& val, BinaryEncoder& out)
+    {
+      if (!val.type() || val.kind() != TypeKind_Tuple)
+        return false;
+      const SerializationPlan& plan = serializationPlan(val.type());
+      if (!plan.flat)
+        return false;
+      void* storage = val.rawValue();
+      const char* base = static_cast<const char*>(val.type()->ptrFromStorage(&storage));
+      out.beginTuple(plan.signature);
+      char* data = static_cast<char*>(out.buffer().reserve(plan.size));
+      if (!data)
+        out.setStatus(BinaryEncoder::Status::WriteError);
+      else
+      {
+        for (unsigned i = 0; i < plan.ranges.size(); ++i)
+        {
+          memcpy(data, base + plan.ranges[i].offset, plan.ranges[i].size);
+          data += plan.ranges[i].size;
+        }
+      }
+      out.endTuple();
+      return true;
+    }
+
+    static bool deserializeFlat(AnyReference& result, BinaryDecoder& in)
+    {
+      if (!result.type() || result.kind() != TypeKind_Tuple)
+        return false;
+      const SerializationPlan& plan = serializationPlan(result.type());
+      if (!plan.inPlace)
+        return false;
+      void* storage = result.rawValue();
+      char* base = static_cast<char*>(result.type()->ptrFromStorage(&storage));
+      const char* data = static_cast<const char*>(in.readRaw(plan.size));
+      if (!data && plan.size)
+      {
+        in.setStatus(BinaryDecoder::Status::ReadPastEnd);
+        return true;
+      }
+      for (unsigned i = 0; i < plan.ranges.size(); ++i)
+      {
+        memcpy(base + plan.ranges[i].offset, data, plan.ranges[i].size);
+        data += plan.ranges[i].size;
+      }
+      return true;
+    }
+
+    // Write the elements of a list stored contiguously, in one copy if they
+    // have no padding
+    static bool serializeFlatList(ListTypeInterface* type, void* storage, size_t count, BinaryEncoder& out)
+    {
+      const SerializationPlan& plan = serializationPlan(type->elementType());
+      if (!plan.flat)
+        return false;
+      ContiguousListTypeInterface* contiguous = dynamic_cast<ContiguousListTypeInterface*>(type);
+      if (!contiguous)
+        return false;
+      size_t stride = 0;
+      const char* elements = static_cast<const char*>(contiguous->data(storage, &stride));
+      if (!elements)
+        return false;
+      if (plan.ranges.size() == 1 && plan.ranges[0].offset == 0 && plan.size == stride)
+      {
+        if (!out.buffer().write(elements, count * stride))
+          out.setStatus(BinaryEncoder::Status::WriteError);
+        return true;
+      }
+      char* data = static_cast<char*>(out.buffer().reserve(count * plan.size));
+      if (!data)
+      {
+        out.setStatus(BinaryEncoder::Status::WriteError);
+        return true;
+      }
+      for (size_t i = 0; i < count; ++i, elements += stride)
+      {
+        for (unsigned r = 0; r < plan.ranges.size(); ++r)
+        {
+          memcpy(data, elements + plan.ranges[r].offset, plan.ranges[r].size);
+          data += plan.ranges[r].size;
+        }
+      }
+      return true;
+    }
+
+    // Read \p count elements straight into the storage of a list
+    static bool deserializeFlatList(AnyReference& result, size_t count, BinaryDecoder& in)
+    {
+      ListTypeInterface* type = static_cast<ListTypeInterface*>(result.type());
+      const SerializationPlan& plan = serializationPlan(type->elementType());
+      if (!plan.inPlace || !count)
+        return false;
+      ContiguousListTypeInterface* contiguous = dynamic_cast<ContiguousListTypeInterface*>(type);
+      if (!contiguous)
+        return false;
+      // check the size before growing the list, it comes from the wire
+      if (!in.bufferReader().peek(count * plan.size))
+      {
+        in.setStatus(BinaryDecoder::Status::ReadPastEnd);
+        return true;
+      }
+      size_t stride = 0;
+      void* storage = result.rawValue();
+      char* elements = static_cast<char*>(contiguous->extend(&storage, count, &stride));
+      if (!elements)
+        return false;
+      const char* data = static_cast<const char*>(in.readRaw(count * plan.size));
+      if (plan.ranges.size() == 1 && plan.ranges[0].offset == 0 && plan.size == stride)
+      {
+        memcpy(elements, data, count * stride);
+        return true;
+      }
+      for (size_t i = 0; i < count; ++i, elements += stride)
+      {
+        for (unsigned r = 0; r < plan.ranges.size(); ++r)
+        {
+          memcpy(elements + plan.ranges[r].offset, data, plan.ranges[r].size);
+          data += plan.ranges[r].size;
+        }
+      }
+      return true;
+    }
+
     class SerializeTypeVisitor
     {
     public:
@@ -442,9 +621,14 @@ namespace qi {
 
       void visitList(AnyIterator it, AnyIterator end)
       {
-        out.beginList(value.size(), static_cast<ListTypeInterface*>(value.type())->elementType()->signature());
-        for (; it != end; ++it)
-          serialize(*it, out, serializeObjectCb, streamContext);
+        ListTypeInterface* type = static_cast<ListTypeInterface*>(value.type());
+        size_t size = value.size();
+        out.beginList(size, type->elementType()->signature());
+        if (!serializeFlatList(type, value.rawValue(), size, out))
+        {
+          for (; it != end; ++it)
+            serialize(*it, out, serializeObjectCb, streamContext);
+        }
         out.endList();
       }
 
@@ -520,7 +704,20 @@ namespace qi {
 
       void visitRaw(AnyReference raw)
       {
-        out.writeRaw(raw.to<Buffer>());
+        Buffer buffer = raw.to<Buffer>();
+        if (streamContext && SharedMemoryBuffer::enabled()
+            && buffer.size() >= SharedMemoryBuffer::threshold()
+            && buffer.subBuffers().empty()
+            && streamContext->sharedCapability<bool>(SharedMemoryBuffer::capabilityName, false))
+        {
+          std::string segment = SharedMemoryBuffer::exportBuffer(buffer);
+          if (!segment.empty())
+          {
+            out.writeSharedRaw(segment, buffer.size());
+            return;
+          }
+        }
+        out.writeRaw(buffer);
       }
 
       void visitIterator(AnyReference)
@@ -639,6 +836,8 @@ namespace qi {
         in.read(sz);
         if (in.status() != BinaryDecoder::Status::Ok)
           return;
+        if (deserializeFlatList(result, sz, in))
+          return;
         for (unsigned i = 0; i < sz; ++i)
         {
           AnyReference v = deserialize(elementType, in, context, streamContext);
@@ -762,8 +961,12 @@ namespace qi {
       void visitRaw(AnyReference)
       {
         Buffer b;
-        in.read(b);
-        result.setRaw((char*)b.data(), b.size());
+        in.read(b, streamContext);
+        // Share the storage rather than copying it, a mapped segment stays mapped
+        if (result.type()->info() == typeOf<Buffer>()->info())
+          *result.ptr<Buffer>(false) = b;
+        else
+          result.setRaw((char*)b.data(), b.size());
       }
       AnyReference result;
       BinaryDecoder& in;
@@ -773,8 +976,11 @@ namespace qi {
 
     void serialize(AnyReference val, BinaryEncoder& out, SerializeObjectCallback context, StreamContext* sctx)
     {
-      detail::SerializeTypeVisitor stv(out, context, val, sctx);
-      qi::typeDispatch(stv, val);
+      if (!serializeFlat(val, out))
+      {
+        detail::SerializeTypeVisitor stv(out, context, val, sctx);
+        qi::typeDispatch(stv, val);
+      }
       if (out.status() != BinaryEncoder::Status::Ok) {
         std::stringstream ss;
         ss << "OSerialization error " << BinaryEncoder::statusToStr(out.status());
@@ -786,7 +992,8 @@ namespace qi {
     {
       detail::DeserializeTypeVisitor dtv(in, context, sctx);
       dtv.result = what;
-      qi::typeDispatch(dtv, dtv.result);
+      if (!deserializeFlat(dtv.result, in))
+        qi::typeDispatch(dtv, dtv.result);
       if (in.status() != BinaryDecoder::Status::Ok) {
         std::stringstream ss;
         ss << "ISerialization error " << BinaryDecoder::statusToStr(in.status());
@@ -810,8 +1017,11 @@ namespace qi {
 
   void encodeBinary(qi::Buffer *buf, const qi::AutoAnyReference &gvp, SerializeObjectCallback onObject, StreamContext* sctx) {
     BinaryEncoder be(*buf);
-    detail::SerializeTypeVisitor stv(be, onObject, gvp, sctx);
-    qi::typeDispatch(stv, gvp);
+    if (!detail::serializeFlat(gvp, be))
+    {
+      detail::SerializeTypeVisitor stv(be, onObject, gvp, sctx);
+      qi::typeDispatch(stv, gvp);
+    }
     if (be.status() != BinaryEncoder::Status::Ok) {
       std::stringstream ss;
       ss << "OSerialization error " << static_cast<int>(be.status());
@@ -825,7 +1035,8 @@ namespace qi {
     BinaryDecoder in(buf);
     detail::DeserializeTypeVisitor dtv(in, onObject, sctx);
     dtv.result = gvp;
-    qi::typeDispatch(dtv, dtv.result);
+    if (!detail::deserializeFlat(dtv.result, in))
+      qi::typeDispatch(dtv, dtv.result);
     if (in.status() != BinaryDecoder::Status::Ok) {
       std::stringstream ss;
       ss << "ISerialization error " << static_cast<int>(in.status());
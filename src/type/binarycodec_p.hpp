@@ -64,7 +64,8 @@ namespace qi {
     void read(double   &d);
     void read(std::string& i);
 
-    void read(qi::Buffer &buffer);
+    /// Buffers sent through shared memory are only accepted if ctx negotiated it
+    void read(qi::Buffer &buffer, StreamContext* ctx = 0);
 
     template<typename T> void read(T& v);
 
@@ -130,6 +131,8 @@ namespace qi {
 
     void writeValue(const AnyReference &value, boost::function<void()> recurse = boost::function<void()>());
     void writeRaw(const Buffer &buffer);
+    /// Write a raw buffer of given size stored in a SharedMemoryBuffer segment
+    void writeSharedRaw(const std::string& segment, qi::uint32_t size);
 
     template<typename T>
     void write(const T &v);
@@ -19,6 +19,53 @@ namespace qi {
 
   qi::Atomic<int> MetaObjectPrivate::uid = 1;
 
+  std::size_t OverloadResolutionCache::index(const std::string& name, const GenericFunctionParameters& args)
+  {
+    std::size_t hash = std::hash<std::string>()(name);
+    for (unsigned i = 0; i < args.size(); ++i)
+      hash = hash * 31 + (reinterpret_cast<std::size_t>(args[i].type()) >> 4);
+    return hash % size;
+  }
+
+  bool OverloadResolutionCache::matches(const Entry& entry, const std::string& name, const GenericFunctionParameters& args)
+  {
+    if (entry.uid < 0 || entry.types.size() != args.size())
+      return false;
+    for (unsigned i = 0; i < args.size(); ++i)
+      if (entry.types[i] != args[i].type())
+        return false;
+    return entry.name == name;
+  }
+
+  int OverloadResolutionCache::find(const std::string& name, const GenericFunctionParameters& args) const
+  {
+    if (_entries.empty())
+      return -1;
+    const Entry& entry = _entries[index(name, args)];
+    return matches(entry, name, args) ? entry.uid : -1;
+  }
+
+  void OverloadResolutionCache::set(const std::string& name, const GenericFunctionParameters& args, int uid,
+                                    unsigned int generation)
+  {
+    if (generation != _generation)
+      return;
+    if (_entries.empty())
+      _entries.resize(size);
+    Entry& entry = _entries[index(name, args)];
+    entry.name = name;
+    entry.types.resize(args.size());
+    for (unsigned i = 0; i < args.size(); ++i)
+      entry.types[i] = args[i].type();
+    entry.uid = uid;
+  }
+
+  void OverloadResolutionCache::clear()
+  {
+    _entries.clear();
+    ++_generation;
+  }
+
   MetaObjectPrivate::MetaObjectPrivate(const MetaObjectPrivate &rhs)
   {
     (*this) = rhs;
@@ -141,6 +188,17 @@ namespace qi {
     }
   };
 
+  // Keep a resolution made from the types of the arguments only, without
+  // looking at their dynamic values, for the next calls
+  static int rememberResolution(OverloadResolutionCache& cache, const std::string& name,
+                                const GenericFunctionParameters& args, bool typesOnly,
+                                unsigned int generation, int uid)
+  {
+    if (typesOnly)
+      cache.set(name, args, uid, generation);
+    return uid;
+  }
+
   /*
    * return a negative value on error
    *  -1 : no method found
@@ -152,6 +210,7 @@ namespace qi {
     // We can keep this outside the lock because we assume MetaMethods can't be
     // removed
     MetaMethod* firstOverload = nullptr;
+    unsigned int generation = 0;
     {
       boost::recursive_mutex::scoped_lock sl(_methodsMutex);
       if (_dirtyCache)
@@ -160,21 +219,21 @@ namespace qi {
       { // full name and signature was given, there can be only one match
         if (canCache)
           *canCache = true;
-        NameToIdx::const_iterator itRev = _methodsNameToIdx.find(nameWithOptionalSignature);
-        if (itRev == _methodsNameToIdx.end()) {
+        const unsigned int* id = _methodsNameToIdx.find(nameWithOptionalSignature);
+        if (!id) {
           std::string funname = qi::signatureSplit(nameWithOptionalSignature)[1];
           // check if it's no method found, or if it's arguments mismatch
-          if (_methodNameToOverload.find(funname) != _methodNameToOverload.end()) {
+          if (_methodNameToOverload.find(funname)) {
             return -2;
           }
           return -1;
         }
         else
-          return itRev->second;
+          return *id;
       }
       // Only name given, try to find an unique match with given argument count
-      OverloadMap::const_iterator overloadIt = _methodNameToOverload.find(nameWithOptionalSignature);
-      if (overloadIt == _methodNameToOverload.end())
+      MetaMethod* const* overload = _methodNameToOverload.find(nameWithOptionalSignature);
+      if (!overload)
       { // no match for the name, no chance
         if (canCache)
           *canCache = true;
@@ -183,7 +242,7 @@ namespace qi {
       MetaMethod* firstMatch = nullptr;
       bool ambiguous = false;
       size_t nargs = args.size();
-      for (MetaMethod* mm = overloadIt->second; mm; mm=mm->_p->next)
+      for (MetaMethod* mm = *overload; mm; mm=mm->_p->next)
       {
         assert(mm->name() == nameWithOptionalSignature);
         const Signature& sig = mm->parametersSignature();
@@ -211,7 +270,12 @@ namespace qi {
 
         return firstMatch->uid();
       }
-      firstOverload = overloadIt->second;
+      // already resolved for arguments of the same types
+      int resolved = _overloadResolutions.find(nameWithOptionalSignature, args);
+      if (resolved >= 0)
+        return resolved;
+      firstOverload = *overload;
+      generation = _overloadResolutions.generation();
     }
 
     int retval = -2;
@@ -227,9 +291,9 @@ namespace qi {
         std::string fullSig = nameWithOptionalSignature + "::" + resolvedSig;
         qiLogDebug() << "Finding method for resolved signature " << fullSig;
         // First try an exact match, which is much faster if we're lucky.
-        NameToIdx::const_iterator itRev =  _methodsNameToIdx.find(nameWithOptionalSignature);
-        if (itRev != _methodsNameToIdx.end())
-          return itRev->second;
+        const unsigned int* id = _methodsNameToIdx.find(fullSig);
+        if (id)
+          return rememberResolution(_overloadResolutions, nameWithOptionalSignature, args, dyn == 0, generation, *id);
 
         using MethodsPtr = std::vector<std::pair<const MetaMethod*, float>>;
         MethodsPtr mml;
@@ -245,7 +309,7 @@ namespace qi {
         if (mml.empty())
           continue;
         if (mml.size() == 1)
-          return mml.front().first->uid();
+          return rememberResolution(_overloadResolutions, nameWithOptionalSignature, args, dyn == 0, generation, mml.front().first->uid());
 
         // get best match
         MethodsPtr::iterator it = std::max_element(mml.begin(), mml.end(), less_pair_second());
@@ -260,7 +324,7 @@ namespace qi {
           qiLogVerbose() << generateErrorString(nameWithOptionalSignature, fullSig, const_cast<MetaObjectPrivate*>(this)->findCompatibleMethod(nameWithOptionalSignature), -3, false);
           retval = -3;
         } else
-          return it->first->uid();
+          return rememberResolution(_overloadResolutions, nameWithOptionalSignature, args, dyn == 0, generation, it->first->uid());
       }
     }
     return retval;
@@ -313,18 +377,18 @@ namespace qi {
   unsigned int MetaObjectPrivate::addMethod(MetaMethodBuilder& builder, int uid) {
     boost::recursive_mutex::scoped_lock sl(_methodsMutex);
     qi::MetaMethod method = builder.metaMethod();
-    NameToIdx::iterator it = _methodsNameToIdx.find(method.toString());
-    if (it != _methodsNameToIdx.end()) {
-      qiLogWarning() << "Method("<< it->second << ") already defined (and overriden): "
+    const unsigned int* id = _methodsNameToIdx.find(method.toString());
+    if (id) {
+      qiLogWarning() << "Method("<< *id << ") already defined (and overriden): "
                      << method.toString();
-      return it->second;
+      return *id;
     }
 
     if (uid == -1)
       uid = ++_index;
     builder.setUid(uid);
     _methods[uid] = builder.metaMethod();
-    _methodsNameToIdx[method.toString()] = uid;
+    _methodsNameToIdx.set(method.toString(), uid);
     _dirtyCache = true;
     return uid;
   }
@@ -336,18 +400,18 @@ namespace qi {
       throw std::runtime_error("Unexpected full signature " + name);
 #endif
     boost::recursive_mutex::scoped_lock sl(_eventsMutex);
-    NameToIdx::iterator it = _eventsNameToIdx.find(name);
-    if (it != _eventsNameToIdx.end()) {
-      MetaSignal &ms = _events[it->second];
-      qiLogWarning() << "Signal("<< it->second << ") already defined (and overriden): " << ms.toString() << "instead of requested: " << name;
-      return it->second;
+    const unsigned int* id = _eventsNameToIdx.find(name);
+    if (id) {
+      MetaSignal &ms = _events[*id];
+      qiLogWarning() << "Signal("<< *id << ") already defined (and overriden): " << ms.toString() << "instead of requested: " << name;
+      return *id;
     }
 
     if (uid == -1)
       uid = ++_index;
     MetaSignal ms(uid, name, signature);
     _events[uid] = ms;
-    _eventsNameToIdx[name] = uid;
+    _eventsNameToIdx.set(name, uid);
     _dirtyCache = true;
     return uid;
   }
@@ -384,7 +448,7 @@ namespace qi {
           return false;
       }
       _methods[newUid] = qi::MetaMethod(newUid, method.second);
-      _methodsNameToIdx[method.second.toString()] = newUid;
+      _methodsNameToIdx.set(method.second.toString(), newUid);
     }
     _dirtyCache = true;
     //todo: update uid
@@ -403,7 +467,7 @@ namespace qi {
           return false;
       }
       _events[newUid] = qi::MetaSignal(newUid, signal.second.name(), signal.second.parametersSignature());
-      _eventsNameToIdx[signal.second.name()] = newUid;
+      _eventsNameToIdx.set(signal.second.name(), newUid);
     }
     _dirtyCache = true;
     //todo: update uid
@@ -439,24 +503,25 @@ namespace qi {
     {
       _methodsNameToIdx.clear();
       _methodNameToOverload.clear();
+      _overloadResolutions.clear();
       for (MetaObject::MethodMap::iterator i = _methods.begin();
         i != _methods.end(); ++i)
       {
         const std::string methodName = i->second.toString();
-        _methodsNameToIdx[methodName] = i->second.uid();
+        _methodsNameToIdx.set(methodName, i->second.uid());
         idx = std::max(idx, i->second.uid());
         buff << methodName << i->second.uid();
 
-        OverloadMap::iterator overloadIt = _methodNameToOverload.find(i->second.name());
-        if (overloadIt == _methodNameToOverload.end())
+        MetaMethod** overload = _methodNameToOverload.find(i->second.name());
+        if (!overload)
         {
-          _methodNameToOverload[i->second.name()] = &i->second;
+          _methodNameToOverload.set(i->second.name(), &i->second);
           i->second._p->next = 0;
         }
         else
         { // push_front
-          i->second._p->next =  overloadIt->second;
-          overloadIt->second = &i->second;
+          i->second._p->next = *overload;
+          *overload = &i->second;
         }
       }
     }
@@ -465,7 +530,7 @@ namespace qi {
       for (MetaObject::SignalMap::iterator i = _events.begin();
         i != _events.end(); ++i)
       {
-        _eventsNameToIdx[i->second.name()] = i->second.uid();
+        _eventsNameToIdx.set(i->second.name(), i->second.uid());
         idx = std::max(idx, i->second.uid());
         buff << i->second.name() << i->second.uid();
       }
@@ -14,8 +14,52 @@
 #include <qi/anyobject.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
+#include "nameindex_p.hpp"
+
 namespace qi {
 
+  /** Methods picked by findMethod() among overloads of the same name and
+   * argument count, from the static types of the arguments. Calls with
+   * arguments of the same types then skip the overload resolution.
+   *
+   * Direct-mapped: a colliding resolution replaces the previous one.
+   */
+  class OverloadResolutionCache
+  {
+  public:
+    OverloadResolutionCache()
+      : _generation(0)
+    {}
+
+    /// @return the uid of the method, or -1 if these types were not resolved yet
+    int find(const std::string& name, const GenericFunctionParameters& args) const;
+    /// Ignored if the cache was cleared since \p generation was read
+    void set(const std::string& name, const GenericFunctionParameters& args, int uid,
+             unsigned int generation);
+    void clear();
+    unsigned int generation() const { return _generation; }
+
+  private:
+    struct Entry
+    {
+      Entry()
+        : uid(-1)
+      {}
+
+      std::string                 name;
+      std::vector<TypeInterface*> types;
+      int                         uid;
+    };
+
+    static const std::size_t size = 256;
+
+    static std::size_t index(const std::string& name, const GenericFunctionParameters& args);
+    static bool matches(const Entry& entry, const std::string& name, const GenericFunctionParameters& args);
+
+    std::vector<Entry> _entries; // allocated on first set()
+    unsigned int       _generation;
+  };
+
   class MetaObjectPrivate {
   public:
     //by default we start at qiObjectSpecialMemberMaxUid,
@@ -29,14 +73,14 @@ namespace qi {
     MetaObjectPrivate(const MetaObjectPrivate &rhs);
     MetaObjectPrivate&  operator=(const MetaObjectPrivate &rhs);
 
-    using NameToIdx = std::map<std::string, unsigned int>;
+    using NameToIdx = NameIndex<unsigned int>;
 
     inline int idFromName(const NameToIdx& map, const std::string& name) {
-      NameToIdx::const_iterator it = map.find(name);
-      if (it == map.end())
+      const unsigned int* id = map.find(name);
+      if (!id)
         return -1;
       else
-        return it->second;
+        return *id;
     }
 
     inline int methodId(const std::string &name) {
@@ -95,8 +139,10 @@ namespace qi {
     mutable boost::recursive_mutex      _methodsMutex;
 
   public:
-    using OverloadMap = std::map<std::string, MetaMethod*>;
+    //name -> first overload, the others follow MetaMethodPrivate::next
+    using OverloadMap = NameIndex<MetaMethod*>;
     OverloadMap                         _methodNameToOverload;
+    mutable OverloadResolutionCache     _overloadResolutions;
 
     //name::sig() -> Index
     NameToIdx                           _eventsNameToIdx;
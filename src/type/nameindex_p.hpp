@@ -0,0 +1,124 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _SRC_NAMEINDEX_P_HPP_
+#define _SRC_NAMEINDEX_P_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace qi {
+
+  /** Values indexed by name, in an open addressing table probed linearly.
+   *
+   * Lookups hash the name once and compare the names of the slots with the
+   * same hash only, which is what the by-name calls of MetaObject need.
+   * Entries are never removed one by one, only all at once by clear().
+   */
+  template <typename T>
+  class NameIndex
+  {
+  public:
+    NameIndex()
+      : _size(0)
+    {}
+
+    /// @return the value of \p name, or 0 if there is none
+    const T* find(const std::string& name) const
+    {
+      if (_slots.empty())
+        return 0;
+      const std::size_t hash = hashName(name);
+      const std::size_t mask = _slots.size() - 1;
+      for (std::size_t i = hash & mask; _slots[i].used; i = (i + 1) & mask)
+      {
+        if (_slots[i].hash == hash && _slots[i].name == name)
+          return &_slots[i].value;
+      }
+      return 0;
+    }
+
+    T* find(const std::string& name)
+    {
+      return const_cast<T*>(static_cast<const NameIndex*>(this)->find(name));
+    }
+
+    /// Set the value of \p name, replacing the previous one
+    void set(const std::string& name, const T& value)
+    {
+      if (T* v = find(name))
+      {
+        *v = value;
+        return;
+      }
+      // keep at least half of the slots free so that probes stay short
+      if ((_size + 1) * 2 > _slots.size())
+        rehash(_slots.empty() ? 16 : _slots.size() * 2);
+      insert(hashName(name), name, value);
+    }
+
+    void clear()
+    {
+      _slots.clear();
+      _size = 0;
+    }
+
+    std::size_t size() const
+    {
+      return _size;
+    }
+
+  private:
+    struct Slot
+    {
+      Slot()
+        : used(false)
+        , hash(0)
+        , value()
+      {}
+
+      bool        used;
+      std::size_t hash;
+      std::string name;
+      T           value;
+    };
+
+    static std::size_t hashName(const std::string& name)
+    {
+      return std::hash<std::string>()(name);
+    }
+
+    void insert(std::size_t hash, const std::string& name, const T& value)
+    {
+      const std::size_t mask = _slots.size() - 1;
+      std::size_t i = hash & mask;
+      while (_slots[i].used)
+        i = (i + 1) & mask;
+      _slots[i].used = true;
+      _slots[i].hash = hash;
+      _slots[i].name = name;
+      _slots[i].value = value;
+      ++_size;
+    }
+
+    void rehash(std::size_t capacity)
+    {
+      std::vector<Slot> slots(capacity);
+      _slots.swap(slots);
+      _size = 0;
+      for (unsigned i = 0; i < slots.size(); ++i)
+        if (slots[i].used)
+          insert(slots[i].hash, slots[i].name, slots[i].value);
+    }
+
+    std::vector<Slot> _slots; // size is a power of two
+    std::size_t       _size;
+  };
+
+}
+
+#endif  // _SRC_NAMEINDEX_P_HPP_
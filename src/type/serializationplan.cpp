@@ -0,0 +1,223 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <map>
+#include <set>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+
+#include <qi/atomic.hpp>
+#include <qi/log.hpp>
+#include <qi/type/typeinterface.hpp>
+
+#include "serializationplan_p.hpp"
+
+qiLogCategory("qitype.serializationplan");
+
+namespace qi {
+
+  namespace
+  {
+    boost::mutex& plainStructsMutex()
+    {
+      static boost::mutex mutex;
+      return mutex;
+    }
+
+    std::set<TypeInterface*>& plainStructs()
+    {
+      static std::set<TypeInterface*> types;
+      return types;
+    }
+
+    bool isPlainStruct(TypeInterface* type)
+    {
+      boost::mutex::scoped_lock lock(plainStructsMutex());
+      return plainStructs().count(type) != 0;
+    }
+
+    // Lock-free lookup table in front of the plans, probed linearly
+    const std::size_t planCacheSize = 1024;
+    const std::size_t planCacheProbes = 8;
+
+    qi::Atomic<const SerializationPlan*>* planCache()
+    {
+      static qi::Atomic<const SerializationPlan*> cache[planCacheSize];
+      return cache;
+    }
+
+    std::size_t planCacheIndex(TypeInterface* type, std::size_t probe)
+    {
+      return ((reinterpret_cast<std::size_t>(type) >> 4) + probe) % planCacheSize;
+    }
+
+    template <typename T>
+    bool isScalar(TypeInterface* type, std::size_t& size)
+    {
+      if (type->info() != typeOf<T>()->info())
+        return false;
+      size = sizeof(T);
+      return true;
+    }
+
+    // Scalars stored natively, which the codec writes as they are in memory.
+    // bool is left out: a byte read from the wire is not always a valid bool.
+    bool scalarSize(TypeInterface* type, std::size_t& size)
+    {
+      switch (type->kind())
+      {
+      case TypeKind_Int:
+        return isScalar<char>(type, size)
+            || isScalar<signed char>(type, size)
+            || isScalar<unsigned char>(type, size)
+            || isScalar<short>(type, size)
+            || isScalar<unsigned short>(type, size)
+            || isScalar<int>(type, size)
+            || isScalar<unsigned int>(type, size)
+            || isScalar<long>(type, size)
+            || isScalar<unsigned long>(type, size)
+            || isScalar<long long>(type, size)
+            || isScalar<unsigned long long>(type, size);
+      case TypeKind_Float:
+        return isScalar<float>(type, size)
+            || isScalar<double>(type, size);
+      default:
+        return false;
+      }
+    }
+
+    void addRange(SerializationPlan& plan, std::size_t offset, std::size_t size)
+    {
+      if (!plan.ranges.empty())
+      {
+        SerializationPlan::Range& last = plan.ranges.back();
+        if (last.offset + last.size == offset)
+        {
+          last.size += size;
+          plan.size += size;
+          return;
+        }
+      }
+      SerializationPlan::Range range = { offset, size };
+      plan.ranges.push_back(range);
+      plan.size += size;
+    }
+
+    // Offsets of the fields of a new instance, false if it is not stored by pointer
+    bool fieldOffsets(StructTypeInterface* type, const std::vector<TypeInterface*>& members,
+                      void* storage, std::vector<std::ptrdiff_t>& offsets)
+    {
+      char* base = static_cast<char*>(type->ptrFromStorage(&storage));
+      if (base != storage)
+        return false;
+      for (unsigned i = 0; i < members.size(); ++i)
+      {
+        void* field = type->get(storage, i);
+        offsets.push_back(static_cast<char*>(members[i]->ptrFromStorage(&field)) - base);
+      }
+      return true;
+    }
+
+    void buildPlan(TypeInterface* type, SerializationPlan& plan)
+    {
+      plan.type = type;
+      std::size_t size = 0;
+      if (scalarSize(type, size))
+      {
+        plan.flat = true;
+        plan.inPlace = true;
+        addRange(plan, 0, size);
+        return;
+      }
+      if (type->kind() != TypeKind_Tuple)
+        return;
+
+      StructTypeInterface* structType = static_cast<StructTypeInterface*>(type);
+      std::vector<TypeInterface*> members = structType->memberTypes();
+      plan.signature = makeTupleSignature(members);
+      for (unsigned i = 0; i < members.size(); ++i)
+        if (!members[i] || !serializationPlan(members[i]).flat)
+          return;
+
+      // Fields must be inside the value at fixed offsets, which rules out
+      // dynamic tuples, whose fields are allocated separately. Both
+      // instances are alive together so that they cannot share addresses.
+      void* first = structType->initializeStorage();
+      void* second = structType->initializeStorage();
+      std::vector<std::ptrdiff_t> offsets;
+      std::vector<std::ptrdiff_t> otherOffsets;
+      bool fixed = first && second
+                && fieldOffsets(structType, members, first, offsets)
+                && fieldOffsets(structType, members, second, otherOffsets)
+                && offsets == otherOffsets;
+      if (first)
+        structType->destroy(first);
+      if (second)
+        structType->destroy(second);
+      if (!fixed)
+        return;
+
+      for (unsigned i = 0; i < members.size(); ++i)
+      {
+        if (offsets[i] < 0)
+          return;
+        const SerializationPlan& member = serializationPlan(members[i]);
+        for (unsigned r = 0; r < member.ranges.size(); ++r)
+          addRange(plan, offsets[i] + member.ranges[r].offset, member.ranges[r].size);
+      }
+      plan.flat = true;
+      plan.inPlace = isPlainStruct(type);
+      for (unsigned i = 0; i < members.size(); ++i)
+        plan.inPlace = plan.inPlace && serializationPlan(members[i]).inPlace;
+      qiLogDebug() << "Flat serialization of " << type->infoString() << " in "
+                   << plan.ranges.size() << " copies of " << plan.size << " bytes"
+                   << (plan.inPlace ? "" : ", decoded field by field");
+    }
+
+    const SerializationPlan& buildCachedPlan(TypeInterface* type)
+    {
+      static boost::recursive_mutex mutex;
+      static std::map<TypeInterface*, SerializationPlan*> plans;
+
+      // recursive, since plans of structs need the ones of their fields
+      boost::recursive_mutex::scoped_lock lock(mutex);
+      std::map<TypeInterface*, SerializationPlan*>::iterator it = plans.find(type);
+      if (it != plans.end())
+        return *it->second;
+      SerializationPlan* plan = new SerializationPlan();
+      buildPlan(type, *plan);
+      plans[type] = plan;
+
+      // when the table is full, the plan is found in plans under the lock
+      qi::Atomic<const SerializationPlan*>* cache = planCache();
+      for (std::size_t probe = 0; probe < planCacheProbes; ++probe)
+        if (cache[planCacheIndex(type, probe)].setIfEquals(0, plan))
+          break;
+      return *plan;
+    }
+  }
+
+  void registerPlainStruct(TypeInterface* type)
+  {
+    boost::mutex::scoped_lock lock(plainStructsMutex());
+    plainStructs().insert(type);
+  }
+
+  const SerializationPlan& serializationPlan(TypeInterface* type)
+  {
+    qi::Atomic<const SerializationPlan*>* cache = planCache();
+    for (std::size_t probe = 0; probe < planCacheProbes; ++probe)
+    {
+      const SerializationPlan* plan = *cache[planCacheIndex(type, probe)];
+      if (!plan)
+        break;
+      if (plan->type == type)
+        return *plan;
+    }
+    return buildCachedPlan(type);
+  }
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _SRC_SERIALIZATIONPLAN_P_HPP_
+#define _SRC_SERIALIZATIONPLAN_P_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include <qi/signature.hpp>
+#include <qi/type/typeinterface.hpp>
+
+namespace qi {
+
+  /** How the values of a type are laid out on the wire, computed once per
+   * TypeInterface by the binary codec.
+   *
+   * A flat type is a scalar, or a struct or tuple of flat types, whose
+   * fields are stored at the same offsets in every instance: its values are
+   * written as a few memcpy of byte ranges of their storage instead of being
+   * visited field by field. They are read the same way only if writing the
+   * fields in place is what StructTypeInterface::set() would do, which is the
+   * case of QI_TYPE_STRUCT but not of QI_TYPE_STRUCT_EX, whose hook would be
+   * skipped, nor of QI_TYPE_STRUCT_AGREGATE_CONSTRUCTOR.
+   */
+  struct SerializationPlan
+  {
+    /// A byte range of the storage, copied as is on the wire.
+    struct Range
+    {
+      std::size_t offset;
+      std::size_t size;
+    };
+
+    SerializationPlan()
+      : type(0)
+      , flat(false)
+      , inPlace(false)
+      , size(0)
+    {}
+
+    TypeInterface*     type;
+    bool               flat;
+    // Values may be decoded by copying the ranges into their storage
+    bool               inPlace;
+    // Ranges in wire order, adjacent ones merged
+    std::vector<Range> ranges;
+    // Size of a value on the wire
+    std::size_t        size;
+    // Signature given to BinaryEncoder::beginTuple for tuples
+    Signature          signature;
+  };
+
+  /// @return the plan of \p type, built on first use and never freed.
+  const SerializationPlan& serializationPlan(TypeInterface* type);
+
+}
+
+#endif  // _SRC_SERIALIZATIONPLAN_P_HPP_
@@ -7,6 +7,7 @@
 
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/pool/pool_alloc.hpp>
 
 #include <qi/signal.hpp>
 #include <qi/anyvalue.hpp>
@@ -28,7 +29,9 @@ namespace qi {
   }
 
   SignalSubscriber::SignalSubscriber(const AnyObject& target, unsigned int method)
-    : threadingModel(MetaCallType_Direct)
+    : source(0)
+    , linkId(SignalBase::invalidSignalLink)
+    , threadingModel(MetaCallType_Direct)
     , target(new AnyWeakObject(target))
     , method(method)
     , enabled(true)
@@ -37,12 +40,12 @@ namespace qi {
   }
 
   SignalSubscriber::SignalSubscriber(AnyFunction func, MetaCallType model)
-     : handler(func), threadingModel(model), target(0), method(0), enabled(true), executionContext(0)
+     : source(0), linkId(SignalBase::invalidSignalLink), handler(func), threadingModel(model), target(0), method(0), enabled(true), executionContext(0)
   {
   }
 
   SignalSubscriber::SignalSubscriber(AnyFunction func, ExecutionContext* ec)
-     : handler(func), threadingModel(MetaCallType_Direct), target(0), method(0), enabled(true), executionContext(ec)
+     : source(0), linkId(SignalBase::invalidSignalLink), handler(func), threadingModel(MetaCallType_Direct), target(0), method(0), enabled(true), executionContext(ec)
   {
   }
 
@@ -70,6 +73,8 @@ namespace qi {
     method = b.method;
     enabled = b.enabled;
     executionContext = b.executionContext;
+    coalescing = b.coalescing;
+    coalescingMode = *b.coalescingMode;
   }
 
   static qi::Atomic<int> linkUid = 1;
@@ -83,6 +88,18 @@ namespace qi {
     _p->defaultCallType = callType;
   }
 
+  void SignalBase::setCoalescing(const SignalCoalescing& policy)
+  {
+    if (policy.mode == SignalCoalescing::Mode_Batch)
+      throw std::runtime_error("Batched coalescing can only be set on a subscriber");
+    if (!_p)
+    {
+      _p = boost::make_shared<SignalBasePrivate>();
+    }
+    boost::recursive_mutex::scoped_lock sl(_p->mutex);
+    _p->coalescing = policy;
+  }
+
   void SignalBase::operator()(
       qi::AutoAnyReference p1,
       qi::AutoAnyReference p2,
@@ -141,89 +158,111 @@ namespace qi {
 
     if (mct == qi::MetaCallType_Auto)
       mct = _p->defaultCallType;
-    SignalSubscriberMap copy;
-    {
-      boost::recursive_mutex::scoped_lock sl(_p->mutex);
-      copy = _p->subscriberMap;
-    }
-    qiLogDebug() << (void*)this << " Invoking signal subscribers: " << copy.size();
-    for (auto& i: copy)
+    // The snapshot holds the subscribers alive, and is never modified
+    boost::shared_ptr<const SignalSubscriberSnapshot> snapshot = boost::atomic_load(&_p->snapshot);
+    if (!snapshot)
+      return;
+    qiLogDebug() << (void*)this << " Invoking signal subscribers: " << snapshot->size();
+    SignalQueuedArguments queued;
+    queued.owner = snapshot;
+    for (const SignalSubscriberPtr& s: *snapshot)
     {
       qiLogDebug() << (void*)this << " Invoking signal subscriber";
-      SignalSubscriberPtr s = i.second; // hold s alive
-      s->call(params, mct);
+      s->call(params, mct, queued);
     }
     qiLogDebug() << (void*)this << " done invoking signal subscribers";
   }
 
-  class FunctorCall
+  namespace
   {
-  public:
-    FunctorCall(GenericFunctionParameters* params, SignalSubscriberPtr* sub)
-    : params(params)
-    , sub(sub)
+    // Pooled envelope of SignalQueuedArguments::params
+    struct QueuedParameters
     {
+      QueuedParameters(const GenericFunctionParameters& args, const boost::shared_ptr<const void>& owner)
+        : params(args.copy())
+        , owner(owner)
+      {}
+      ~QueuedParameters()
+      {
+        params.destroy();
+      }
+      GenericFunctionParameters     params;
+      boost::shared_ptr<const void> owner;
+    };
+
+    boost::shared_ptr<GenericFunctionParameters> queueParameters(const GenericFunctionParameters& args,
+                                                                 const boost::shared_ptr<const void>& owner)
+    {
+      boost::shared_ptr<QueuedParameters> queued = boost::allocate_shared<QueuedParameters>(
+          boost::fast_pool_allocator<QueuedParameters>(), args, owner);
+      return boost::shared_ptr<GenericFunctionParameters>(queued, &queued->params);
     }
+  }
 
-    FunctorCall(const FunctorCall& b)
+  // Call the handler of sub from a queued or coalesced call
+  static void callQueued(SignalSubscriber& sub, const GenericFunctionParameters& params)
+  {
+    try
+    {
+      {
+        boost::mutex::scoped_lock sl(sub.mutex);
+        // verify-enabled-then-register-active op must be locked
+        if (!sub.enabled)
+          return;
+        sub.addActive(false);
+      } // end mutex-protected scope
+      sub.handler(params);
+    }
+    catch(const qi::PointerLockException&)
     {
-      *this = b;
+      qiLogDebug() << "PointerLockFailure excepton, will disconnect";
+    }
+    catch(const std::exception& e)
+    {
+      qiLogWarning() << "Exception caught from signal subscriber: " << e.what();
+    }
+    catch (...) {
+      qiLogWarning() << "Unknown exception caught from signal subscriber";
     }
 
-    void operator=(const FunctorCall& b)
+    sub.removeActive(true);
+  }
+
+  class FunctorCall
+  {
+  public:
+    // params keeps sub alive, and the functor small enough to be stored in
+    // place by boost::function
+    FunctorCall(const boost::shared_ptr<GenericFunctionParameters>& params, SignalSubscriber* sub)
+    : params(params)
+    , sub(sub)
     {
-      params = b.params;
-      sub = b.sub;
     }
 
     void operator() ()
     {
-      try
-      {
-        {
-          SignalSubscriberPtr s;
-          boost::mutex::scoped_lock sl((*sub)->mutex);
-          // verify-enabled-then-register-active op must be locked
-          if (!(*sub)->enabled)
-          {
-            s = *sub; // delay destruction until after we leave the scoped_lock
-            delete sub;
-            params->destroy();
-            delete params;
-            return;
-          }
-          (*sub)->addActive(false);
-        } // end mutex-protected scope
-        (*sub)->handler(*params);
-      }
-      catch(const qi::PointerLockException&)
-      {
-        qiLogDebug() << "PointerLockFailure excepton, will disconnect";
-      }
-      catch(const std::exception& e)
-      {
-        qiLogWarning() << "Exception caught from signal subscriber: " << e.what();
-      }
-      catch (...) {
-        qiLogWarning() << "Unknown exception caught from signal subscriber";
-      }
-
-      (*sub)->removeActive(true);
-      params->destroy();
-      delete params;
-      delete sub;
+      callQueued(*sub, *params);
     }
 
   public:
-    GenericFunctionParameters* params;
-    SignalSubscriberPtr*         sub;
+    boost::shared_ptr<GenericFunctionParameters> params;
+    SignalSubscriber*                            sub;
   };
 
   void SignalSubscriber::call(const GenericFunctionParameters& args, MetaCallType callType)
+  {
+    SignalQueuedArguments queued;
+    call(args, callType, queued);
+  }
+
+  void SignalSubscriber::call(const GenericFunctionParameters& args, MetaCallType callType,
+                              SignalQueuedArguments& queued)
   {
     // this is held alive by caller
     if (handler)
     {
+      if (coalesce(args))
+        return;
       bool async = true;
       if (threadingModel != MetaCallType_Auto)
         async = (threadingModel == MetaCallType_Queued);
@@ -233,7 +272,12 @@ namespace qi {
       qiLogDebug() << "subscriber call async=" << async <<" ct " << callType <<" tm " << threadingModel;
       if (executionContext || async)
       {
-        GenericFunctionParameters* copy = new GenericFunctionParameters(args.copy());
+        if (!queued.params)
+        {
+          if (!queued.owner)
+            queued.owner = shared_from_this();
+          queued.params = queueParameters(args, queued.owner);
+        }
         // We will check enabled when we will be scheduled in the target
         // thread, and we hold this SignalSubscriber alive, so no need to
         // explicitly track the asynccall
@@ -246,7 +290,7 @@ namespace qi {
           if (!ec) // this is an assert basicaly, no sense trying to do something clever.
             throw std::runtime_error("Event loop was destroyed");
         }
-        ec->post(FunctorCall(copy, new SignalSubscriberPtr(shared_from_this())));
+        ec->post(FunctorCall(queued.params, this));
       }
       else
       {
@@ -313,6 +357,63 @@ namespace qi {
     }
   }
 
+  bool SignalSubscriber::coalesce(const GenericFunctionParameters& args)
+  {
+    // checked without the lock, not to contend with the other triggers
+    if (*coalescingMode == SignalCoalescing::Mode_None)
+      return false;
+    qi::SteadyClockTimePoint flushTime;
+    {
+      // the policy can be changed after connection, read it under the lock
+      boost::mutex::scoped_lock sl(mutex);
+      if (coalescing.mode == SignalCoalescing::Mode_None)
+        return false;
+      if (!enabled)
+        return true;
+      if (!coalesced)
+        coalesced = boost::make_shared<SignalCoalescedCalls>();
+      if (coalescing.mode == SignalCoalescing::Mode_Batch)
+        coalesced->batch.push_back(AnyValue(makeGenericTuple(args), false, true));
+      else
+        coalesced->latest = queueParameters(args, boost::shared_ptr<const void>());
+      if (coalesced->flushPending)
+        return true;
+      coalesced->flushPending = true;
+      flushTime = coalesced->lastFlush + coalescing.period;
+    }
+    qi::ExecutionContext* ec = executionContext;
+    if (!ec)
+    {
+      ec = getEventLoop();
+      if (!ec)
+        throw std::runtime_error("Event loop was destroyed");
+    }
+    // the flush holds this alive, and finds the calls to make in coalesced
+    ec->asyncAt(boost::bind(&SignalSubscriber::flushCoalesced, shared_from_this()), flushTime);
+    return true;
+  }
+
+  void SignalSubscriber::flushCoalesced()
+  {
+    boost::shared_ptr<GenericFunctionParameters> latest;
+    std::vector<AnyValue> batch;
+    {
+      boost::mutex::scoped_lock sl(mutex);
+      coalesced->flushPending = false;
+      coalesced->lastFlush = qi::SteadyClock::now();
+      latest.swap(coalesced->latest);
+      batch.swap(coalesced->batch);
+    }
+    if (latest)
+      callQueued(*this, *latest);
+    if (!batch.empty())
+    {
+      GenericFunctionParameters params;
+      params.push_back(AnyReference::from(batch));
+      callQueued(*this, params);
+    }
+  }
+
   //check if we are called from the same thread that triggered us.
   //in that case, do not wait.
   void SignalSubscriber::waitForInactive()
@@ -410,7 +511,9 @@ namespace qi {
     if (subSignature.isValid())
       subArity = subSignature.children().size();
 
-    if (signature() != "m" && subSignature.isValid())
+    // batched subscribers take the list of the arguments of the triggers
+    if (signature() != "m" && subSignature.isValid()
+        && src.coalescing.mode != SignalCoalescing::Mode_Batch)
     {
       if (sigArity != subArity)
       {
@@ -433,8 +536,14 @@ namespace qi {
     SignalSubscriberPtr s = boost::make_shared<SignalSubscriber>(src);
     s->linkId = res;
     s->source = this;
+    if (s->coalescing.mode == SignalCoalescing::Mode_None)
+    {
+      s->coalescing = _p->coalescing;
+      s->coalescingMode = s->coalescing.mode;
+    }
     bool first = _p->subscriberMap.empty();
     _p->subscriberMap[res] = s;
+    _p->updateSnapshot();
     if (first && _p->onSubscribers)
       _p->onSubscribers(true);
     return *s.get();
@@ -456,7 +565,8 @@ namespace qi {
     if (it == _p->trackMap.end())
       return;
 
-    _p->subscriberMap.erase(it->second);
+    if (_p->subscriberMap.erase(it->second))
+      _p->updateSnapshot();
     _p->trackMap.erase(it);
   }
 
@@ -513,6 +623,7 @@ namespace qi {
       s = it->second;
       // Remove from map (but SignalSubscriber object still good)
       subscriberMap.erase(it);
+      updateSnapshot();
       // Acquire subscriber mutex before releasing mutex
       boost::mutex::scoped_lock subLock(s->mutex);
       // Release signal mutex
@@ -537,6 +648,20 @@ namespace qi {
     return true;
   }
 
+  void SignalBasePrivate::updateSnapshot()
+  {
+    boost::shared_ptr<const SignalSubscriberSnapshot> updated;
+    if (!subscriberMap.empty())
+    {
+      boost::shared_ptr<SignalSubscriberSnapshot> subscribers = boost::make_shared<SignalSubscriberSnapshot>();
+      subscribers->reserve(subscriberMap.size());
+      for (const auto& i: subscriberMap)
+        subscribers->push_back(i.second);
+      updated = subscribers;
+    }
+    boost::atomic_store(&snapshot, updated);
+  }
+
   bool SignalBase::disconnect(const SignalLink &link) {
     if (!_p)
       return false;
@@ -576,8 +701,7 @@ namespace qi {
   {
     if (!_p)
       return false;
-    boost::recursive_mutex::scoped_lock sl(_p->mutex);
-    return !_p->subscriberMap.empty();
+    return static_cast<bool>(boost::atomic_load(&_p->snapshot));
   }
 
   bool SignalBasePrivate::disconnectAll(bool wait)
@@ -7,15 +7,43 @@
 #ifndef _SRC_SIGNAL_P_HPP_
 #define _SRC_SIGNAL_P_HPP_
 
+#include <vector>
 #include <qi/signal.hpp>
+#include <qi/anyvalue.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
 namespace qi {
 
   using SignalSubscriberMap = std::map<SignalLink, SignalSubscriberPtr>;
+  using SignalSubscriberSnapshot = std::vector<SignalSubscriberPtr>;
   using TrackMap = std::map<int, SignalLink>;
 
+  /// Arguments of a trigger, copied once for all its queued subscribers.
+  struct SignalQueuedArguments
+  {
+    // Keeps the subscribers alive until their queued calls are done
+    boost::shared_ptr<const void> owner;
+    // Copy of the arguments, made by the first queued subscriber
+    boost::shared_ptr<GenericFunctionParameters> params;
+  };
+
+  /// Calls of a coalesced subscriber waiting for the next flush.
+  struct SignalCoalescedCalls
+  {
+    SignalCoalescedCalls()
+      : flushPending(false)
+    {}
+
+    bool                                         flushPending;
+    qi::SteadyClockTimePoint                     lastFlush;
+    // Arguments of the last trigger, in Mode_Latest
+    boost::shared_ptr<GenericFunctionParameters> latest;
+    // Argument tuples of the triggers since the last flush, in Mode_Batch
+    std::vector<AnyValue>                        batch;
+  };
+
   class SignalBasePrivate
   {
   public:
@@ -27,15 +55,21 @@ namespace qi {
     bool disconnectAll(bool wait = true);
     bool disconnect(const SignalLink& l, bool wait = true);
     bool disconnectTrackLink(const SignalLink& l);
+    /// Rebuild the snapshot from subscriberMap, called with mutex held.
+    void updateSnapshot();
 
   public:
     SignalBase::OnSubscribers      onSubscribers;
     SignalSubscriberMap            subscriberMap;
+    // Immutable copy of subscriberMap read by callSubscribers(), replaced
+    // atomically when a subscriber is connected or disconnected
+    boost::shared_ptr<const SignalSubscriberSnapshot> snapshot;
     TrackMap                       trackMap;
     qi::Atomic<int>                trackId;
     qi::Signature                  signature;
     boost::recursive_mutex         mutex;
     MetaCallType                   defaultCallType;
+    SignalCoalescing               coalescing;
     SignalBase::Trigger            triggerOverride;
   };
 
@@ -7,7 +7,10 @@
 #include <qi/signature.hpp>
 #include <qi/type/typeinterface.hpp>
 #include <qi/jsoncodec.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 #include "signatureconvertor.hpp"
 
 qiLogCategory("qitype.signature");
@@ -92,7 +95,7 @@ namespace qi {
 
 #define RET_CALC (1.0f * childErr * ((float)(100 - error)) / 100.0f)
 
-  float qi::Signature::isConvertibleTo(const qi::Signature& b) const
+  static float convertibility(const qi::Signature& a, const qi::Signature& b)
   {
     /* The returned float is just a basic heuristic, it does not handle:
      * - comparison between integral types
@@ -105,27 +108,27 @@ namespace qi {
     static const char floating[] = "fd";
     static const char container[] = "[{(";
 
-    Signature::Type s = type();
+    Signature::Type s = a.type();
     Signature::Type d = b.type();
     //varargs are just vector, handle them that way
-    if (s == Type_VarArgs)
-      s = Type_List;
-    if (d == Type_VarArgs)
-      d = Type_List;
-    if (d == Type_Void)
+    if (s == Signature::Type_VarArgs)
+      s = Signature::Type_List;
+    if (d == Signature::Type_VarArgs)
+      d = Signature::Type_List;
+    if (d == Signature::Type_Void)
       return RET_CALC;
-    if (d == Type_Unknown)
+    if (d == Signature::Type_Unknown)
     {
       // We cannot anwser the question for unknown types. So let it pass
       // and the conversion code will decide.
       // Type_Unknown is not serializable anyway.
-      if (s != Type_Unknown)
+      if (s != Signature::Type_Unknown)
         error += 10; // Weird but can happen with object pointers
       return RET_CALC;
     }
 
-    if (d == Type_Dynamic || // Dynamic can convert to whatever
-        s == Type_None) // None means parent is empty container
+    if (d == Signature::Type_Dynamic || // Dynamic can convert to whatever
+        s == Signature::Type_None) // None means parent is empty container
     {
       error += 5; // big malus for dynamic
       return RET_CALC;
@@ -148,12 +151,12 @@ namespace qi {
     { // Container, list or map
       if (d != s)
         return 0; // Must be same container
-      if (children().size() != b.children().size())
+      if (a.children().size() != b.children().size())
       {
-        if (s != Type_Tuple)
+        if (s != Signature::Type_Tuple)
           return 0;
         // Special case for same-named tuples that might be compatible
-        std::string aSrc = annotation();
+        std::string aSrc = a.annotation();
         std::string aDst = b.annotation();
         // This mode is recommended only for tests where it is more
         // conveniant to have differently named structs
@@ -171,15 +174,15 @@ namespace qi {
       SignatureVector::const_iterator its;
       SignatureVector::const_iterator itd;
       itd = b.children().begin();
-      for (its = children().begin(); its != children().end(); ++its, ++itd) {
-        float childRes = its->isConvertibleTo(*itd);
+      for (its = a.children().begin(); its != a.children().end(); ++its, ++itd) {
+        float childRes = convertibility(*its, *itd);
         if (!childRes)
           return 0; // Just check subtype compatibility
         // we got this far, if there is an error in child, make it lower
         // [s] -> m should have a greater convertibility than [s] -> [m]
         childErr *= 1.0f - (1.0f - childRes) * 0.95f;
       }
-      assert(its==children().end() && itd==b.children().end()); // we already exited on size mismatch
+      assert(its==a.children().end() && itd==b.children().end()); // we already exited on size mismatch
     }
     else if (d != s)
       return 0.0f;
@@ -247,14 +250,79 @@ namespace qi {
 
   class SignaturePrivate {
   public:
+    SignaturePrivate()
+      : _interned(false)
+    {}
+
     void parseChildren(const std::string &signature, size_t index);
     void eatChildren(const std::string &signature, size_t idxStart, size_t expectedEnd, int elementCount);
     void init(const std::string &signature, size_t begin, size_t end);
 
+    /// Parsed signature shared by all the equal signatures, see SignatureCache
+    static boost::shared_ptr<SignaturePrivate> intern(const std::string &signature);
+
     std::string            _signature;
     std::vector<Signature> _children;
+    // Kept by the cache forever, so its address identifies the signature
+    bool                   _interned;
   };
 
+  namespace
+  {
+    /* Parsed signatures by string, and results of isConvertibleTo() by pair
+     * of interned signatures. Entries are never removed, so each shard stops
+     * growing at a fixed size, past which signatures are parsed and compared
+     * each time: signatures received from peers can be anything.
+     */
+    class SignatureCache
+    {
+    public:
+      static const std::size_t ShardCount = 16;
+      static const std::size_t MaxSignaturesPerShard = 256;
+      static const std::size_t MaxConvertibilitiesPerShard = 4096;
+
+      using SignatureMap = boost::unordered_map<std::string, boost::shared_ptr<SignaturePrivate>>;
+      using SignaturePair = std::pair<const SignaturePrivate*, const SignaturePrivate*>;
+      using ConvertibilityMap = boost::unordered_map<SignaturePair, float>;
+
+      struct Shard
+      {
+        boost::mutex      mutex;
+        SignatureMap      signatures;
+        ConvertibilityMap convertibilities;
+      };
+
+      // Leaked, signatures may be used during static destruction
+      static Shard& shard(std::size_t hash)
+      {
+        static Shard* shards = new Shard[ShardCount];
+        return shards[hash % ShardCount];
+      }
+    };
+  }
+
+  boost::shared_ptr<SignaturePrivate> SignaturePrivate::intern(const std::string &signature)
+  {
+    SignatureCache::Shard& shard = SignatureCache::shard(boost::hash<std::string>()(signature));
+    {
+      boost::mutex::scoped_lock lock(shard.mutex);
+      SignatureCache::SignatureMap::const_iterator it = shard.signatures.find(signature);
+      if (it != shard.signatures.end())
+        return it->second;
+    }
+    // parse without the lock, the children are interned too
+    boost::shared_ptr<SignaturePrivate> p = boost::make_shared<SignaturePrivate>();
+    p->init(signature, 0, signature.size());
+    boost::mutex::scoped_lock lock(shard.mutex);
+    if (shard.signatures.size() >= SignatureCache::MaxSignaturesPerShard)
+      return p;
+    std::pair<SignatureCache::SignatureMap::iterator, bool> inserted =
+        shard.signatures.insert(std::make_pair(signature, p));
+    if (inserted.second)
+      p->_interned = true;
+    return inserted.first->second;
+  }
+
   static size_t findNext(const std::string &signature, size_t index) {
 
     if (index >= signature.size())
@@ -428,29 +496,51 @@ namespace qi {
     _signature.assign(signature, begin, end - begin);
   }
 
+  static const boost::shared_ptr<SignaturePrivate>& emptySignature()
+  {
+    static boost::shared_ptr<SignaturePrivate>* empty =
+        new boost::shared_ptr<SignaturePrivate>(boost::make_shared<SignaturePrivate>());
+    return *empty;
+  }
+
   Signature::Signature()
-    : _p(boost::make_shared<SignaturePrivate>())
+    : _p(emptySignature())
   {
   }
 
   Signature::Signature(const char *signature)
-    : _p(boost::make_shared<SignaturePrivate>())
+    : _p(SignaturePrivate::intern(signature))
   {
-    _p->_signature.assign(signature);
-    _p->init(_p->_signature, 0, _p->_signature.size());
   }
 
 
   Signature::Signature(const std::string &signature)
-    : _p(boost::make_shared<SignaturePrivate>())
+    : _p(SignaturePrivate::intern(signature))
   {
-    _p->init(signature, 0, signature.size());
   }
 
   Signature::Signature(const std::string &signature, size_t begin, size_t end)
-    : _p(boost::make_shared<SignaturePrivate>())
+    : _p(SignaturePrivate::intern(signature.substr(begin, end - begin)))
+  {
+  }
+
+  float Signature::isConvertibleTo(const Signature& b) const
   {
-    _p->init(signature, begin, end);
+    if (!_p->_interned || !b._p->_interned)
+      return convertibility(*this, b);
+    SignatureCache::SignaturePair key(_p.get(), b._p.get());
+    SignatureCache::Shard& shard = SignatureCache::shard(boost::hash<SignatureCache::SignaturePair>()(key));
+    {
+      boost::mutex::scoped_lock lock(shard.mutex);
+      SignatureCache::ConvertibilityMap::const_iterator it = shard.convertibilities.find(key);
+      if (it != shard.convertibilities.end())
+        return it->second;
+    }
+    float result = convertibility(*this, b);
+    boost::mutex::scoped_lock lock(shard.mutex);
+    if (shard.convertibilities.size() < SignatureCache::MaxConvertibilitiesPerShard)
+      shard.convertibilities[key] = result;
+    return result;
   }
 
   bool Signature::isValid() const {
@@ -555,6 +645,8 @@ namespace qi {
   //compare signature without taking annotation into account
   bool operator==(const Signature& lhs, const Signature& rhs)
   {
+    if (lhs._p == rhs._p)
+      return true;
     if (lhs.type() != rhs.type())
       return false;
     if (lhs.children().size() != rhs.children().size())
@@ -0,0 +1,147 @@
+#pragma once
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#ifndef _SRC_TYPECACHE_P_HPP_
+#define _SRC_TYPECACHE_P_HPP_
+
+#include <cstddef>
+
+#include <qi/atomic.hpp>
+
+namespace qi {
+
+  class TypeInterface;
+
+  /** Read-mostly table of TypeInterface* keyed by one or two pointers, put in
+   * front of the type registry and of the type factories.
+   *
+   * Lookups take no lock and may run concurrently with a writer. Writers
+   * must be serialized by the caller, which keeps the authoritative table
+   * under its lock and fills this one once an answer is known.
+   *
+   * A slot is published by setting its first key last. Slots are never
+   * removed, only their value changed. When the table grows, the previous one
+   * is left alive for the readers that may still be probing it: with the
+   * capacity doubling each time, this costs less than the final table.
+   */
+  class TypeCache
+  {
+  public:
+    TypeCache()
+      : _table(new Table(16))
+    {}
+
+    /// @return true and set \p value if the key is present, even if its value is null
+    bool find(const void* first, const void* second, TypeInterface*& value) const
+    {
+      const Table* table = *_table;
+      const std::size_t mask = table->capacity - 1;
+      for (std::size_t i = hash(first, second) & mask; ; i = (i + 1) & mask)
+      {
+        const void* key = *table->slots[i].first;
+        if (!key)
+          return false;
+        if (key == first && table->slots[i].second == second)
+        {
+          value = *table->slots[i].value;
+          return true;
+        }
+      }
+    }
+
+    /// Set the value of a key. Writers must hold a common lock.
+    void set(const void* first, const void* second, TypeInterface* value)
+    {
+      Table* table = *_table;
+      if (Slot* slot = lookup(table, first, second))
+      {
+        slot->value = value;
+        return;
+      }
+      // keep at least half of the slots free so that probes stay short
+      if ((table->count + 1) * 2 > table->capacity)
+      {
+        Table* bigger = new Table(table->capacity * 2);
+        for (std::size_t i = 0; i < table->capacity; ++i)
+          if (const void* key = *table->slots[i].first)
+            insert(bigger, key, table->slots[i].second, *table->slots[i].value);
+        _table = bigger;
+        table = bigger;
+      }
+      insert(table, first, second, value);
+    }
+
+    /// Set the value of all the keys matching \p pred(first, second). Writers must hold a common lock.
+    template <typename Pred>
+    void setWhere(Pred pred, TypeInterface* value)
+    {
+      Table* table = *_table;
+      for (std::size_t i = 0; i < table->capacity; ++i)
+      {
+        const void* key = *table->slots[i].first;
+        if (key && pred(key, table->slots[i].second))
+          table->slots[i].value = value;
+      }
+    }
+
+  private:
+    struct Slot
+    {
+      qi::Atomic<const void*>    first;
+      const void*                second;
+      qi::Atomic<TypeInterface*> value;
+    };
+
+    struct Table
+    {
+      explicit Table(std::size_t capacity)
+        : capacity(capacity)
+        , count(0)
+        , slots(new Slot[capacity]())
+      {}
+
+      const std::size_t capacity; // a power of two
+      std::size_t       count;
+      Slot*             slots;
+    };
+
+    static std::size_t hash(const void* first, const void* second)
+    {
+      return (reinterpret_cast<std::size_t>(first) >> 4) * 31
+           + (reinterpret_cast<std::size_t>(second) >> 4);
+    }
+
+    static Slot* lookup(Table* table, const void* first, const void* second)
+    {
+      const std::size_t mask = table->capacity - 1;
+      for (std::size_t i = hash(first, second) & mask; ; i = (i + 1) & mask)
+      {
+        const void* key = *table->slots[i].first;
+        if (!key)
+          return 0;
+        if (key == first && table->slots[i].second == second)
+          return &table->slots[i];
+      }
+    }
+
+    static void insert(Table* table, const void* first, const void* second, TypeInterface* value)
+    {
+      const std::size_t mask = table->capacity - 1;
+      std::size_t i = hash(first, second) & mask;
+      while (*table->slots[i].first)
+        i = (i + 1) & mask;
+      table->slots[i].second = second;
+      table->slots[i].value = value;
+      table->slots[i].first = first; // publishes the slot
+      ++table->count;
+    }
+
+    qi::Atomic<Table*> _table;
+  };
+
+}
+
+#endif  // _SRC_TYPECACHE_P_HPP_
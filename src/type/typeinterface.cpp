@@ -3,6 +3,7 @@
 **  See COPYING for the license
 */
 
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/algorithm/string.hpp>
@@ -14,6 +15,8 @@
 #include <qi/type/typedispatcher.hpp>
 #include <qi/anyfunction.hpp>
 
+#include "typecache_p.hpp"
+
 #ifdef __GNUC__
 #include <cxxabi.h>
 #endif
@@ -130,16 +133,35 @@ namespace qi {
     return *res;
   }
 
-  QI_API TypeInterface* getType(const std::type_info& type)
+  // Guards typeFactory(), fallbackTypeFactory() and the writes to typeCache()
+  static boost::mutex& typeFactoryMutex()
   {
     static boost::mutex* mutex = nullptr;
     QI_THREADSAFE_NEW(mutex);
-    boost::mutex::scoped_lock sl(*mutex);
+    return *mutex;
+  }
+
+  // Answers of typeFactory() by type_info address, looked up without lock
+  static TypeCache& typeCache()
+  {
+    static TypeCache* res = nullptr;
+    QI_THREADSAFE_NEW(res);
+    return *res;
+  }
+
+  QI_API TypeInterface* getType(const std::type_info& type)
+  {
     static bool fallback = !qi::os::getenv("QI_TYPE_RTTI_FALLBACK").empty();
 
+    TypeInterface* result = nullptr;
+    if (typeCache().find(&type, nullptr, result) && (result || !fallback))
+      return result;
+
+    boost::mutex::scoped_lock sl(typeFactoryMutex());
     // We create-if-not-exist on purpose: to detect access that occur before
     // registration
-    TypeInterface* result = typeFactory()[TypeInfo(type)];
+    result = typeFactory()[TypeInfo(type)];
+    typeCache().set(&type, nullptr, result);
     if (result || !fallback)
       return result;
     result = fallbackTypeFactory()[type.name()];
@@ -148,24 +170,44 @@ namespace qi {
     return result;
   }
 
+  static bool sameTypeInfo(const void* info, const void* other)
+  {
+    return TypeInfo(*static_cast<const std::type_info*>(info))
+        == TypeInfo(*static_cast<const std::type_info*>(other));
+  }
+
   /// Type factory setter
   QI_API bool registerType(const std::type_info& typeId, TypeInterface* type)
   {
     qiLogCategory("qitype.type"); // method can be called at static init
     qiLogDebug() << "registerType "  << typeId.name() << " "
      << type->kind() <<" " << (void*)type << " " << type->signature().toString();
-    TypeFactory::iterator i = typeFactory().find(TypeInfo(typeId));
-    if (i != typeFactory().end())
+    bool present = false;
+    TypeInterface* previous = nullptr;
+    {
+      boost::mutex::scoped_lock sl(typeFactoryMutex());
+      TypeFactory::iterator i = typeFactory().find(TypeInfo(typeId));
+      if (i != typeFactory().end())
+      {
+        present = true;
+        previous = i->second;
+      }
+      typeFactory()[TypeInfo(typeId)] = type;
+      fallbackTypeFactory()[typeId.name()] = type;
+      // also update the type_infos at other addresses comparing equal
+      typeCache().setWhere(boost::bind(&sameTypeInfo, _1, &typeId), type);
+      typeCache().set(&typeId, nullptr, type);
+    }
+    // logged outside of the lock, which kind() could need through typeOf()
+    if (present)
     {
-      if (i->second)
+      if (previous)
         qiLogVerbose() << "registerType: previous registration present for "
-          << typeId.name()<< " " << (void*)i->second << " " << i->second->kind();
+          << typeId.name()<< " " << (void*)previous << " " << previous->kind();
       else
         qiLogVerbose() << "registerType: access to type factory before"
           " registration detected for type " << typeId.name();
     }
-    typeFactory()[TypeInfo(typeId)] = type;
-    fallbackTypeFactory()[typeId.name()] = type;
     return true;
   }
 
@@ -754,14 +796,17 @@ namespace qi {
   static TypeInterface* makeListIteratorType(TypeInterface* element)
   {
     static boost::mutex* mutex;
-    QI_THREADSAFE_NEW(mutex);
+    static TypeCache* cache;
+    QI_THREADSAFE_NEW(mutex, cache);
+    TypeInterface* result;
+    if (cache->find(element, nullptr, result))
+      return result;
     boost::mutex::scoped_lock lock(*mutex);
     static std::map<TypeInfo, TypeInterface*>* map = nullptr;
     if (!map)
       map = new std::map<TypeInfo, TypeInterface*>();
     TypeInfo key = element->info();
     std::map<TypeInfo, TypeInterface*>::iterator it;
-    TypeInterface* result;
     it = map->find(key);
     if (it == map->end())
     {
@@ -770,6 +815,7 @@ namespace qi {
     }
     else
       result = it->second;
+    cache->set(element, nullptr, result);
     return result;
   }
 
@@ -874,14 +920,17 @@ namespace qi {
   TypeInterface* makeVarArgsType(TypeInterface* element)
   {
     static boost::mutex* mutex = nullptr;
-    QI_THREADSAFE_NEW(mutex);
+    static TypeCache* cache = nullptr;
+    QI_THREADSAFE_NEW(mutex, cache);
+    TypeInterface* result;
+    if (cache->find(element, nullptr, result))
+      return result;
     boost::mutex::scoped_lock lock(*mutex);
     static std::map<TypeInfo, TypeInterface*>* map = nullptr;
     if (!map)
       map = new std::map<TypeInfo, TypeInterface*>();
     TypeInfo key(element->info());
     std::map<TypeInfo, TypeInterface*>::iterator it;
-    TypeInterface* result;
     it = map->find(key);
     if (it == map->end())
     {
@@ -890,20 +939,24 @@ namespace qi {
     }
     else
       result = it->second;
+    cache->set(element, nullptr, result);
     return result;
   }
     // We want exactly one instance per element type
   TypeInterface* makeListType(TypeInterface* element)
   {
     static boost::mutex* mutex = nullptr;
-    QI_THREADSAFE_NEW(mutex);
+    static TypeCache* cache = nullptr;
+    QI_THREADSAFE_NEW(mutex, cache);
+    TypeInterface* result;
+    if (cache->find(element, nullptr, result))
+      return result;
     boost::mutex::scoped_lock lock(*mutex);
     static std::map<TypeInfo, TypeInterface*>* map = nullptr;
     if (!map)
       map = new std::map<TypeInfo, TypeInterface*>();
     TypeInfo key(element->info());
     std::map<TypeInfo, TypeInterface*>::iterator it;
-    TypeInterface* result;
     it = map->find(key);
     if (it == map->end())
     {
@@ -912,6 +965,7 @@ namespace qi {
     }
     else
       result = it->second;
+    cache->set(element, nullptr, result);
     return result;
   }
 
@@ -1111,7 +1165,11 @@ namespace qi {
   {
     using Map = std::map<TypeInfo, TypeInterface*>;
     static boost::mutex* mutex = nullptr;
-    QI_THREADSAFE_NEW(mutex);
+    static TypeCache* cache = nullptr;
+    QI_THREADSAFE_NEW(mutex, cache);
+    TypeInterface* result;
+    if (cache->find(te, nullptr, result))
+      return result;
     boost::mutex::scoped_lock lock(*mutex);
 
     static Map * map = nullptr;
@@ -1120,7 +1178,6 @@ namespace qi {
     TypeInfo ti(te->info());
     Map::key_type key(ti);
     Map::iterator it;
-    TypeInterface* result;
     it = map->find(key);
     if (it == map->end())
     {
@@ -1129,6 +1186,7 @@ namespace qi {
     }
     else
       result = it->second;
+    cache->set(te, nullptr, result);
     return result;
   }
 
@@ -1282,7 +1340,11 @@ namespace qi {
   TypeInterface* makeMapType(TypeInterface* kt, TypeInterface* et)
   {
     static boost::mutex* mutex = nullptr;
-    QI_THREADSAFE_NEW(mutex);
+    static TypeCache* cache = nullptr;
+    QI_THREADSAFE_NEW(mutex, cache);
+    TypeInterface* cached;
+    if (cache->find(kt, et, cached))
+      return cached;
     boost::mutex::scoped_lock lock(*mutex);
 
     using Map = std::map<std::pair<TypeInfo, TypeInfo>, MapTypeInterface*>;
@@ -1304,6 +1366,7 @@ namespace qi {
     {
       result = it->second;
     }
+    cache->set(kt, et, result);
     return result;
   }
 
@@ -1391,6 +1454,7 @@ namespace qi {
     return (*it).rawValue();
   }
 
+
   namespace detail
   {
     void typeFail(const char* typeName, const char* operation)
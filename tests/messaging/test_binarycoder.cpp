@@ -6,6 +6,9 @@
 */
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <list>
 #include <map>
 #include <qi/buffer.hpp>
 #include <qi/binarycodec.hpp>
@@ -649,3 +652,173 @@ TEST(testSerializable, Value) {
   qi::encodeBinary(&buf, gv);
   qi::decodeBinary(&bufr, &gv2);
 }
+
+// Flat structs, copied as byte ranges, with padding between fields
+struct Padded {
+  char   c;
+  double d;
+  short  s;
+};
+QI_TYPE_STRUCT(Padded, c, d, s);
+
+struct Nested {
+  Padded   p;
+  unsigned u;
+  Point    point;
+};
+QI_TYPE_STRUCT(Nested, p, u, point);
+
+TEST(testSerializable, FlatStruct) {
+  Nested n1;
+  n1.p.c = 'a';
+  n1.p.d = 3.5;
+  n1.p.s = -7;
+  n1.u = 42;
+  n1.point = point(12, 13);
+  std::vector<Nested> v1(3, n1);
+  v1[1].u = 43;
+
+  qi::Buffer buf;
+  qi::encodeBinary(&buf, n1);
+
+  // same bytes as the fields written one by one, without the padding
+  qi::Buffer fields;
+  qi::encodeBinary(&fields, n1.p.c);
+  qi::encodeBinary(&fields, n1.p.d);
+  qi::encodeBinary(&fields, n1.p.s);
+  qi::encodeBinary(&fields, n1.u);
+  qi::encodeBinary(&fields, n1.point.x);
+  qi::encodeBinary(&fields, n1.point.y);
+  ASSERT_EQ(fields.size(), buf.size());
+  EXPECT_EQ(0, memcmp(fields.data(), buf.data(), buf.size()));
+  qi::encodeBinary(&buf, v1);
+
+  qi::BufferReader bufr(buf);
+  Nested n2;
+  std::vector<Nested> v2;
+  qi::decodeBinary(&bufr, &n2);
+  qi::decodeBinary(&bufr, &v2);
+  EXPECT_EQ('a', n2.p.c);
+  EXPECT_EQ(3.5, n2.p.d);
+  EXPECT_EQ(-7, n2.p.s);
+  EXPECT_EQ(42u, n2.u);
+  EXPECT_EQ(n1.point, n2.point);
+  ASSERT_EQ(3u, v2.size());
+  EXPECT_EQ(42u, v2[0].u);
+  EXPECT_EQ(43u, v2[1].u);
+  EXPECT_EQ(n1.point, v2[2].point);
+
+  // truncated input is reported, not read past
+  qi::Buffer shortBuf;
+  shortBuf.write(buf.data(), 4);
+  qi::BufferReader shortReader(shortBuf);
+  EXPECT_ANY_THROW(qi::decodeBinary(&shortReader, &n2));
+}
+
+// Flat structs which are not plain QI_TYPE_STRUCTs are decoded through set()
+struct Doubled {
+  int value;
+  int twice; // not serialized, computed by the hook
+};
+QI_TYPE_STRUCT_EX(Doubled, ptr->twice = ptr->value * 2;, value);
+
+struct Clamped {
+  Clamped(int value = 0)
+    : value(std::min(value, 10))
+  {}
+  int value;
+};
+QI_TYPE_STRUCT_AGREGATE_CONSTRUCTOR(Clamped, ("value", value));
+
+TEST(testSerializable, FlatStructWithSetter) {
+  Doubled d1 = { 21, 0 };
+  std::vector<Doubled> dv1(3, d1);
+  Clamped c1;
+  c1.value = 20;
+  std::vector<Clamped> cv1(2, c1);
+
+  qi::Buffer buf;
+  qi::encodeBinary(&buf, d1);
+  qi::encodeBinary(&buf, dv1);
+  qi::encodeBinary(&buf, c1);
+  qi::encodeBinary(&buf, cv1);
+  // still written as a copy of the field
+  EXPECT_EQ(sizeof(int) * 2 + sizeof(qi::uint32_t) * 2 + sizeof(int) * 5, buf.size());
+
+  qi::BufferReader bufr(buf);
+  Doubled d2 = { 0, 0 };
+  std::vector<Doubled> dv2;
+  Clamped c2;
+  std::vector<Clamped> cv2;
+  qi::decodeBinary(&bufr, &d2);
+  qi::decodeBinary(&bufr, &dv2);
+  qi::decodeBinary(&bufr, &c2);
+  qi::decodeBinary(&bufr, &cv2);
+  EXPECT_EQ(21, d2.value);
+  EXPECT_EQ(42, d2.twice);
+  ASSERT_EQ(3u, dv2.size());
+  EXPECT_EQ(42, dv2[2].twice);
+  EXPECT_EQ(10, c2.value);
+  ASSERT_EQ(2u, cv2.size());
+  EXPECT_EQ(10, cv2[1].value);
+}
+
+TEST(testSerializable, ScalarList) {
+  std::vector<double> d1;
+  for (int i = 0; i < 100; ++i)
+    d1.push_back(i * 0.5);
+  std::vector<short> s1(3, 7);
+  std::list<int> l1(4, 3);
+
+  qi::Buffer buf;
+  qi::encodeBinary(&buf, d1);
+  EXPECT_EQ(sizeof(qi::uint32_t) + d1.size() * sizeof(double), buf.size());
+  qi::encodeBinary(&buf, s1);
+  qi::encodeBinary(&buf, l1);
+  qi::encodeBinary(&buf, std::vector<int>());
+
+  qi::BufferReader bufr(buf);
+  std::vector<double> d2;
+  std::vector<short> s2(1, 1);
+  std::list<int> l2;
+  std::vector<int> e2;
+  qi::decodeBinary(&bufr, &d2);
+  qi::decodeBinary(&bufr, &s2);
+  qi::decodeBinary(&bufr, &l2);
+  qi::decodeBinary(&bufr, &e2);
+  EXPECT_EQ(d1, d2);
+  // decoding appends, as for other lists
+  ASSERT_EQ(4u, s2.size());
+  EXPECT_EQ(1, s2[0]);
+  EXPECT_EQ(7, s2[3]);
+  EXPECT_EQ(l1, l2);
+  EXPECT_TRUE(e2.empty());
+
+  // a size larger than the data is reported before growing the list
+  qi::Buffer shortBuf;
+  qi::uint32_t size = 1 << 30;
+  shortBuf.write(&size, sizeof(size));
+  shortBuf.write(&d1[0], 8 * sizeof(double));
+  qi::BufferReader shortReader(shortBuf);
+  EXPECT_ANY_THROW(qi::decodeBinary(&shortReader, &d2));
+  EXPECT_EQ(d1.size(), d2.size());
+}
+
+TEST(TestBind, DeserializeRawSlice) {
+  // raw inline in the buffer, as received from a socket
+  std::string payload(100000, 'x');
+  qi::Buffer buf;
+  qi::uint32_t size = payload.size();
+  buf.write(&size, sizeof(size));
+  buf.write(payload.data(), payload.size());
+
+  qi::Buffer raw;
+  {
+    qi::BufferReader bufr(buf);
+    qi::decodeBinary(&bufr, &raw);
+  }
+  ASSERT_EQ(payload.size(), raw.size());
+  EXPECT_EQ(static_cast<const char*>(buf.data()) + sizeof(size), raw.data());
+  buf = qi::Buffer();
+  EXPECT_EQ(payload, std::string(static_cast<const char*>(raw.data()), raw.size()));
+}
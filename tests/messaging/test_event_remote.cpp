@@ -142,6 +142,37 @@ TEST(TestSignal, TwoLongPost)
   ASSERT_EQ(43, verifB);
 }
 
+void storeLatest(qi::Atomic<int>* calls, qi::Atomic<int>* last, int value)
+{
+  ++*calls;
+  *last = value;
+}
+
+TEST(TestSignal, CoalescedRemote)
+{
+  qi::DynamicObjectBuilder gob;
+  qi::Signal<int> sig;
+  // only the latest value of each period is sent to the remote subscribers
+  sig.setCoalescing(qi::SignalCoalescing::latest(qi::MilliSeconds(200)));
+  gob.advertiseSignal("sig1", &sig);
+  qi::AnyObject op = gob.object();
+
+  TestSessionPair p;
+  p.server()->registerService("MyService", op);
+  qi::AnyObject clientOp = p.client()->service("MyService").value();
+  qi::Atomic<int> calls;
+  qi::Atomic<int> last;
+  clientOp.connect("sig1", boost::function<void(int)>(boost::bind(&storeLatest, &calls, &last, _1))).wait();
+
+  for (int i = 1; i <= 100; ++i)
+    sig(i);
+  for (int i = 0; i < 100 && *last != 100; ++i)
+    qi::os::msleep(10);
+  EXPECT_EQ(100, *last);
+  // the first trigger may be flushed before the others are coalesced
+  EXPECT_LE(*calls, 2);
+}
+
 int main(int argc, char *argv[])
 {
 #if defined(__APPLE__) || defined(__linux__)
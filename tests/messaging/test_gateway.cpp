@@ -18,6 +18,7 @@
 #include <qi/messaging/gateway.hpp>
 #include <qi/type/dynamicobjectbuilder.hpp>
 #include <qi/log.hpp>
+#include <qi/os.hpp>
 
 qiLogCategory("TestGateway");
 
@@ -330,6 +331,78 @@ namespace
       clients[i]->close();
   }
 
+  TEST_F(TestGateway, testSignalsAfterSubscriberLeft)
+  {
+    SessionPtr serviceHost = connectClientToGw();
+    SessionPtr clients[3] = {};
+    qi::AnyObject serviceObjects[3] = {};
+    qi::Promise<int> prom;
+    qi::Future<int> fut = prom.future();
+    int value = rand();
+    bool overflow = false;
+    callsync_ callsync(prom, value, 2, &overflow);
+
+    serviceHost->registerService("my_service", makeBaseService());
+    for (int i = 0; i < 3; ++i)
+      clients[i] = connectClientToGw();
+    for (int i = 0; i < 3; ++i)
+      serviceObjects[i] = clients[i]->service("my_service");
+    for (int i = 0; i < 3; ++i)
+      serviceObjects[i].connect("echoSignal", boost::function<void(int)>(callsyncwrap_(&callsync)));
+
+    // the gateway must stop forwarding the events to the client which left
+    clients[0]->close();
+    serviceObjects[0] = qi::AnyObject();
+    serviceObjects[1].post("echoSignal", value);
+
+    fut.wait();
+    ASSERT_FALSE(fut.hasError());
+    qi::os::msleep(100);
+    ASSERT_FALSE(overflow);
+    ASSERT_EQ(callsync.remainingCalls_, 0);
+    for (int i = 1; i < 3; ++i)
+      clients[i]->close();
+    serviceHost->close();
+  }
+
+  TEST_F(TestGateway, testSignalsAfterServiceReregistered)
+  {
+    SessionPtr client = connectClientToGw();
+    int value = rand();
+    bool overflow = false;
+    qi::Promise<int> oldProm;
+    callsync_ oldSync(oldProm, value, 1, &overflow);
+    qi::Promise<int> newProm;
+    callsync_ newSync(newProm, value, 1, &overflow);
+
+    {
+      SessionPtr serviceHost = connectClientToGw();
+      unsigned int id = serviceHost->registerService("my_service", makeBaseService());
+      qi::AnyObject service = client->service("my_service");
+      service.connect("echoSignal", boost::function<void(int)>(callsyncwrap_(&oldSync)));
+      service.post("echoSignal", value);
+      oldProm.future().wait();
+      ASSERT_FALSE(oldProm.future().hasError());
+      serviceHost->unregisterService(id);
+      serviceHost->close();
+    }
+
+    // the events of the new host must only reach the new subscription
+    SessionPtr serviceHost = connectClientToGw();
+    serviceHost->registerService("my_service", makeBaseService());
+    qi::AnyObject service = client->service("my_service");
+    service.connect("echoSignal", boost::function<void(int)>(callsyncwrap_(&newSync)));
+    service.post("echoSignal", value);
+    newProm.future().wait();
+    ASSERT_FALSE(newProm.future().hasError());
+    qi::os::msleep(100);
+    ASSERT_FALSE(overflow);
+    ASSERT_EQ(oldSync.remainingCalls_, 0);
+    ASSERT_EQ(newSync.remainingCalls_, 0);
+    client->close();
+    serviceHost->close();
+  }
+
   static void disco_sync(qi::Promise<void> prom, int* atomix, boost::mutex* moutex)
   {
     boost::mutex::scoped_lock lock(*moutex);
@@ -496,6 +569,30 @@ namespace
     ASSERT_FALSE(fut.hasError());
   }
 
+  // Plain calls are forwarded without looking at their payload, the calls
+  // returning objects on the same services must still have them tracked.
+  TEST_F(TestGateway, testPlainCallsAroundObjects)
+  {
+    qi::SessionPtr client = connectClientToGw();
+    qi::SessionPtr serviceHost = connectClientToGw();
+
+    serviceHost->registerService("my_service", makeBaseService());
+    qi::AnyObject service = client->service("my_service");
+    for (int i = 0; i < 10; ++i)
+      ASSERT_EQ(service.call<int>("echoValue", i), i);
+
+    qi::AnyObject object = service.call<qi::AnyObject>("getObject");
+    int value = rand();
+    ASSERT_EQ(object.call<int>("echoValue", value), value);
+    qi::AnyObject nested = object.call<qi::AnyObject>("getObject");
+    ASSERT_EQ(nested.call<int>("echoValue", value), value);
+
+    for (int i = 0; i < 10; ++i)
+      ASSERT_EQ(service.call<int>("echoValue", i), i);
+    client->close();
+    serviceHost->close();
+  }
+
 }
 
 int main(int ac, char **av)
@@ -0,0 +1,208 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <qi/application.hpp>
+#include <qi/buffer.hpp>
+#include <qi/future.hpp>
+
+#include "src/messaging/messagepool.hpp"
+#include "src/messaging/tcptransportsocket.hpp"
+#include "src/messaging/transportserver.hpp"
+
+TEST(TestMessagePool, RecycleAfterRelease)
+{
+  qi::MessagePool pool(1 << 20);
+  qi::Message msg;
+
+  pool.acquire(msg, 100);
+  qi::MessagePrivate* p = msg._p.get();
+  msg._p->buffer.reserve(100);
+  pool.release(msg);
+  EXPECT_FALSE(msg._p);
+  EXPECT_LT(0u, pool.stats().bytesRetained);
+
+  pool.acquire(msg, 50);
+  EXPECT_EQ(p, msg._p.get());
+  EXPECT_EQ(0u, msg.buffer().size());
+
+  qi::MessagePool::Stats stats = pool.stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(0u, stats.dropped);
+  EXPECT_EQ(0u, stats.bytesRetained);
+}
+
+TEST(TestMessagePool, ReserveDoesNotReallocate)
+{
+  qi::MessagePool pool(1 << 20);
+  qi::Message msg;
+
+  pool.acquire(msg, 100000);
+  const void* data = msg.buffer().data();
+  msg._p->buffer.reserve(100000);
+  EXPECT_EQ(data, msg.buffer().data());
+
+  pool.release(msg);
+  pool.acquire(msg, 70000);
+  EXPECT_EQ(data, msg.buffer().data());
+  msg._p->buffer.reserve(70000);
+  EXPECT_EQ(data, msg.buffer().data());
+}
+
+TEST(TestMessagePool, KeptMessageIsNotRecycled)
+{
+  qi::MessagePool pool(1 << 20);
+  qi::Message msg;
+
+  pool.acquire(msg, 10);
+  qi::Message kept = msg;
+  pool.release(msg);
+  EXPECT_EQ(1u, pool.stats().dropped);
+  EXPECT_EQ(0u, pool.stats().bytesRetained);
+
+  pool.acquire(msg, 10);
+  EXPECT_NE(kept._p.get(), msg._p.get());
+  EXPECT_EQ(2u, pool.stats().misses);
+}
+
+TEST(TestMessagePool, KeptBufferIsNotRecycled)
+{
+  qi::MessagePool pool(1 << 20);
+  qi::Message msg;
+
+  pool.acquire(msg, 10);
+  int value = 42;
+  msg._p->buffer.write(&value, sizeof(value));
+  qi::Buffer kept = msg.buffer();
+  pool.release(msg);
+  EXPECT_EQ(1u, pool.stats().dropped);
+  EXPECT_EQ(sizeof(value), kept.size());
+}
+
+TEST(TestMessagePool, RetainedBytesAreBounded)
+{
+  qi::MessagePool pool(1);
+  qi::Message msg;
+
+  pool.acquire(msg, 10);
+  pool.release(msg);
+  EXPECT_EQ(1u, pool.stats().dropped);
+  EXPECT_EQ(0u, pool.stats().bytesRetained);
+}
+
+TEST(TestMessagePool, SlicedPayloadIsNotRecycled)
+{
+  qi::MessagePool pool(1 << 20);
+  qi::Message msg;
+
+  pool.acquire(msg, 100000);
+  msg._p->buffer.reserve(100000);
+  qi::Buffer slice = msg.buffer().slice(0, 70000);
+  pool.release(msg);
+  EXPECT_EQ(1u, pool.stats().dropped);
+  EXPECT_EQ(0u, pool.stats().bytesRetained);
+  EXPECT_EQ(70000u, slice.size());
+}
+
+TEST(TestMessagePool, RecycledOnceSlicesAreGone)
+{
+  qi::MessagePool pool(1 << 20);
+  qi::Message msg;
+
+  pool.acquire(msg, 100000);
+  const void* data = msg.buffer().data();
+  std::size_t retained = 0;
+  for (int i = 0; i < 100; ++i)
+  {
+    if (i)
+      pool.acquire(msg, 100000);
+    EXPECT_EQ(data, msg.buffer().data());
+    msg._p->buffer.reserve(100000);
+    {
+      qi::Buffer slice = msg.buffer().slice(1000, 70000);
+      EXPECT_EQ(static_cast<const char*>(data) + 1000, slice.data());
+    }
+    pool.release(msg);
+    if (!i)
+      retained = pool.stats().bytesRetained;
+    EXPECT_EQ(retained, pool.stats().bytesRetained);
+  }
+  EXPECT_EQ(99u, pool.stats().hits);
+  EXPECT_EQ(0u, pool.stats().dropped);
+}
+
+namespace
+{
+  const int rawCount = 50;
+
+  struct RawReceiver
+  {
+    qi::TransportSocketPtr socket;
+    std::vector<std::size_t> retained;
+    std::size_t dropped;
+    qi::Promise<void> done;
+
+    void onMessage(const qi::Message& msg)
+    {
+      // a raw that large is decoded as a slice of the message buffer
+      qi::AnyReference ref = msg.value("r", socket);
+      qi::Buffer raw = ref.to<qi::Buffer>();
+      ref.destroy();
+      EXPECT_EQ(100000u, raw.size());
+      qi::MessagePool::Stats stats =
+        boost::static_pointer_cast<qi::TcpTransportSocket>(socket)->messagePool().stats();
+      retained.push_back(stats.bytesRetained);
+      dropped = stats.dropped;
+      if (retained.size() == rawCount)
+        done.setValue(0);
+    }
+
+    void onConnection(qi::TransportSocketPtr s)
+    {
+      socket = s;
+      socket->messageReady.connect(&RawReceiver::onMessage, this, _1);
+      socket->startReading();
+    }
+  };
+}
+
+TEST(TestMessagePool, ReceivedRawsKeepRetainedMemoryFlat)
+{
+  RawReceiver receiver;
+  qi::TransportServer server;
+  server.newConnection.connect(&RawReceiver::onConnection, &receiver, _1);
+  server.listen("tcp://127.0.0.1:0").wait();
+
+  qi::TransportSocketPtr client = qi::makeTransportSocket("tcp");
+  client->connect(server.endpoints()[0]).wait();
+  qi::Buffer raw;
+  raw.reserve(100000);
+  for (int i = 0; i < rawCount; ++i)
+  {
+    qi::Message msg(qi::Message::Type_Post, qi::MessageAddress(i + 1, 1, 1, 1));
+    msg.setValue(qi::AnyReference::from(raw), "r");
+    client->send(msg);
+  }
+  ASSERT_TRUE(receiver.done.future().waitFor(qi::Seconds(10)) == qi::FutureState_FinishedWithValue);
+
+  // the payload of each raw goes back to the pool once its slice is gone
+  for (int i = 2; i < rawCount; ++i)
+    EXPECT_EQ(receiver.retained[1], receiver.retained[i]);
+  EXPECT_EQ(0u, receiver.dropped);
+
+  client->disconnect();
+  server.close();
+}
+
+int main(int ac, char **av)
+{
+  qi::Application app(ac, av);
+  ::testing::InitGoogleTest(&ac, av);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,132 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <cstring>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+#include <qi/application.hpp>
+#include <qi/binarycodec.hpp>
+#include <qi/buffer.hpp>
+#include <qi/os.hpp>
+
+#include "src/messaging/sharedmemorybuffer.hpp"
+#include "src/messaging/streamcontext.hpp"
+
+namespace
+{
+  // A stream context which already received the capabilities of its peer
+  class Peer : public qi::StreamContext
+  {
+  public:
+    explicit Peer(bool sharedMemory)
+    {
+      advertiseCapability(qi::SharedMemoryBuffer::capabilityName, qi::AnyValue::from(sharedMemory));
+      _remoteCapabilityMap[qi::SharedMemoryBuffer::capabilityName] = qi::AnyValue::from(sharedMemory);
+    }
+  };
+
+  qi::Buffer makeBuffer(std::size_t size)
+  {
+    qi::Buffer buffer;
+    unsigned char* data = static_cast<unsigned char*>(buffer.reserve(size));
+    for (std::size_t i = 0; i < size; ++i)
+      data[i] = static_cast<unsigned char>(i);
+    return buffer;
+  }
+
+  bool sameData(const qi::Buffer& a, const qi::Buffer& b)
+  {
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+  }
+}
+
+TEST(TestSharedMemoryBuffer, ExportImport)
+{
+  qi::Buffer buffer = makeBuffer(100000);
+  std::string segment = qi::SharedMemoryBuffer::exportBuffer(buffer);
+  ASSERT_FALSE(segment.empty());
+
+  qi::Buffer mapped = qi::SharedMemoryBuffer::importBuffer(segment, buffer.size());
+  EXPECT_TRUE(sameData(buffer, mapped));
+
+  // The receiver unlinked the segment
+  EXPECT_THROW(qi::SharedMemoryBuffer::importBuffer(segment, buffer.size()), std::runtime_error);
+}
+
+TEST(TestSharedMemoryBuffer, ImportedBufferCanGrow)
+{
+  qi::Buffer buffer = makeBuffer(5000);
+  std::string segment = qi::SharedMemoryBuffer::exportBuffer(buffer);
+  ASSERT_FALSE(segment.empty());
+  qi::Buffer mapped = qi::SharedMemoryBuffer::importBuffer(segment, buffer.size());
+
+  int value = 42;
+  EXPECT_TRUE(mapped.write(&value, sizeof(value)));
+  EXPECT_TRUE(buffer.write(&value, sizeof(value)));
+  EXPECT_TRUE(sameData(buffer, mapped));
+}
+
+TEST(TestSharedMemoryBuffer, RejectForeignSegments)
+{
+  EXPECT_THROW(qi::SharedMemoryBuffer::importBuffer("/some-segment", 10), std::runtime_error);
+  EXPECT_THROW(qi::SharedMemoryBuffer::importBuffer("/qi-shm-../../etc", 10), std::runtime_error);
+}
+
+TEST(TestSharedMemoryBuffer, EncodeThroughSharedMemory)
+{
+  Peer peer(true);
+  qi::Buffer buffer = makeBuffer(100000);
+  qi::Buffer encoded;
+  qi::encodeBinary(&encoded, buffer, qi::SerializeObjectCallback(), &peer);
+  // Only the segment name was serialized
+  EXPECT_TRUE(encoded.subBuffers().empty());
+  EXPECT_GT(1000u, encoded.totalSize());
+
+  qi::Buffer decoded;
+  qi::BufferReader reader(encoded);
+  qi::decodeBinary(&reader, &decoded, qi::DeserializeObjectCallback(), &peer);
+  EXPECT_TRUE(sameData(buffer, decoded));
+}
+
+TEST(TestSharedMemoryBuffer, EncodeInlineWithoutCapability)
+{
+  Peer peer(false);
+  qi::Buffer buffer = makeBuffer(100000);
+  qi::Buffer encoded;
+  qi::encodeBinary(&encoded, buffer, qi::SerializeObjectCallback(), &peer);
+  EXPECT_LT(buffer.size(), encoded.totalSize());
+}
+
+TEST(TestSharedMemoryBuffer, EncodeSmallBufferInline)
+{
+  Peer peer(true);
+  qi::Buffer buffer = makeBuffer(10);
+  qi::Buffer encoded;
+  qi::encodeBinary(&encoded, buffer, qi::SerializeObjectCallback(), &peer);
+  EXPECT_EQ(1u, encoded.subBuffers().size());
+}
+
+TEST(TestSharedMemoryBuffer, RefuseSegmentWithoutCapability)
+{
+  Peer sender(true);
+  Peer receiver(false);
+  qi::Buffer encoded;
+  qi::encodeBinary(&encoded, makeBuffer(100000), qi::SerializeObjectCallback(), &sender);
+
+  qi::Buffer decoded;
+  qi::BufferReader reader(encoded);
+  EXPECT_THROW(qi::decodeBinary(&reader, &decoded, qi::DeserializeObjectCallback(), &receiver),
+               std::runtime_error);
+}
+
+int main(int ac, char **av)
+{
+  qi::os::setenv("QI_SHARED_MEMORY_BUFFER_THRESHOLD", "4096");
+  qi::Application app(ac, av);
+  ::testing::InitGoogleTest(&ac, av);
+  return RUN_ALL_TESTS();
+}
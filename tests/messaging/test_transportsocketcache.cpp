@@ -117,6 +117,38 @@ TEST_F(TestTransportSocketCache, DifferentMachineIdLocalConnection)
   socket->disconnect();
 }
 
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+TEST_F(TestTransportSocketCache, SameMachinePrefersLocalSocket)
+{
+  server_.listen("tcp://127.0.0.1:0").wait();
+  ASSERT_FALSE(server_.listen("unix://" + qi::os::tmp() + "/test_transportsocketcache.sock").hasError());
+  qi::UrlVector endpoints = server_.endpoints();
+  ASSERT_EQ(2u, endpoints.size());
+
+  qi::ServiceInfo servInfo;
+  servInfo.setMachineId(qi::os::getMachineId());
+  servInfo.setEndpoints(endpoints);
+  qi::TransportSocketPtr sock = cache_.socket(servInfo, "").value();
+
+  ASSERT_TRUE(sock->isConnected());
+  ASSERT_EQ("unix", sock->url().protocol());
+}
+
+TEST_F(TestTransportSocketCache, OtherMachineIgnoresLocalSocket)
+{
+  server_.listen("tcp://127.0.0.1:0").wait();
+  ASSERT_FALSE(server_.listen("unix://" + qi::os::tmp() + "/test_transportsocketcache.sock").hasError());
+
+  qi::ServiceInfo servInfo;
+  servInfo.setMachineId("not the machine id of this machine");
+  servInfo.setEndpoints(server_.endpoints());
+  qi::TransportSocketPtr sock = cache_.socket(servInfo, "").value();
+
+  ASSERT_TRUE(sock->isConnected());
+  ASSERT_EQ("tcp", sock->url().protocol());
+}
+#endif
+
 static bool publicIp(const qi::Url& url)
 {
   const std::string& host = url.host();
@@ -132,6 +132,24 @@ TEST(TestURL, ValidUrl)
   EXPECT_EQ("tcp://example.com:5", url.str());
 }
 
+TEST(TestURL, LocalSocketUrl)
+{
+  qi::Url url("unix:///tmp/naoqi.sock", "tcp", 9559);
+
+  EXPECT_EQ("unix", url.protocol());
+  EXPECT_EQ("/tmp/naoqi.sock", url.host());
+  EXPECT_EQ(0, url.port());
+  EXPECT_TRUE(url.isValid());
+  EXPECT_EQ("unix:///tmp/naoqi.sock", url.str());
+
+  url = qi::Url("unix:///tmp/naoqi.sock", 9559);
+  EXPECT_TRUE(url.isValid());
+  EXPECT_EQ("unix:///tmp/naoqi.sock", url.str());
+
+  url = qi::Url("unix://");
+  EXPECT_FALSE(url.isValid());
+}
+
 TEST(TestURL, CopyUrl)
 {
   qi::Url url("tcp://example.com:5");
@@ -10,6 +10,10 @@
 
 #include <gtest/gtest.h>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <qi/atomic.hpp>
 #include <qi/buffer.hpp>
 
 
@@ -79,3 +83,95 @@ TEST(TestBuffer, TestSubBuffer)
   ASSERT_EQ(buffer.size(), 0u);
   ASSERT_EQ(buffer.totalSize(), 0u);
 }
+
+TEST(TestBuffer, TestSlice)
+{
+  qi::Buffer buffer;
+  std::string big(10000, 'a');
+  big[5000] = 'b';
+  buffer.write(big.data(), big.size());
+
+  qi::Buffer slice = buffer.slice(4000, 2000);
+  ASSERT_EQ(2000u, slice.size());
+  // no copy
+  EXPECT_EQ(static_cast<const char*>(buffer.data()) + 4000, slice.data());
+  EXPECT_EQ('b', static_cast<const char*>(slice.data())[1000]);
+  EXPECT_EQ(0u, buffer.slice(9000, 2000).size());
+
+  // growing or clearing the buffer does not change the slice
+  buffer.write(big.data(), big.size());
+  buffer.clear();
+  buffer.write(std::string(20000, 'c').data(), 20000);
+  EXPECT_EQ(std::string(big, 4000, 2000),
+            std::string(static_cast<const char*>(slice.data()), slice.size()));
+
+  // the slice outlives the buffer, and gets its own storage when written to
+  buffer = qi::Buffer();
+  slice.write("d", 1);
+  ASSERT_EQ(2001u, slice.size());
+  EXPECT_EQ('b', static_cast<const char*>(slice.data())[1000]);
+  EXPECT_EQ('d', static_cast<const char*>(slice.data())[2000]);
+
+  // small buffers are copied
+  qi::Buffer small;
+  small.write("hello", 5);
+  qi::Buffer smallSlice = small.slice(1, 3);
+  small.clear();
+  small.write("world", 5);
+  EXPECT_EQ("ell", std::string(static_cast<const char*>(smallSlice.data()), smallSlice.size()));
+}
+
+TEST(TestBuffer, TestSliceStorageReclaimed)
+{
+  qi::Buffer buffer;
+  std::string big(10000, 'a');
+  buffer.write(big.data(), big.size());
+  const void* storage = buffer.data();
+
+  // the buffer keeps its storage once the slices are gone
+  {
+    qi::Buffer slice = buffer.slice(0, 5000);
+    qi::Buffer sliceOfSlice = slice.slice(1000, 1000);
+    EXPECT_EQ(static_cast<const char*>(storage) + 1000, sliceOfSlice.data());
+  }
+  buffer.clear();
+  buffer.write(big.data(), big.size());
+  EXPECT_EQ(storage, buffer.data());
+
+  // but not while a slice, even of a slice, still uses it
+  qi::Buffer sliceOfSlice = buffer.slice(0, 5000).slice(1000, 1000);
+  buffer.clear();
+  buffer.write(std::string(10000, 'b').data(), 10000);
+  EXPECT_NE(storage, buffer.data());
+  EXPECT_EQ(std::string(1000, 'a'),
+            std::string(static_cast<const char*>(sliceOfSlice.data()), sliceOfSlice.size()));
+}
+
+static void sliceRepeatedly(const qi::Buffer* buffer, qi::Atomic<int>* errors)
+{
+  for (int i = 0; i < 1000; ++i)
+  {
+    qi::Buffer slice = buffer->slice(i, 5000);
+    if (slice.data() != static_cast<const char*>(buffer->data()) + i)
+      ++*errors;
+  }
+}
+
+TEST(TestBuffer, TestConcurrentSlices)
+{
+  qi::Buffer buffer;
+  buffer.write(std::string(10000, 'a').data(), 10000);
+  qi::Atomic<int> errors;
+
+  boost::thread_group threads;
+  for (int i = 0; i < 4; ++i)
+    threads.create_thread(boost::bind(&sliceRepeatedly, &buffer, &errors));
+  threads.join_all();
+  EXPECT_EQ(0, *errors);
+
+  // the storage is not shared anymore
+  const void* storage = buffer.data();
+  buffer.clear();
+  buffer.write(std::string(10000, 'b').data(), 10000);
+  EXPECT_EQ(storage, buffer.data());
+}
@@ -0,0 +1,267 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <qi/application.hpp>
+#include <qi/atomic.hpp>
+#include <qi/eventloop.hpp>
+#include <qi/future.hpp>
+#include <qi/os.hpp>
+
+class TestEventLoop : public ::testing::TestWithParam<qi::EventLoop::Backend>
+{
+protected:
+  void SetUp() override
+  {
+    loop.reset(new qi::EventLoop("test", GetParam()));
+    loop->start(4);
+  }
+
+  void TearDown() override
+  {
+    loop.reset();
+  }
+
+  boost::scoped_ptr<qi::EventLoop> loop;
+};
+
+static void increment(qi::Atomic<int>* count, int target, qi::Promise<void> done)
+{
+  if (++*count == target)
+    done.setValue(0);
+}
+
+static void fanOut(qi::EventLoop* loop, qi::Atomic<int>* count, int width, int depth,
+                   qi::Atomic<int>* leaves, int target, qi::Promise<void> done)
+{
+  ++*count;
+  if (!depth)
+  {
+    increment(leaves, target, done);
+    return;
+  }
+  for (int i = 0; i < width; ++i)
+    loop->post(boost::bind(&fanOut, loop, count, width, depth - 1, leaves, target, done));
+}
+
+TEST_P(TestEventLoop, PostManyTasks)
+{
+  const int target = 100000;
+  qi::Atomic<int> count;
+  qi::Promise<void> done;
+  for (int i = 0; i < target; ++i)
+    loop->post(boost::bind(&increment, &count, target, done));
+  ASSERT_EQ(qi::FutureState_FinishedWithValue, done.future().wait(10000));
+  EXPECT_EQ(target, *count);
+}
+
+TEST_P(TestEventLoop, PostFromTasks)
+{
+  // 8^5 leaves, and 1 + 8 + ... + 8^5 tasks
+  qi::Atomic<int> count;
+  qi::Atomic<int> leaves;
+  qi::Promise<void> done;
+  loop->post(boost::bind(&fanOut, loop.get(), &count, 8, 5, &leaves, 32768, done));
+  ASSERT_EQ(qi::FutureState_FinishedWithValue, done.future().wait(10000));
+  EXPECT_EQ(37449, *count);
+}
+
+static int answer()
+{
+  return 42;
+}
+
+static void fail()
+{
+  throw std::runtime_error("failure");
+}
+
+TEST_P(TestEventLoop, AsyncResults)
+{
+  EXPECT_EQ(42, loop->async(&answer).value());
+  EXPECT_TRUE(loop->async(&fail).hasError());
+  EXPECT_EQ(42, loop->asyncDelay(&answer, qi::MilliSeconds(10)).value());
+}
+
+TEST_P(TestEventLoop, CancelDelayedTask)
+{
+  qi::Atomic<int> count;
+  qi::Future<void> f = loop->asyncDelay(boost::bind(&increment, &count, 1, qi::Promise<void>()), qi::Seconds(10));
+  f.cancel();
+  EXPECT_EQ(qi::FutureState_Canceled, f.wait(1000));
+  EXPECT_EQ(0, *count);
+}
+
+TEST_P(TestEventLoop, StopRunsPendingTimers)
+{
+  qi::Atomic<int> count;
+  qi::Future<void> f = loop->asyncDelay(boost::bind(&increment, &count, 1, qi::Promise<void>()), qi::MilliSeconds(50));
+  loop->stop();
+  loop->join();
+  EXPECT_TRUE(f.isFinished());
+  EXPECT_EQ(1, *count);
+}
+
+static void checkDeadline(qi::SteadyClockTimePoint deadline)
+{
+  if (qi::SteadyClock::now() < deadline)
+    throw std::runtime_error("task ran before its deadline");
+}
+
+TEST_P(TestEventLoop, DelayedTasksRunAfterTheirDelay)
+{
+  // From below the resolution of the timers to several turns of their first level
+  const qi::Duration delays[] = { qi::MicroSeconds(100), qi::MilliSeconds(1), qi::MilliSeconds(30),
+                                  qi::MilliSeconds(255), qi::MilliSeconds(256), qi::MilliSeconds(700) };
+  std::vector<qi::Future<void> > futures;
+  for (const qi::Duration& delay : delays)
+  {
+    futures.push_back(loop->asyncDelay(boost::bind(&checkDeadline, qi::SteadyClock::now() + delay), delay));
+    const qi::SteadyClockTimePoint deadline = qi::SteadyClock::now() + delay;
+    futures.push_back(loop->asyncAt(boost::bind(&checkDeadline, deadline), deadline));
+  }
+  for (qi::Future<void>& future : futures)
+  {
+    ASSERT_EQ(qi::FutureState_FinishedWithValue, future.wait(5000));
+    EXPECT_FALSE(future.hasError());
+  }
+}
+
+TEST_P(TestEventLoop, PastDeadlineRunsImmediately)
+{
+  EXPECT_EQ(42, loop->asyncAt(&answer, qi::SteadyClock::now() - qi::Seconds(10)).value(1000));
+}
+
+TEST_P(TestEventLoop, CancelManyDelayedTasks)
+{
+  const int count = 10000;
+  qi::Atomic<int> ran;
+  qi::Promise<void> done;
+  std::vector<qi::Future<void> > futures;
+  for (int i = 0; i < count; ++i)
+  {
+    futures.push_back(loop->asyncDelay(boost::bind(&increment, &ran, count / 2, done),
+                                       qi::MilliSeconds(50 + i % 400)));
+    if (i % 2 == 0)
+      futures.back().cancel();
+  }
+  ASSERT_EQ(qi::FutureState_FinishedWithValue, done.future().wait(5000));
+  for (int i = 0; i < count; ++i)
+  {
+    ASSERT_EQ(i % 2 ? qi::FutureState_FinishedWithValue : qi::FutureState_Canceled,
+              futures[i].wait(5000));
+  }
+  EXPECT_EQ(count / 2, *ran);
+}
+
+static void block(qi::Future<void> release, qi::Atomic<int>* started)
+{
+  ++*started;
+  release.wait();
+}
+
+template <typename Predicate>
+static bool waitFor(Predicate predicate)
+{
+  for (int i = 0; i < 500; ++i)
+  {
+    if (predicate())
+      return true;
+    qi::os::msleep(10);
+  }
+  return predicate();
+}
+
+TEST_P(TestEventLoop, PoolFollowsLoad)
+{
+  qi::EventLoop pool("pool", GetParam());
+  pool.start(2);
+  EXPECT_EQ(2u, pool.poolStatus().minThreads);
+
+  // More blocking tasks than threads: the pool grows until they all run
+  const int blocking = 6;
+  qi::Promise<void> release;
+  qi::Atomic<int> started;
+  for (int i = 0; i < blocking; ++i)
+    pool.post(boost::bind(&block, release.future(), &started));
+  EXPECT_TRUE(waitFor([&] { return *started == blocking; }));
+  EXPECT_LE(unsigned(blocking), pool.poolStatus().threads);
+  EXPECT_TRUE(waitFor([&] { return pool.poolStatus().threadsAdded >= unsigned(blocking) - 2; }));
+
+  // Once idle, it shrinks back to its minimum
+  release.setValue(0);
+  EXPECT_TRUE(waitFor([&] { return pool.poolStatus().threads == 2; }));
+  EXPECT_LE(unsigned(blocking) - 2, pool.poolStatus().threadsRemoved);
+
+  pool.setMinThreads(1);
+  EXPECT_TRUE(waitFor([&] { return pool.poolStatus().threads == 1; }));
+
+  // The remaining thread still runs tasks
+  EXPECT_EQ(42, pool.async(&answer).value());
+  pool.stop();
+  pool.join();
+}
+
+static void recordThread(qi::EventLoop* loop, qi::Promise<int> done)
+{
+  done.setValue(loop->currentThreadIndex());
+}
+
+TEST_P(TestEventLoop, PostOnThread)
+{
+  qi::Promise<int> first;
+  loop->post(boost::bind(&recordThread, loop.get(), first));
+  const int index = first.future().value();
+  if (GetParam() == qi::EventLoop::Backend::Asio)
+    EXPECT_EQ(-1, index);
+  else
+    EXPECT_LE(0, index);
+
+  // An idle thread runs the tasks posted to it
+  for (int i = 0; i < 100; ++i)
+  {
+    qi::Promise<int> done;
+    loop->postOnThread(index, boost::bind(&recordThread, loop.get(), done));
+    ASSERT_EQ(index, done.future().value(1000));
+  }
+}
+
+TEST_P(TestEventLoop, PostOnBlockedThread)
+{
+  qi::Promise<int> first;
+  loop->post(boost::bind(&recordThread, loop.get(), first));
+  const int index = first.future().value();
+
+  // Tasks posted to a blocked thread still run
+  qi::Promise<void> release;
+  qi::Atomic<int> started;
+  loop->postOnThread(index, boost::bind(&block, release.future(), &started));
+  ASSERT_TRUE(waitFor([&] { return *started == 1; }));
+  qi::Promise<int> done;
+  loop->postOnThread(index, boost::bind(&recordThread, loop.get(), done));
+  ASSERT_EQ(qi::FutureState_FinishedWithValue, done.future().wait(1000));
+  if (GetParam() == qi::EventLoop::Backend::WorkStealing)
+    EXPECT_NE(index, done.future().value());
+  release.setValue(0);
+}
+
+INSTANTIATE_TEST_CASE_P(Backends, TestEventLoop,
+                        ::testing::Values(qi::EventLoop::Backend::Asio, qi::EventLoop::Backend::WorkStealing));
+
+int main(int argc, char **argv)
+{
+  // Sample the pools often, and shrink them quickly
+  qi::os::setenv("QI_EVENTLOOP_PING_TIMEOUT", "20");
+  qi::os::setenv("QI_EVENTLOOP_SHRINK_DELAY", "200");
+  qi::Application app(argc, argv);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,58 @@
+/*
+**  Copyright (C) 2015 Aldebaran Robotics
+**  See COPYING for the license
+*/
+
+#include <gtest/gtest.h>
+
+#include <qi/application.hpp>
+#include <qi/clock.hpp>
+#include <qi/eventloop.hpp>
+#include <qi/future.hpp>
+#include <qi/os.hpp>
+
+// Unlike test_eventloop, the pools are sampled at the default pace: a stall
+// of the timers would only end with the next sample.
+
+static void nothing()
+{
+}
+
+class TestEventLoopShrink : public ::testing::TestWithParam<qi::EventLoop::Backend>
+{
+};
+
+TEST_P(TestEventLoopShrink, TimersRunWhileShrinking)
+{
+  qi::EventLoop pool("pool", GetParam());
+  pool.start(8);
+  pool.setMinThreads(1);
+
+  // Keep a timer pending until the pool has shrunk to its minimum, and a bit longer
+  const qi::SteadyClockTimePoint deadline = qi::SteadyClock::now() + qi::Seconds(20);
+  int afterShrink = 0;
+  while (afterShrink < 50 && qi::SteadyClock::now() < deadline)
+  {
+    const qi::SteadyClockTimePoint start = qi::SteadyClock::now();
+    ASSERT_EQ(qi::FutureState_FinishedWithValue,
+              pool.asyncDelay(&nothing, qi::MilliSeconds(5)).wait(1000));
+    EXPECT_GT(qi::MilliSeconds(200), qi::SteadyClock::now() - start);
+    if (pool.poolStatus().threads == 1)
+      ++afterShrink;
+  }
+  EXPECT_EQ(1u, pool.poolStatus().threads);
+  pool.stop();
+  pool.join();
+}
+
+INSTANTIATE_TEST_CASE_P(Backends, TestEventLoopShrink,
+                        ::testing::Values(qi::EventLoop::Backend::Asio, qi::EventLoop::Backend::WorkStealing));
+
+int main(int argc, char **argv)
+{
+  // Shrink as soon as the pools are sampled idle
+  qi::os::setenv("QI_EVENTLOOP_SHRINK_DELAY", "100");
+  qi::Application app(argc, argv);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -5,6 +5,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <gtest/gtest.h>
 #include <boost/thread.hpp>
 #include <qi/os.hpp>
@@ -502,6 +503,92 @@ TEST_F(TestFuture, Threaded) {
   EXPECT_EQ(3, *gSuccess);
 }
 
+static void countCall(const qi::Future<int>&, qi::Atomic<int>* count)
+{
+  ++*count;
+}
+
+static void connectMany(qi::Future<int> fut, qi::Atomic<int>* count, int callbacks)
+{
+  for (int i = 0; i < callbacks; ++i)
+    fut.connect(boost::bind(&countCall, _1, count), qi::FutureCallbackType_Sync);
+}
+
+static void setValueOnce(qi::Promise<int> pro, qi::Atomic<int>* setCount)
+{
+  try
+  {
+    pro.setValue(42);
+    ++*setCount;
+  }
+  catch (const qi::FutureException&)
+  {
+  }
+}
+
+TEST_F(TestFuture, ConnectWhileSetting) {
+  for (int round = 0; round < 50; ++round)
+  {
+    qi::Promise<int> pro;
+    qi::Atomic<int> count;
+    qi::Atomic<int> setCount;
+    boost::thread_group tg;
+
+    tg.create_thread(boost::bind(&connectMany, pro.future(), &count, 100));
+    tg.create_thread(boost::bind(&connectMany, pro.future(), &count, 100));
+    tg.create_thread(boost::bind(&setValueOnce, pro, &setCount));
+    tg.create_thread(boost::bind(&setValueOnce, pro, &setCount));
+    tg.join_all();
+    // each callback is called once, whether it was connected before or after the value
+    EXPECT_EQ(200, *count);
+    EXPECT_EQ(1, *setCount);
+    EXPECT_EQ(42, pro.future().value());
+  }
+}
+
+TEST_F(TestFuture, WaitForSyncCallbacks) {
+  qi::Promise<int> pro(qi::FutureCallbackType_Sync);
+  qi::Future<int> fut = pro.future();
+  qi::Atomic<int> callbackDone;
+  fut.connect([&](qi::Future<int> f) {
+    // the callback sees its own future as finished
+    EXPECT_TRUE(f.isFinished());
+    EXPECT_EQ(42, f.value());
+    qi::os::msleep(100);
+    callbackDone = true;
+  });
+
+  boost::thread setter(boost::bind(&qi::Promise<int>::setValue, pro, 42));
+  while (fut.isRunning())
+    qi::os::msleep(1);
+  // the value is published, but the callback still runs
+  EXPECT_FALSE(fut.isFinished());
+  EXPECT_EQ(qi::FutureState_FinishedWithValue, fut.wait(0));
+  EXPECT_TRUE(*callbackDone);
+  EXPECT_TRUE(fut.isFinished());
+  setter.join();
+}
+
+
+TEST_F(TestFuture, CancelWhileSyncCallbacksRun) {
+  qi::Promise<int> pro([](qi::Promise<int>& p) { p.setCanceled(); }, qi::FutureCallbackType_Sync);
+  qi::Future<int> fut = pro.future();
+  qi::Atomic<int> callbackStarted;
+  fut.connect([&](qi::Future<int>) {
+    callbackStarted = true;
+    qi::os::msleep(100);
+  });
+
+  boost::thread setter(boost::bind(&qi::Promise<int>::setValue, pro, 42));
+  while (!*callbackStarted)
+    qi::os::msleep(1);
+  // the result is set: the canceller must not be called on it
+  EXPECT_NO_THROW(fut.cancel());
+  EXPECT_EQ(qi::FutureState_FinishedWithValue, fut.wait());
+  EXPECT_EQ(42, fut.value());
+  setter.join();
+}
+
 
 TEST_F(TestFuture, TestTimeout) {
   qi::Promise<int> pro;
@@ -929,6 +1016,26 @@ TEST(TestFutureThen, Then)
   ASSERT_EQ(44, fff.value());
 }
 
+TEST(TestFutureThen, ThenManyCallbacks)
+{
+  // callbacks too big to be stored in place, and more than one per future
+  qi::Promise<int> prom;
+  const std::string big(100, 'x');
+  std::vector<qi::Future<int> > results;
+  for (int i = 0; i < 3; ++i)
+  {
+    std::vector<int> padding(10, i);
+    results.push_back(prom.future().then(qi::FutureCallbackType_Sync,
+        [big, padding](qi::Future<int> f) { return f.value() + padding[0]; }));
+  }
+  prom.setValue(40);
+
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EQ(40 + i, results[i].value());
+  EXPECT_EQ(42, prom.future().then(qi::FutureCallbackType_Sync,
+        [big](qi::Future<int> f) { return f.value() + 2; }).value());
+}
+
 TEST(TestFutureThen, ThenCancel)
 {
   qi::Promise<int> p;
@@ -1593,6 +1700,116 @@ TEST(TestPeriodicTask, TriggerStartStop)
   }
 }
 
+static void sleepAndInc(qi::Atomic<int>& tgt, unsigned int ms)
+{
+  qi::os::msleep(ms);
+  ++tgt;
+}
+
+TEST(TestPeriodicTask, CompensateDoesNotDrift)
+{
+  qi::Atomic<int> a;
+  qi::PeriodicTask pt;
+  pt.setCallback(&sleepAndInc, boost::ref(a), 5);
+  pt.setUsPeriod(20000);
+  pt.compensateCallbackTime(true);
+  pt.start();
+  qi::os::msleep(500);
+  pt.stop();
+  // without compensation, 5ms would be lost on each call
+  EXPECT_GE(3, std::abs(*a - 25));
+
+  qi::PeriodicTask::Statistics stats = pt.statistics();
+  EXPECT_EQ(*a, static_cast<int>(stats.calls));
+  EXPECT_LE(stats.meanJitter, stats.maxJitter);
+}
+
+TEST(TestPeriodicTask, Overruns)
+{
+  qi::Atomic<int> a;
+  qi::PeriodicTask pt;
+  pt.setCallback(&sleepAndInc, boost::ref(a), 25);
+  pt.setUsPeriod(10000);
+  pt.compensateCallbackTime(true);
+  pt.start();
+  qi::os::msleep(200);
+  pt.stop();
+  qi::PeriodicTask::Statistics stats = pt.statistics();
+  EXPECT_LT(0u, stats.calls);
+  // every call takes longer than the period, the missed ones are skipped
+  EXPECT_EQ(stats.calls, stats.overruns);
+  EXPECT_GE(10, *a);
+
+  pt.start();
+  pt.stop();
+  EXPECT_GE(1u, pt.statistics().calls);
+}
+
+TEST(TestPeriodicTask, CompensatedStartWaitsOnePeriod)
+{
+  qi::Promise<qi::SteadyClockTimePoint> firstCall;
+  qi::PeriodicTask task;
+  task.setCallback([&]{
+    try
+    {
+      firstCall.setValue(qi::SteadyClock::now());
+    }
+    catch (const qi::FutureException&)
+    { // not the first call
+    }
+  });
+  task.setPeriod(qi::MilliSeconds(100));
+  task.compensateCallbackTime(true);
+
+  const qi::SteadyClockTimePoint start = qi::SteadyClock::now();
+  task.start(false);
+  const qi::SteadyClockTimePoint first = firstCall.future().value();
+  task.stop();
+  // on the grid, but never earlier than one period after start()
+  EXPECT_GE(first - start, qi::MilliSeconds(100));
+  EXPECT_LT(first - start, qi::MilliSeconds(300));
+}
+
+TEST(TestPeriodicTask, HarmonicPeriodsShareTicks)
+{
+  boost::mutex mutex;
+  std::vector<qi::SteadyClockTimePoint> fast, slow;
+  qi::PeriodicTask fastTask;
+  fastTask.setCallback([&]{
+    boost::mutex::scoped_lock lock(mutex);
+    fast.push_back(qi::SteadyClock::now());
+  });
+  fastTask.setPeriod(qi::MilliSeconds(20));
+  fastTask.compensateCallbackTime(true);
+  qi::PeriodicTask slowTask;
+  slowTask.setCallback([&]{
+    boost::mutex::scoped_lock lock(mutex);
+    slow.push_back(qi::SteadyClock::now());
+  });
+  slowTask.setPeriod(qi::MilliSeconds(40));
+  slowTask.compensateCallbackTime(true);
+
+  fastTask.start(false);
+  qi::os::msleep(7);
+  slowTask.start(false);
+  qi::os::msleep(300);
+  slowTask.stop();
+  fastTask.stop();
+
+  boost::mutex::scoped_lock lock(mutex);
+  ASSERT_LT(3u, slow.size());
+  int shared = 0;
+  for (unsigned int i = 0; i < slow.size(); ++i)
+    for (unsigned int j = 0; j < fast.size(); ++j)
+      if (qi::SteadyClockTimePoint::duration(std::abs((slow[i] - fast[j]).count())) < qi::MilliSeconds(5))
+      {
+        ++shared;
+        break;
+      }
+  // be lenient for our overloaded buildslaves
+  EXPECT_LE(static_cast<int>(slow.size()) - 1, shared);
+}
+
 TEST(EventLoop, asyncFast)
 {
   qi::EventLoop* el = qi::getEventLoop();
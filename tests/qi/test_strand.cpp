@@ -4,9 +4,11 @@
 #include <qi/application.hpp>
 #include <qi/future.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/foreach.hpp>
 #include <qi/os.hpp>
 #include <qi/strand.hpp>
+#include <qi/eventloop.hpp>
 #include <qi/periodictask.hpp>
 #include <qi/actor.hpp>
 #include <qi/log.hpp>
@@ -130,6 +132,146 @@ TEST(TestStrand, StrandDestruction)
     ASSERT_TRUE(future.isFinished());
 }
 
+static void append(boost::mutex& mutex, std::vector<int>& order, int value)
+{
+  boost::unique_lock<boost::mutex> lock(mutex, boost::try_to_lock);
+  // we should never be called in parallel
+  ASSERT_TRUE(lock.owns_lock());
+  order.push_back(value);
+}
+
+static void waitFor(qi::Future<void> future)
+{
+  future.wait();
+}
+
+TEST(TestStrand, PostAndAsyncKeepOrder)
+{
+  boost::mutex mutex;
+  std::vector<int> order;
+  qi::Future<void> last;
+  {
+    qi::Strand strand(*qi::getEventLoop());
+    for (int j = 0; j < 1000; ++j)
+    {
+      if (j % 3)
+        strand.post(boost::bind(&append, boost::ref(mutex), boost::ref(order), j));
+      else
+        last = strand.async(boost::bind(&append, boost::ref(mutex), boost::ref(order), j));
+    }
+    last.wait();
+    // a canceled job in the middle of posted ones is skipped
+    qi::Promise<void> blocker;
+    strand.post(boost::bind(&waitFor, blocker.future()));
+    qi::Future<void> canceled = strand.async(fail);
+    strand.post(boost::bind(&append, boost::ref(mutex), boost::ref(order), 1000));
+    canceled.cancel();
+    blocker.setValue(0);
+    ASSERT_EQ(qi::FutureState_Canceled, canceled.wait());
+  }
+  ASSERT_EQ(1001u, order.size());
+  for (int j = 0; j <= 1000; ++j)
+    EXPECT_EQ(j, order[j]);
+}
+
+TEST(TestStrand, PostAfterJoinIsDropped)
+{
+  boost::mutex mutex;
+  boost::atomic<unsigned int> i(0);
+  qi::Strand strand(*qi::getEventLoop());
+  strand.post(boost::bind<void>(&increment, boost::ref(mutex), 0, boost::ref(i)));
+  strand.join();
+  strand.post(boost::bind<void>(&increment, boost::ref(mutex), 0, boost::ref(i)));
+  qi::os::msleep(10);
+  ASSERT_GE(1u, i.load());
+}
+
+static void throwError()
+{
+  throw std::runtime_error("posted job failure");
+}
+
+TEST(TestStrand, PostedJobThrowing)
+{
+  boost::mutex mutex;
+  boost::atomic<unsigned int> i(0);
+  qi::Strand strand(*qi::getEventLoop());
+  strand.post(&throwError);
+  strand.post(boost::bind<void>(&increment, boost::ref(mutex), 0, boost::ref(i)));
+  qi::Future<void> f = strand.async(boost::bind<void>(&increment, boost::ref(mutex), 0, boost::ref(i)));
+  ASSERT_EQ(qi::FutureState_FinishedWithValue, f.wait());
+  ASSERT_EQ(2u, i.load());
+}
+
+static void post(qi::Strand& strand, boost::mutex& mutex, boost::atomic<unsigned int>& i, unsigned int count)
+{
+  for (unsigned int j = 0; j < count; ++j)
+    strand.post(boost::bind<void>(&increment, boost::ref(mutex), 0, boost::ref(i)));
+}
+
+TEST(TestStrand, PostThroughput)
+{
+  static const unsigned int producers = 4;
+  static const unsigned int count = 50000;
+  boost::mutex mutex;
+  boost::atomic<unsigned int> i(0);
+  qi::Strand strand(*qi::getEventLoop());
+
+  qi::SteadyClockTimePoint start = qi::SteadyClock::now();
+  boost::thread_group threads;
+  for (unsigned int p = 0; p < producers; ++p)
+    threads.create_thread(boost::bind(&post, boost::ref(strand), boost::ref(mutex), boost::ref(i), count));
+  threads.join_all();
+  qi::Future<void> done = strand.async(boost::bind(qi::os::msleep, 0));
+  ASSERT_EQ(qi::FutureState_FinishedWithValue, done.wait(30000));
+  qi::Duration elapsed = qi::SteadyClock::now() - start;
+
+  ASSERT_EQ(producers * count, i.load());
+  qiLogInfo() << producers * count << " posted jobs in "
+              << boost::chrono::duration_cast<qi::MilliSeconds>(elapsed).count() << "ms";
+}
+
+static int currentThread(qi::EventLoop* loop)
+{
+  return loop->currentThreadIndex();
+}
+
+TEST(TestStrand, AffinityKeepsThread)
+{
+  qi::EventLoop loop("affinity", qi::EventLoop::Backend::WorkStealing);
+  loop.start(4);
+  {
+    qi::Strand strand(loop, qi::Strand::Affinity::Thread);
+    const int thread = strand.async(boost::bind(&currentThread, &loop)).value();
+    ASSERT_LE(0, thread);
+    for (int i = 0; i < 100; ++i)
+      ASSERT_EQ(thread, strand.async(boost::bind(&currentThread, &loop)).value());
+
+    // jobs still run one at a time
+    boost::mutex mutex;
+    boost::atomic<unsigned int> i(0);
+    for (int j = 0; j < 1000; ++j)
+      strand.post(boost::bind<void>(&increment, boost::ref(mutex), 0, boost::ref(i)));
+    strand.async(boost::bind(qi::os::msleep, 0)).wait();
+    ASSERT_EQ(1000u, i.load());
+  }
+  loop.stop();
+  loop.join();
+}
+
+TEST(TestStrand, AffinityWithoutSupport)
+{
+  // an asio event loop does not know its threads, jobs run anyway
+  qi::EventLoop loop("noaffinity", qi::EventLoop::Backend::Asio);
+  loop.start(2);
+  {
+    qi::Strand strand(loop, qi::Strand::Affinity::Thread);
+    ASSERT_EQ(-1, strand.async(boost::bind(&currentThread, &loop)).value());
+  }
+  loop.stop();
+  loop.join();
+}
+
 TEST(TestStrand, StrandDestructionWithMethodAndConcurrency)
 {
   // ASSERT_NOSEGFAULT_NOCRASH_NOBADTHINGS();
@@ -58,6 +58,29 @@ TEST(TestMetaObject, findMethod)
   EXPECT_TRUE(true);
 }
 
+TEST(TestMetaObject, findMethodOverloadResolutionCache)
+{
+  qi::MetaObjectBuilder b;
+  unsigned int hi = b.addMethod("i", "h", "(i)");
+  unsigned int hs = b.addMethod("i", "h", "(s)");
+  unsigned int hd = b.addMethod("i", "h", "(d)");
+
+  qi::MetaObject mo = b.metaObject();
+  for (int i = 0; i < 3; ++i)
+  {
+    EXPECT_EQ((int)hi, mo.findMethod("h", args(1)));
+    EXPECT_EQ((int)hs, mo.findMethod("h", args("foo")));
+    EXPECT_EQ((int)hd, mo.findMethod("h", args(1.5)));
+    // dynamic values are resolved by content on every call
+    EXPECT_EQ((int)hs, mo.findMethod("h", args(qi::AnyValue::from(std::string("foo")))));
+    EXPECT_EQ((int)hi, mo.findMethod("h", args(qi::AnyValue::from(1))));
+  }
+
+  qi::MetaObject copy = mo;
+  EXPECT_EQ((int)hs, copy.findMethod("h", args("foo")));
+  EXPECT_EQ((int)hi, copy.findMethod("h", args(1)));
+}
+
 TEST(TestMetaObject, SHA1Digest_construction)
 {
   qi::MetaObjectPrivate::SHA1Digest d;
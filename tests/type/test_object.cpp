@@ -339,6 +339,33 @@ TEST(TestAnyFunction, Call)
   ASSERT_FALSE(obj.lock());
 }
 
+TEST(TestAnyFunction, ConversionCache)
+{
+  qi::AnyFunction f = qi::AnyFunction::from(&summ);
+  qi::AnyFunction::ConversionCacheStats before = qi::AnyFunction::conversionCacheStats();
+  EXPECT_EQ(10, f.call<int>(qi::int64_t(1), 2.0, 3, std::string("lola")));
+  qi::AnyFunction::ConversionCacheStats first = qi::AnyFunction::conversionCacheStats();
+  EXPECT_EQ(before.misses + 1, first.misses);
+  EXPECT_EQ(before.hits, first.hits);
+  EXPECT_EQ(13, f.call<int>(qi::int64_t(4), 2.0, 3, std::string("lola")));
+  qi::AnyFunction::ConversionCacheStats second = qi::AnyFunction::conversionCacheStats();
+  EXPECT_EQ(first.misses, second.misses);
+  EXPECT_EQ(first.hits + 1, second.hits);
+
+  // Dynamic values are converted according to what they hold
+  f = qi::AnyFunction::from(&funVal);
+  EXPECT_EQ(3, f.call<int>(qi::AnyValue::from(1), qi::AnyValue::from(2)));
+  EXPECT_EQ(5, f.call<int>(qi::AnyValue::from(2.0), qi::AnyValue::from(3)));
+  EXPECT_ANY_THROW(f.call<int>(qi::AnyValue::from(1), qi::AnyValue::from(std::string("foo"))));
+  EXPECT_EQ(7, f.call<int>(qi::AnyValue::from(3), qi::AnyValue::from(4)));
+
+  // Pointers are dereferenced
+  Foo foo;
+  f = qi::AnyFunction::from(&Foo::getRefF);
+  EXPECT_EQ(3, f.call<int>(&foo));
+  EXPECT_EQ(3, f.call<int>(&foo));
+}
+
 TEST(TestObject, Simple) {
   Foo                   foo;
   qi::DynamicObjectBuilder ob;
@@ -5,6 +5,8 @@
 ** Copyright (C) 2012 Aldebaran Robotics
 */
 
+#include <vector>
+
 #include <gtest/gtest.h>
 #include <qi/signal.hpp>
 #include <qi/future.hpp>
@@ -301,6 +303,143 @@ TEST(TestSignal, OnSubscriber)
   ASSERT_FALSE(subscribers);
 }
 
+void connectAnother(qi::Signal<int>* sig, qi::Atomic<int>* calls, int)
+{
+  ++*calls;
+  sig->connect(boost::bind(&foo, calls, _1, 0)).setCallType(qi::MetaCallType_Direct);
+}
+
+TEST(TestSignal, ConnectFromSubscriber)
+{
+  qi::Atomic<int> calls;
+  qi::Signal<int> sig;
+  sig.setCallType(qi::MetaCallType_Direct);
+  qi::SignalLink l = sig.connect(boost::bind(&connectAnother, &sig, &calls, _1));
+  sig(1);
+  // subscribers connected during an emit are called from the next one
+  EXPECT_EQ(1, *calls);
+  EXPECT_TRUE(sig.disconnect(l));
+  sig(1);
+  EXPECT_EQ(2, *calls);
+  EXPECT_TRUE(sig.hasSubscribers());
+  sig.disconnectAll();
+  EXPECT_FALSE(sig.hasSubscribers());
+  sig(1);
+  EXPECT_EQ(2, *calls);
+}
+
+void setFromSharedPtr(qi::Promise<int> promise, boost::shared_ptr<int> ptr)
+{
+  promise.setValue(*ptr);
+}
+
+TEST(TestSignal, QueuedSubscribersShareArguments)
+{
+  qi::Signal<boost::shared_ptr<int> > sig;
+  sig.setCallType(qi::MetaCallType_Queued);
+  std::vector<qi::Promise<int> > promises(3);
+  for (unsigned int i = 0; i < promises.size(); ++i)
+    sig.connect(boost::bind(&setFromSharedPtr, promises[i], _1));
+  boost::shared_ptr<int> ptr(new int(42));
+  sig(ptr);
+  for (unsigned int i = 0; i < promises.size(); ++i)
+    EXPECT_EQ(42, promises[i].future().value());
+  // the copy of the arguments is released after the last subscriber ran
+  for (int i = 0; i < 100 && !ptr.unique(); ++i)
+    qi::os::msleep(10);
+  EXPECT_TRUE(ptr.unique());
+}
+
+void storeLatest(qi::Atomic<int>* calls, qi::Atomic<int>* last, int value)
+{
+  ++*calls;
+  *last = value;
+}
+
+TEST(TestSignal, CoalesceLatest)
+{
+  qi::Atomic<int> calls;
+  qi::Atomic<int> last;
+  qi::Signal<int> sig;
+  sig.connect(boost::bind(&storeLatest, &calls, &last, _1))
+    .setCoalescing(qi::SignalCoalescing::latest(qi::MilliSeconds(200)));
+  for (int i = 1; i <= 100; ++i)
+    sig(i);
+  for (int i = 0; i < 100 && *last != 100; ++i)
+    qi::os::msleep(10);
+  EXPECT_EQ(100, *last);
+  // the first trigger may be flushed before the others are coalesced
+  EXPECT_LE(*calls, 2);
+}
+
+TEST(TestSignal, CoalesceLatestFromSignal)
+{
+  qi::Atomic<int> calls;
+  qi::Atomic<int> last;
+  qi::Signal<int> sig;
+  EXPECT_ANY_THROW(sig.setCoalescing(qi::SignalCoalescing::batch(qi::MilliSeconds(200))));
+  sig.setCoalescing(qi::SignalCoalescing::latest(qi::MilliSeconds(200)));
+  sig.connect(boost::bind(&storeLatest, &calls, &last, _1));
+  for (int i = 1; i <= 100; ++i)
+    sig(i);
+  for (int i = 0; i < 100 && *last != 100; ++i)
+    qi::os::msleep(10);
+  EXPECT_EQ(100, *last);
+  EXPECT_LE(*calls, 2);
+}
+
+void storeBatch(qi::Atomic<int>* calls, qi::Atomic<int>* received, qi::Atomic<int>* last,
+                std::vector<qi::AnyValue> batch)
+{
+  ++*calls;
+  for (unsigned int i = 0; i < batch.size(); ++i)
+  {
+    ++*received;
+    *last = batch[i].asTupleValuePtr()[0].as<int>();
+  }
+}
+
+TEST(TestSignal, CoalesceBatch)
+{
+  qi::Atomic<int> calls;
+  qi::Atomic<int> received;
+  qi::Atomic<int> last;
+  qi::Signal<int> sig;
+  boost::function<void(std::vector<qi::AnyValue>)> f = boost::bind(&storeBatch, &calls, &received, &last, _1);
+  sig.connect(qi::SignalSubscriber(qi::AnyFunction::from(f))
+                .setCoalescing(qi::SignalCoalescing::batch(qi::MilliSeconds(200))));
+  for (int i = 1; i <= 100; ++i)
+    sig(i);
+  for (int i = 0; i < 100 && *received != 100; ++i)
+    qi::os::msleep(10);
+  EXPECT_EQ(100, *received);
+  EXPECT_EQ(100, *last);
+  EXPECT_LE(*calls, 2);
+}
+
+TEST(TestSignal, CoalesceBatchOnlyBeforeConnect)
+{
+  qi::Atomic<int> calls;
+  qi::Atomic<int> received;
+  qi::Atomic<int> last;
+  qi::Signal<int> sig;
+  qi::SignalSubscriber& latest = sig.connect(boost::bind(&storeLatest, &calls, &last, _1));
+  EXPECT_ANY_THROW(latest.setCoalescing(qi::SignalCoalescing::batch(qi::MilliSeconds(200))));
+  latest.setCoalescing(qi::SignalCoalescing::latest(qi::MilliSeconds(200)));
+
+  boost::function<void(std::vector<qi::AnyValue>)> f = boost::bind(&storeBatch, &calls, &received, &last, _1);
+  qi::SignalSubscriber& batch = sig.connect(qi::SignalSubscriber(qi::AnyFunction::from(f))
+                .setCoalescing(qi::SignalCoalescing::batch(qi::MilliSeconds(200))));
+  EXPECT_ANY_THROW(batch.setCoalescing(qi::SignalCoalescing()));
+  batch.setCoalescing(qi::SignalCoalescing::batch(qi::MilliSeconds(100)));
+
+  sig(42);
+  for (int i = 0; i < 100 && (*received != 1 || *calls != 2); ++i)
+    qi::os::msleep(10);
+  EXPECT_EQ(1, *received);
+  EXPECT_EQ(2, *calls);
+}
+
 void store2(qi::Promise<int> variable1, qi::Promise<int> variable2, int value1, int value2)
 {
   variable1.setValue(value1);
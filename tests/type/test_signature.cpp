@@ -307,6 +307,23 @@ TEST(TestSignature, IsCompatible) {
 
   qi::Signature s3("([s])");
   EXPECT_GT(s3.isConvertibleTo("([m])"), s3.isConvertibleTo("(m)"));
+
+  // memoized results are the same
+  EXPECT_EQ(s.isConvertibleTo("(sm)"), s.isConvertibleTo("(sm)"));
+  EXPECT_EQ(s.isConvertibleTo("(si)"), 0.);
+  EXPECT_EQ(s3.isConvertibleTo("(m)"), qi::Signature("([s])").isConvertibleTo("(m)"));
+}
+
+TEST(TestSignature, Interned) {
+  qi::Signature a("(is)");
+  qi::Signature b(std::string("[(is)]"));
+  // equal signatures share one parsed tree
+  EXPECT_EQ(&a.toString(), &qi::Signature(std::string("(is)")).toString());
+  EXPECT_EQ(&a.toString(), &b.children()[0].toString());
+  EXPECT_EQ(&a.children()[0].toString(), &qi::Signature("i").toString());
+  EXPECT_EQ(&qi::Signature().toString(), &qi::Signature().toString());
+  EXPECT_EQ(a, b.children()[0]);
+  EXPECT_NE(a, b);
 }
 
 TEST(TestSignature, SignatureSplit) {
@@ -0,0 +1,82 @@
+/*
+** Copyright (C) 2015 Aldebaran Robotics
+** See COPYING for the license
+*/
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/thread.hpp>
+
+#include <qi/atomic.hpp>
+#include <qi/type/typeinterface.hpp>
+#include <src/type/typecache_p.hpp>
+
+namespace
+{
+  struct NotRegisteredYet
+  {
+  };
+
+  // A distinct fake interface for each key, never dereferenced
+  qi::TypeInterface* valueOf(const int* key)
+  {
+    return reinterpret_cast<qi::TypeInterface*>(const_cast<int*>(key) + 1);
+  }
+
+  void lookupPublished(const qi::TypeCache* cache, const std::vector<int>* keys, qi::Atomic<int>* published,
+                       qi::Atomic<int>* errors)
+  {
+    for (int round = 0; round < 200; ++round)
+    {
+      const int count = **published;
+      for (int i = 0; i < count; ++i)
+      {
+        qi::TypeInterface* value = 0;
+        if (!cache->find(&(*keys)[i], 0, value) || value != valueOf(&(*keys)[i]))
+          ++*errors;
+      }
+    }
+  }
+}
+
+TEST(TestTypeCache, NegativeLookupReplacedByRegistration)
+{
+  // the missing type is remembered as such
+  EXPECT_EQ(0, qi::getType(typeid(NotRegisteredYet)));
+  EXPECT_EQ(0, qi::getType(typeid(NotRegisteredYet)));
+
+  qi::TypeInterface* type = qi::typeOf<int>();
+  qi::registerType(typeid(NotRegisteredYet), type);
+  EXPECT_EQ(type, qi::getType(typeid(NotRegisteredYet)));
+}
+
+TEST(TestTypeCache, LookupsDuringGrowth)
+{
+  qi::TypeCache cache;
+  std::vector<int> keys(20000);
+  qi::Atomic<int> published;
+  qi::Atomic<int> errors;
+
+  boost::thread_group readers;
+  for (int i = 0; i < 4; ++i)
+    readers.create_thread(boost::bind(&lookupPublished, &cache, &keys, &published, &errors));
+  // a single writer, so no common lock is needed; the table grows many times
+  for (std::size_t i = 0; i < keys.size(); ++i)
+  {
+    cache.set(&keys[i], 0, valueOf(&keys[i]));
+    ++published;
+  }
+  readers.join_all();
+
+  EXPECT_EQ(0, *errors);
+  for (std::size_t i = 0; i < keys.size(); ++i)
+  {
+    qi::TypeInterface* value = 0;
+    ASSERT_TRUE(cache.find(&keys[i], 0, value));
+    EXPECT_EQ(valueOf(&keys[i]), value);
+  }
+  qi::TypeInterface* value = 0;
+  EXPECT_FALSE(cache.find(&published, 0, value));
+}